@@ -2,7 +2,7 @@
 #include <array>
 #include <concepts>
 #include <cstring>
-#include <stdexcept>
+#include <span>
 #include <vector>
 #define ZSTD_STATIC_LINKING_ONLY
 #include <zstd.h>
@@ -14,9 +14,11 @@ namespace NBT::IO {
     typedef uint16_t u16;
     typedef int64_t  i64;
     typedef uint64_t u64;
-    using std::array, std::min, std::memcpy, std::vector, std::same_as, std::out_of_range, NBT::Error::pushError;
+    using std::array, std::span, std::min, std::memcpy, std::vector, std::same_as, NBT::Error::pushError;
 
     inline constexpr u16 BUFFER_SIZE = 4096;
+    // What dereferencing a cursor at EOF yields: it ends every varint and text, so no read loop runs past the input.
+    inline constexpr u8 EOF_BYTE = 0x80;
 
     template<typename S>
     concept Readable = requires(S& s, u8* buf, size_t n) {
@@ -32,9 +34,22 @@ namespace NBT::IO {
         { s.writeBlock(buf, n) } -> same_as<bool>;
     };
 
+    // One contiguous piece of output, iovec-style. The bytes are borrowed, never owned.
+    struct Segment {
+        const u8* data;
+        size_t size;
+    };
+
+    // Sinks that can consume a whole segment list in one call (e.g. `writev`).
+    template<typename S>
+    concept GatherWritable = Writable<S> && requires(S& s, span<const Segment> segments) {
+        { s.writeSegments(segments) } -> same_as<bool>;
+    };
+
     template<Readable S>
     struct FileReader {
-        [[nodiscard]] explicit FileReader(S& source) noexcept : src_(&source), fileSize_(source.getSize()) {
+        // `context` lends a decompression stream to reuse instead of creating one; it is reset here and never freed.
+        [[nodiscard]] explicit FileReader(S& source, ZSTD_DStream* context = nullptr) noexcept : src_(&source), fileSize_(source.getSize()) {
             array<u8, 5> hdr{};
             if (source.readBlock(hdr.data(), 5) < 5) {
                 pushError("Stream too short to be a valid CGNBT file!");
@@ -43,11 +58,13 @@ namespace NBT::IO {
             buffer_.resize(BUFFER_SIZE);
             if (hdr[0]=='c' && hdr[1]=='G' && hdr[2]=='n' && hdr[3]=='b' && hdr[4]=='T') {
                 status_ = Status::Plain;
+                if (fileSize_ >= 0) plainSize_ = fileSize_ - source.getOffset();
                 fetchBlock(true);
             }
             else if (ZSTD_isFrame(hdr.data(), 4) || ZSTD_isSkippableFrame(hdr.data(), 4)) {
                 status_ = Status::Zstd;
-                zstdStream_ = ZSTD_createDStream();
+                ownsStream_ = context == nullptr;
+                zstdStream_ = ownsStream_ ? ZSTD_createDStream() : context;
                 ZSTD_initDStream(zstdStream_);
                 inBuffer_.resize(ZSTD_DStreamInSize());
                 // Pre-fill inBuffer with the already-read 5 bytes — they are part of the zstd frame.
@@ -66,11 +83,18 @@ namespace NBT::IO {
         [[nodiscard]] explicit operator bool() const noexcept { return status_ != Status::End; }
         [[nodiscard]] bool empty() const noexcept { return status_ == Status::Empty; }
 
-        [[nodiscard]] u8 operator*() const {
-            if (status_ == Status::End) throw out_of_range("FileReader: cursor at EOF or initialization failed!");
+        // Never throws: past EOF it returns `EOF_BYTE` and records the overrun, which readers check and report as truncation.
+        [[nodiscard]] u8 operator*() const noexcept {
+            if (status_ == Status::End) [[unlikely]] {
+                overrun_ = true;
+                return EOF_BYTE;
+            }
             return buffer_[bufPos_];
         }
 
+        // Whether anything was dereferenced past EOF.
+        [[nodiscard]] bool overrun() const noexcept { return overrun_; }
+
         // Reads up to `length` decoded bytes into `dst`; returns bytes actually written.
         // Faster than repeated operator++/operator*.
         [[nodiscard]] u64 getContent(u8* dst, u64 length) noexcept {
@@ -86,6 +110,39 @@ namespace NBT::IO {
                 progress += delta;
                 decoded_ += delta;
             }
+            //Same invariant as `operator++`: never leave the cursor parked on a drained buffer.
+            if (bufPos_ == bufSize_ && status_ != Status::End) fetchBlock();
+            return progress;
+        }
+
+        // Decoded bytes already in the buffer, from the cursor on; valid until the cursor moves. Empty only at EOF.
+        [[nodiscard]] span<const u8> buffered() const noexcept {
+            if (status_ == Status::End) return {};
+            return span<const u8>(buffer_.data() + bufPos_, bufSize_ - bufPos_);
+        }
+
+        // Advances by up to `length` decoded bytes without copying them; returns bytes actually skipped.
+        // Plain sources with a known size seek over whole blocks instead of reading them.
+        [[nodiscard]] u64 skip(u64 length) noexcept {
+            u64 progress = 0;
+            while (progress < length && status_ != Status::End) {
+                if (bufPos_ == bufSize_) {
+                    if (status_ == Status::Plain && fileSize_ >= 0 && length - progress > BUFFER_SIZE) {
+                        const i64 unread = fileSize_ - src_->getOffset();
+                        const u64 jump = unread > 0 ? min<u64>(static_cast<u64>(unread), length - progress - 1) : 0;
+                        src_->incrementBy(jump);
+                        progress += jump;
+                        decoded_ += jump;
+                    }
+                    fetchBlock();
+                    if (status_ == Status::End) break;
+                }
+                const u64 delta = min(bufSize_ - bufPos_, length - progress);
+                bufPos_ += delta;
+                progress += delta;
+                decoded_ += delta;
+            }
+            if (bufPos_ == bufSize_ && status_ != Status::End) fetchBlock();
             return progress;
         }
 
@@ -103,22 +160,34 @@ namespace NBT::IO {
         [[nodiscard]] bool compressed() const noexcept { return status_ == Status::Zstd; }
         // Raw source size in bytes; 0 if the source reported unknown (-1).
         [[nodiscard]] u64 getFileSize() const noexcept { return fileSize_ > 0 ? static_cast<u64>(fileSize_) : 0; }
+        // Decoded bytes left to read, or -1 if that isn't known (compressed data, or a source of unknown size).
+        [[nodiscard]] i64 remaining() const noexcept {
+            if (status_ == Status::End || status_ == Status::Empty) return 0;
+            if (status_ != Status::Plain || plainSize_ < 0) return -1;
+            const i64 unread = plainSize_ - static_cast<i64>(decoded_);
+            return unread > 0 ? unread : 0;
+        }
 
         bool close() noexcept {
             status_ = Status::End;
-            if (zstdStream_ != nullptr) { ZSTD_freeDStream(zstdStream_); zstdStream_ = nullptr; }
+            if (zstdStream_ != nullptr && ownsStream_) ZSTD_freeDStream(zstdStream_);
+            zstdStream_ = nullptr;
             src_ = nullptr;
             return true;
         }
 
-        ~FileReader() { if (zstdStream_ != nullptr) ZSTD_freeDStream(zstdStream_); }
+        ~FileReader() { if (zstdStream_ != nullptr && ownsStream_) ZSTD_freeDStream(zstdStream_); }
 
     private:
         S* src_{nullptr};
         i64 fileSize_{-1};
+        //Bytes after the magic of a plain source of known size, so `remaining` doesn't have to ask the source.
+        i64 plainSize_{-1};
+        mutable bool overrun_{false};
         u64 bufPos_{0}, bufSize_{0}, decoded_{0};
         vector<u8> buffer_, inBuffer_;
         ZSTD_DStream* zstdStream_{nullptr};
+        bool ownsStream_{true};
         ZSTD_inBuffer zsrc_{nullptr, 0, 0};
         enum struct Status : u8 { Plain, Zstd, End, Empty } status_{Status::End};
 
@@ -140,8 +209,9 @@ namespace NBT::IO {
                             zsrc_.pos = 0;
                             if (zsrc_.size == 0) break;
                         }
-                        const auto r = ZSTD_decompressStream(zstdStream_, &dst, &zsrc_);
-                        if (ZSTD_isError(r) || (r == 0 && dst.pos == 0)) break;
+                        //`r == 0` only ends the current frame. Concatenated frames (e.g. from `appendFile`) continue the same document,
+                        //so keep going until the input runs out, even if this call produced nothing (empty frame, trailing checksum).
+                        if (ZSTD_isError(ZSTD_decompressStream(zstdStream_, &dst, &zsrc_))) break;
                     }
                     bufSize_ = dst.pos;
                     if (bufSize_ == 0) status_ = isFirstFetch ? Status::Empty : Status::End;
@@ -1,13 +1,40 @@
 #pragma once
+#include <array>
+#include <cerrno>
 #include <cstring>
+#include <filesystem>
 #include <istream>
 #include <ostream>
 #include <span>
+#include <utility>
+#include <vector>
+#ifdef _WIN32
+    //Without these, `Windows.h` defines `min` and `max` macros for everyone including this header, which breaks `std::min(`.
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif // WIN32_LEAN_AND_MEAN
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif // NOMINMAX
+    #include <io.h>
+    #include <stdio.h>
+    #include <Windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <sys/uio.h>
+    #include <unistd.h>
+#endif // _WIN32
+
+#include "error.hpp"
+#include "FileReader.hpp"
 
 namespace NBT::IO {
     typedef uint8_t u8;
+    typedef uint64_t u64;
     typedef int64_t i64;
-    using std::istream, std::ostream, std::span, std::streamsize, std::streamoff, std::ios, std::memcpy, std::min;
+    using std::array, std::istream, std::ostream, std::span, std::streamsize, std::streamoff, std::ios, std::memcpy, std::min, std::exchange, std::vector, std::filesystem::path, NBT::Error::pushError;
 
     // std::istream adapter
     struct StdIn {
@@ -45,6 +72,49 @@ namespace NBT::IO {
         size_t pos_{0};
     };
 
+    // File descriptor adapter over the window `[offset, offset + size)`, read with `pread` (`ReadFile` at an offset on Windows). Any number of them can share one descriptor.
+    struct FdIn {
+        explicit FdIn(int fd, i64 offset, i64 size) noexcept : fd_(fd), offset_(offset), size_(size) {}
+        [[nodiscard]] size_t readBlock(u8* buf, size_t n) noexcept {
+            n = min(n, static_cast<size_t>(size_ - pos_));
+            size_t done = 0;
+            while (done < n) {
+#ifdef _WIN32
+                const u64 at = static_cast<u64>(offset_ + pos_) + done;
+                OVERLAPPED overlapped{};
+                overlapped.Offset = static_cast<DWORD>(at);
+                overlapped.OffsetHigh = static_cast<DWORD>(at >> 32);
+                DWORD count = 0;
+                if (!ReadFile(reinterpret_cast<HANDLE>(_get_osfhandle(fd_)), buf + done, static_cast<DWORD>(min<size_t>(n - done, 1u << 30)), &count, &overlapped)) break;
+#else
+                const ssize_t count = pread(fd_, buf + done, n - done, offset_ + pos_ + static_cast<i64>(done));
+                if (count < 0 && errno == EINTR) continue;
+#endif // _WIN32
+                if (count <= 0) break;
+                done += static_cast<size_t>(count);
+            }
+            pos_ += static_cast<i64>(done);
+            return done;
+        }
+        void incrementBy(size_t n) noexcept { pos_ = min(pos_ + static_cast<i64>(n), size_); }
+        [[nodiscard]] i64 getOffset() noexcept { return pos_; }
+        [[nodiscard]] i64 getSize() noexcept { return size_; }
+    private:
+        int fd_;
+        i64 offset_, size_, pos_{0};
+    };
+
+    // std::vector adapter, appends to the vector.
+    struct VecOut {
+        explicit VecOut(vector<u8>& v) noexcept : v_(v) {}
+        bool writeBlock(const u8* buf, size_t n) noexcept {
+            v_.insert(v_.end(), buf, buf + n);
+            return true;
+        }
+    private:
+        vector<u8>& v_;
+    };
+
     // std::ostream adapter
     struct StdOut {
         explicit StdOut(ostream& s) noexcept : s_(s) {}
@@ -55,4 +125,151 @@ namespace NBT::IO {
     private:
         ostream& s_;
     };
+
+    // File descriptor adapter. Segment lists go out through `writev`, or `pwritev` when an offset is given.
+    struct FdOut {
+        explicit FdOut(int fd, i64 offset = -1) noexcept : fd_(fd), offset_(offset) {}
+        bool writeBlock(const u8* buf, size_t n) noexcept {
+            const Segment segment{buf, n};
+            return writeSegments(span<const Segment>(&segment, 1));
+        }
+#ifdef _WIN32
+        bool writeSegments(span<const Segment> segments) noexcept {
+            for (const auto& segment : segments) {
+                size_t done = 0;
+                while (done < segment.size) {
+                    const unsigned chunk = static_cast<unsigned>(min<size_t>(segment.size - done, 1u << 30));
+                    if (offset_ >= 0) {
+                        //Positional, like `pwritev`, so the descriptor's file pointer is never shared state.
+                        const u64 at = static_cast<u64>(offset_) + done;
+                        OVERLAPPED overlapped{};
+                        overlapped.Offset = static_cast<DWORD>(at);
+                        overlapped.OffsetHigh = static_cast<DWORD>(at >> 32);
+                        DWORD written = 0;
+                        if (!WriteFile(reinterpret_cast<HANDLE>(_get_osfhandle(fd_)), segment.data + done, chunk, &written, &overlapped) || written == 0) return false;
+                        done += written;
+                        continue;
+                    }
+                    const int written = _write(fd_, segment.data + done, chunk);
+                    if (written <= 0) return false;
+                    done += static_cast<size_t>(written);
+                }
+                if (offset_ >= 0) offset_ += static_cast<i64>(segment.size);
+            }
+            return true;
+        }
+#else
+        bool writeSegments(span<const Segment> segments) noexcept {
+            array<iovec, 256> iov;
+            // `skip` is how much of `segments[next]` already went out after a short write.
+            size_t next = 0, skip = 0;
+            while (next < segments.size()) {
+                size_t count = 0, queued = 0;
+                for (size_t i = next; i < segments.size() && count < iov.size(); i++, count++) {
+                    const size_t head = i == next ? skip : 0;
+                    iov[count] = {const_cast<u8*>(segments[i].data) + head, segments[i].size - head};
+                    queued += segments[i].size - head;
+                }
+                const ssize_t written = offset_ >= 0 ? pwritev(fd_, iov.data(), static_cast<int>(count), offset_) : writev(fd_, iov.data(), static_cast<int>(count));
+                if (written < 0 && errno == EINTR) continue;
+                if (written < 0 || (written == 0 && queued > 0)) return false;
+                if (offset_ >= 0) offset_ += written;
+                size_t left = static_cast<size_t>(written);
+                while (next < segments.size() && left >= segments[next].size - skip) {
+                    left -= segments[next].size - skip;
+                    skip = 0;
+                    next++;
+                }
+                skip += left;
+            }
+            return true;
+        }
+#endif // _WIN32
+    private:
+        int fd_;
+        i64 offset_;
+    };
+
+    // Read-only memory mapping of a whole file. The pages are shared with every other process mapping the same file.
+    struct MappedFile {
+        MappedFile() noexcept = default;
+        explicit MappedFile(const path& file) noexcept { (void)open(file); }
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        MappedFile(MappedFile&& other) noexcept : data_(exchange(other.data_, nullptr)), size_(exchange(other.size_, 0)) {}
+        MappedFile& operator=(MappedFile&& other) noexcept {
+            if (this != &other) {
+                close();
+                data_ = exchange(other.data_, nullptr);
+                size_ = exchange(other.size_, 0);
+            }
+            return *this;
+        }
+        ~MappedFile() { close(); }
+
+        [[nodiscard]] bool open(const path& file) noexcept {
+            close();
+#ifdef _WIN32
+            const HANDLE handle = CreateFileW(file.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (handle == INVALID_HANDLE_VALUE) return fail(file);
+            LARGE_INTEGER size;
+            if (!GetFileSizeEx(handle, &size)) {
+                CloseHandle(handle);
+                return fail(file);
+            }
+            if (size.QuadPart > 0) {
+                const HANDLE mapping = CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                if (mapping != nullptr) data_ = static_cast<const u8*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+                if (mapping != nullptr) CloseHandle(mapping);
+                if (data_ == nullptr) {
+                    CloseHandle(handle);
+                    return fail(file);
+                }
+            }
+            CloseHandle(handle);
+            size_ = static_cast<size_t>(size.QuadPart);
+#else
+            const int fd = ::open(file.c_str(), O_RDONLY);
+            if (fd < 0) return fail(file);
+            struct stat info;
+            if (fstat(fd, &info) != 0) {
+                ::close(fd);
+                return fail(file);
+            }
+            if (info.st_size > 0) {
+                void* const mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+                if (mapped == MAP_FAILED) {
+                    ::close(fd);
+                    return fail(file);
+                }
+                data_ = static_cast<const u8*>(mapped);
+            }
+            ::close(fd);
+            size_ = static_cast<size_t>(info.st_size);
+#endif // _WIN32
+            return true;
+        }
+
+        void close() noexcept {
+            if (data_ != nullptr) {
+#ifdef _WIN32
+                UnmapViewOfFile(data_);
+#else
+                munmap(const_cast<u8*>(data_), size_);
+#endif // _WIN32
+            }
+            data_ = nullptr;
+            size_ = 0;
+        }
+
+        [[nodiscard]] span<const u8> data() const noexcept { return {data_, size_}; }
+    private:
+        const u8* data_{nullptr};
+        size_t size_{0};
+
+        [[nodiscard]] static bool fail(const path& file) noexcept {
+            pushError("Failed to map file " + file.string() + "!");
+            return false;
+        }
+    };
 }
\ No newline at end of file
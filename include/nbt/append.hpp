@@ -0,0 +1,105 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <vector>
+#include <zstd.h>
+
+#include "adapters.hpp"
+#include "error.hpp"
+#include "mapLike.hpp"
+#include "read.hpp"
+#include "types.hpp"
+#include "write.hpp"
+
+namespace NBT::IO {
+    typedef uint8_t u8;
+    typedef uint64_t u64;
+    using namespace NBT::Type;
+    using std::array, std::vector, std::string, std::format, std::ifstream, std::ofstream, std::ios, std::error_code, std::filesystem::path, NBT::Error::clearErrors, NBT::Error::pushError, NBT::MapLike::MapLike;
+
+    enum struct FileKinds : u8 { Missing, Plain, Zstd, Invalid };
+
+    //Looks at the first bytes only. Empty files count as `Missing`.
+    [[nodiscard]] inline FileKinds probeFile(const path& file) noexcept {
+        ifstream s(file, ios::binary);
+        if (!s) return FileKinds::Missing;
+        array<u8, 5> head{};
+        s.read(reinterpret_cast<char*>(head.data()), head.size());
+        const auto count = s.gcount();
+        if (count == 0) return FileKinds::Missing;
+        if (count == 5 && std::equal(MAGIC.begin(), MAGIC.end(), head.begin())) return FileKinds::Plain;
+        if (count >= 4 && (ZSTD_isFrame(head.data(), 4) || ZSTD_isSkippableFrame(head.data(), 4))) return FileKinds::Zstd;
+        return FileKinds::Invalid;
+    }
+
+    //Adds `entries` to the end of an existing file without reading or rewriting what is already there: plain files get the
+    //encoded members appended as-is (the top level runs to EOF), compressed files get a new zstd frame. Readers see the union
+    //of all appends, and for keys written more than once the last one wins. `zstd` only matters when the file doesn't exist yet.
+    //Appends are not atomic: a crash midway leaves a truncated tail that fails to parse. Use `compactFile` to fold the log.
+    template <typename P> requires MapLike<P>
+    [[nodiscard]] inline bool appendFile(const path& file, const typename P::template map<string, Tag<P>>& entries, bool zstd = false, u8 compressionLevel = 3) noexcept {
+        clearErrors();
+        const FileKinds kind = probeFile(file);
+        if (kind == FileKinds::Invalid) {
+            pushError(format("Can't append to \"{}\": not a CGNBT file!", file.string()));
+            return false;
+        }
+        const bool compressed = kind == FileKinds::Missing ? zstd : kind == FileKinds::Zstd;
+        if (entries.empty() && kind != FileKinds::Missing) return true;
+        vector<u8> encoded;
+        if (!writeData<P>(entries, encoded, kind == FileKinds::Missing && !compressed)) return false;
+        ofstream s(file, ios::binary | (kind == FileKinds::Missing ? ios::trunc : ios::app));
+        if (!s) {
+            pushError(format("Can't open \"{}\" for appending!", file.string()));
+            return false;
+        }
+        StdOut adapter(s);
+        if (!emitBuffer(adapter, encoded, compressed, compressionLevel)) return false;
+        s.flush();
+        if (!s) {
+            pushError(format("Failed to append to \"{}\"!", file.string()));
+            return false;
+        }
+        return true;
+    }
+
+    //Rewrites an appended-to file as a single document holding the last value of every key, keeping it compressed or plain.
+    //The result goes to a sibling file first and is renamed over the original, so a crash never loses the old log.
+    template <typename P> requires MapLike<P>
+    [[nodiscard]] inline bool compactFile(const path& file, u8 compressionLevel = 3) noexcept {
+        const FileKinds kind = probeFile(file);
+        if (kind == FileKinds::Missing || kind == FileKinds::Invalid) {
+            clearErrors();
+            pushError(format("Can't compact \"{}\": not a CGNBT file!", file.string()));
+            return false;
+        }
+        typename P::template map<string, Tag<P>> data;
+        {
+            ifstream s(file, ios::binary);
+            if (!readStream<P>(s, data)) return false;
+        }
+        path temporary = file;
+        temporary += ".compact";
+        {
+            ofstream s(temporary, ios::binary | ios::trunc);
+            if (!writeStream<P>(s, data, kind == FileKinds::Zstd, compressionLevel)) return false;
+            s.flush();
+            if (!s) {
+                pushError(format("Failed to write \"{}\"!", temporary.string()));
+                return false;
+            }
+        }
+        error_code error;
+        std::filesystem::rename(temporary, file, error);
+        if (error) {
+            pushError(format("Failed to replace \"{}\": {}", file.string(), error.message()));
+            return false;
+        }
+        return true;
+    }
+}
\ No newline at end of file
@@ -1,6 +1,8 @@
 #pragma once
+#include <algorithm>
 #include <array>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "FileReader.hpp"
@@ -9,44 +11,67 @@ namespace NBT::Aux {
     typedef uint8_t u8;
     typedef int64_t i64;
     typedef uint64_t u64;
-    using std::array, std::string, std::vector, NBT::IO::FileReader, NBT::IO::Readable;
+    using std::array, std::string, std::string_view, std::vector, NBT::IO::FileReader, NBT::IO::Readable;
 
     inline constexpr u8 MSB = 0x80;
 
+    //Reuses `result`'s capacity. Copies whole runs of the reader's buffer, so text that doesn't straddle two blocks is
+    //appended, and allocated for, in one go.
     template<Readable S>
-    [[nodiscard]] inline string readVarText(FileReader<S>& cursor) noexcept {
-        vector<u8> buffer;
-        while (!(*cursor & MSB)) {
-            buffer.push_back(*cursor);
-            ++cursor;
+    inline void readVarText(FileReader<S>& cursor, string& result) noexcept {
+        result.clear();
+        while (true) {
+            const auto block = cursor.buffered();
+            //At EOF, `EOF_BYTE` ends the text and flags the overrun.
+            if (block.empty()) {
+                result.push_back(static_cast<char>(*cursor));
+                break;
+            }
+            const auto last = std::find_if(block.begin(), block.end(), [](u8 byte) { return (byte & MSB) != 0; });
+            const bool complete = last != block.end();
+            const u64 length = static_cast<u64>(last - block.begin()) + complete;
+            result.append(reinterpret_cast<const char*>(block.data()), length);
+            (void)cursor.skip(length);
+            if (complete) break;
         }
-        buffer.push_back(*cursor);
+        result.back() = static_cast<char>(result.back() - MSB);
+        if (const auto end = result.find('\0'); end != string::npos) result.resize(end);
+    }
+
+    //Built in place: keys that fit the small string buffer don't allocate, longer ones allocate once.
+    template<Readable S>
+    [[nodiscard]] inline string readVarText(FileReader<S>& cursor) noexcept {
+        string result;
+        readVarText(cursor, result);
+        return result;
+    }
+
+    template<Readable S>
+    inline void skipVarText(FileReader<S>& cursor) noexcept {
+        while (!(*cursor & MSB)) ++cursor;
         ++cursor;
-        buffer[buffer.size() - 1] -= MSB;
-        buffer.push_back('\0');
-        return string(reinterpret_cast<const char*>(buffer.data()));
     }
 
-    inline void writeVarText(const string& text, vector<u8>& result) noexcept {
+    inline void writeVarText(string_view text, vector<u8>& result) noexcept {
         result.insert(result.end(), text.begin(), text.end());
         result[result.size() - 1] += MSB;
     }
 
     // Sets cursor to the start of the next byte.
+    // Bits past the 64th of an overlong encoding are dropped; the bytes are still consumed.
     template<Readable S>
     [[nodiscard]] inline u64 readUVarInt(FileReader<S>& cursor) noexcept {
-        u8 length = 1;
-        array<u8, 10> buffer{};
-        buffer[0] = *cursor;
-        while (!(*cursor & MSB)) {
+        u64 result = 0;
+        u8 shift = 0;
+        while (true) {
+            const u8 byte = *cursor;
             ++cursor;
-            buffer[length] = *cursor;
-            length++;
+            if (shift < 64) {
+                result |= static_cast<u64>(byte & (MSB - 1)) << shift;
+                shift += 7;
+            }
+            if (byte & MSB) return result;
         }
-        ++cursor;
-        u64 result = 0;
-        for (u8 i = 0; i < length; i++) result |= static_cast<u64>(buffer[i] & (MSB - 1)) << (7 * i);
-        return result;
     }
 
     // Sets cursor to the start of the next byte.
@@ -59,11 +84,12 @@ namespace NBT::Aux {
     inline void writeUVarInt(u64 data, vector<u8>& result) noexcept {
         array<u8, 10> buffer{};
         u8 cursor = 0;
-        while (data > 0) {
+        //At least one byte: zero is encoded as a lone terminator.
+        do {
             buffer[cursor] = static_cast<u8>(data & static_cast<i64>(MSB - 1));
             cursor++;
             data >>= 7;
-        }
+        } while (data > 0);
         #pragma warning(suppress: 28020)
         buffer[cursor - 1] += MSB;
         result.insert(result.end(), buffer.begin(), buffer.begin() + cursor);
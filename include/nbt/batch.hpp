@@ -0,0 +1,285 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+#include <zstd.h>
+#ifdef _WIN32
+    #include <fcntl.h>
+    #include <io.h>
+    #include <sys/stat.h>
+#else
+    #include <fcntl.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif // _WIN32
+
+#include "adapters.hpp"
+#include "error.hpp"
+#include "mapLike.hpp"
+#include "parallel.hpp"
+#include "read.hpp"
+#include "region.hpp"
+#include "types.hpp"
+#include "write.hpp"
+
+namespace NBT::Batch {
+    typedef uint8_t u8;
+    typedef int64_t i64;
+    typedef uint64_t u64;
+    using namespace NBT::Type;
+    using std::string, std::vector, std::deque, std::span, std::make_shared, std::mutex, std::lock_guard, std::unique_lock, std::condition_variable, std::move, std::format, std::filesystem::path, NBT::Error::clearErrors, NBT::Error::pushError, NBT::Error::getErrors, NBT::MapLike::MapLike, NBT::Parallel::Pool;
+
+    //One finished load. `index` is the position of the item in the request; `errors` are the worker's errors for it.
+    template <typename P> requires MapLike<P>
+    struct Loaded {
+        u64 index{0};
+        bool success{false};
+        typename P::template map<string, Tag<P>> data;
+        vector<string> errors;
+    };
+
+    struct Saved {
+        u64 index{0};
+        bool success{false};
+        vector<string> errors;
+    };
+
+    //Results in the order they complete. Every batch call announces how many results it will deliver, so `pop` knows when
+    //everything has arrived. Error lists travel with the results, since errors are kept per thread.
+    template <typename T>
+    class CompletionQueue {
+    public:
+        CompletionQueue() noexcept = default;
+        CompletionQueue(const CompletionQueue&) = delete;
+        CompletionQueue& operator=(const CompletionQueue&) = delete;
+
+        //Blocks until a result is ready. Returns false once every announced result has been taken.
+        [[nodiscard]] bool pop(T& result) noexcept {
+            unique_lock lock(lock_);
+            ready_.wait(lock, [this] { return !results_.empty() || outstanding_ == 0; });
+            return take(result);
+        }
+
+        [[nodiscard]] bool tryPop(T& result) noexcept {
+            lock_guard lock(lock_);
+            return take(result);
+        }
+
+        //Results announced but not taken yet, including those still in flight.
+        [[nodiscard]] u64 outstanding() const noexcept {
+            lock_guard lock(lock_);
+            return outstanding_;
+        }
+
+        void expect(u64 count) noexcept {
+            lock_guard lock(lock_);
+            outstanding_ += count;
+        }
+
+        void push(T&& result) noexcept {
+            {
+                lock_guard lock(lock_);
+                results_.push_back(move(result));
+            }
+            ready_.notify_one();
+        }
+
+    private:
+        mutable mutex lock_;
+        condition_variable ready_;
+        deque<T> results_;
+        u64 outstanding_{0};
+
+        [[nodiscard]] bool take(T& result) noexcept {
+            if (results_.empty()) return false;
+            result = move(results_.front());
+            results_.pop_front();
+            outstanding_--;
+            if (outstanding_ == 0) ready_.notify_all();
+            return true;
+        }
+    };
+
+    namespace detail {
+        //Per worker thread, so every item a worker handles reuses the same zstd contexts and buffers.
+        struct Context {
+            ZSTD_DStream* decompress{ZSTD_createDStream()};
+            ZSTD_CCtx* compress{ZSTD_createCCtx()};
+            vector<u8> raw, encoded;
+
+            Context() noexcept = default;
+            Context(const Context&) = delete;
+            Context& operator=(const Context&) = delete;
+            ~Context() {
+                ZSTD_freeDStream(decompress);
+                ZSTD_freeCCtx(compress);
+            }
+        };
+
+        [[nodiscard]] inline Context& context() noexcept {
+            static thread_local Context result;
+            return result;
+        }
+
+        inline void closeFile(int fd) noexcept {
+#ifdef _WIN32
+            _close(fd);
+#else
+            ::close(fd);
+#endif // _WIN32
+        }
+
+        //The whole file with one positioned read.
+        [[nodiscard]] inline bool readFile(const path& file, vector<u8>& result) noexcept {
+#ifdef _WIN32
+            const int fd = _wopen(file.c_str(), _O_RDONLY | _O_BINARY);
+            struct _stat64 info;
+            const bool sized = fd >= 0 && _fstat64(fd, &info) == 0;
+#else
+            const int fd = ::open(file.c_str(), O_RDONLY);
+            struct stat info;
+            const bool sized = fd >= 0 && fstat(fd, &info) == 0;
+#endif // _WIN32
+            if (!sized) {
+                if (fd >= 0) closeFile(fd);
+                pushError(format("Can't open \"{}\"!", file.string()));
+                return false;
+            }
+            result.resize(static_cast<u64>(info.st_size));
+            IO::FdIn input(fd, 0, static_cast<i64>(info.st_size));
+            const bool complete = input.readBlock(result.data(), result.size()) == result.size();
+            closeFile(fd);
+            if (!complete) pushError(format("Failed to read \"{}\"!", file.string()));
+            return complete;
+        }
+
+        //Encodes into the worker's buffers; `result` points at whichever one holds the bytes to store.
+        template <typename P> requires MapLike<P>
+        [[nodiscard]] inline bool encode(const typename P::template map<string, Tag<P>>& data, bool zstd, u8 compressionLevel, span<const u8>& result) noexcept {
+            Context& local = context();
+            local.raw.clear();
+            if (!IO::writeData<P>(data, local.raw, !zstd)) return false;
+            if (!zstd) {
+                result = local.raw;
+                return true;
+            }
+            const int level = compressionLevel > 22 ? 22 : compressionLevel == 0 ? 1 : compressionLevel;
+            local.encoded.resize(ZSTD_compressBound(local.raw.size()));
+            const size_t size = ZSTD_compressCCtx(local.compress, local.encoded.data(), local.encoded.size(), local.raw.data(), local.raw.size(), level);
+            if (ZSTD_isError(size)) {
+                pushError(format("ZSTD compression error: {}", ZSTD_getErrorName(size)));
+                return false;
+            }
+            result = span<const u8>(local.encoded).first(size);
+            return true;
+        }
+
+        [[nodiscard]] inline bool writeFile(const path& file, span<const u8> data) noexcept {
+#ifdef _WIN32
+            const int fd = _wopen(file.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+            const int fd = ::open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif // _WIN32
+            if (fd < 0) {
+                pushError(format("Can't open \"{}\" for writing!", file.string()));
+                return false;
+            }
+            const bool written = IO::FdOut(fd).writeBlock(data.data(), data.size());
+            closeFile(fd);
+            if (!written) pushError(format("Failed to write to \"{}\"!", file.string()));
+            return written;
+        }
+
+        template <typename P> requires MapLike<P>
+        inline void decode(u64 index, bool fetched, CompletionQueue<Loaded<P>>& queue) noexcept {
+            Loaded<P> result;
+            result.index = index;
+            if (fetched) {
+                IO::SpanIn input(context().raw);
+                result.success = IO::readStream<P>(input, result.data, context().decompress);
+            }
+            if (!result.success) result.errors = getErrors();
+            queue.push(move(result));
+        }
+
+        inline void report(u64 index, bool success, CompletionQueue<Saved>& queue) noexcept {
+            queue.push(Saved{index, success, success ? vector<string>() : getErrors()});
+        }
+
+        [[nodiscard]] inline bool mismatch(u64 targets, u64 documents) noexcept {
+            clearErrors();
+            if (targets == documents) return false;
+            pushError(format("Batch save got {} targets for {} documents!", targets, documents));
+            return true;
+        }
+    }
+
+    //Reads, decompresses and parses every file on `pool`, one task per file. Each result goes to `queue` as it completes.
+    //`files` has to stay alive until all of its results were delivered.
+    template <typename P> requires MapLike<P>
+    inline void load(Pool& pool, span<const path> files, CompletionQueue<Loaded<P>>& queue) noexcept {
+        queue.expect(files.size());
+        for (u64 i = 0; i < files.size(); i++) pool.submit([&file = files[i], &queue, i] {
+            clearErrors();
+            detail::decode<P>(i, detail::readFile(file, detail::context().raw), queue);
+        });
+    }
+
+    //Same for the entries of a region. `region` must not be written to while the batch runs.
+    template <typename P> requires MapLike<P>
+    inline void load(Pool& pool, const Region::File& region, span<const string> keys, CompletionQueue<Loaded<P>>& queue) noexcept {
+        queue.expect(keys.size());
+        for (u64 i = 0; i < keys.size(); i++) pool.submit([&region, &key = keys[i], &queue, i] {
+            detail::decode<P>(i, region.readBytes(key, detail::context().raw), queue);
+        });
+    }
+
+    //Encodes, compresses and writes `documents[i]` to `files[i]` on `pool`. Both have to stay alive until all results were delivered.
+    //Returns false without starting anything if the two don't have the same length.
+    template <typename P> requires MapLike<P>
+    [[nodiscard]] inline bool save(Pool& pool, span<const path> files, span<const typename P::template map<string, Tag<P>>> documents, CompletionQueue<Saved>& queue, bool zstd = false, u8 compressionLevel = 3) noexcept {
+        if (detail::mismatch(files.size(), documents.size())) return false;
+        queue.expect(files.size());
+        for (u64 i = 0; i < files.size(); i++) pool.submit([&file = files[i], &document = documents[i], &queue, i, zstd, compressionLevel] {
+            clearErrors();
+            span<const u8> encoded;
+            detail::report(i, detail::encode<P>(document, zstd, compressionLevel, encoded) && detail::writeFile(file, encoded), queue);
+        });
+        return true;
+    }
+
+    //Stores `documents[i]` under `keys[i]`. Encoding and writing run in parallel; only reserving sectors in `region` and
+    //publishing the index entries is serialized. Nothing is committed until `region.flush()`.
+    template <typename P> requires MapLike<P>
+    [[nodiscard]] inline bool save(Pool& pool, Region::File& region, span<const string> keys, span<const typename P::template map<string, Tag<P>>> documents, CompletionQueue<Saved>& queue, bool zstd = false, u8 compressionLevel = 3) noexcept {
+        if (detail::mismatch(keys.size(), documents.size())) return false;
+        const auto placing = make_shared<mutex>();
+        queue.expect(keys.size());
+        for (u64 i = 0; i < keys.size(); i++) pool.submit([&region, &key = keys[i], &document = documents[i], &queue, placing, i, zstd, compressionLevel] {
+            clearErrors();
+            span<const u8> encoded;
+            bool success = detail::encode<P>(document, zstd, compressionLevel, encoded);
+            Region::Entry entry;
+            if (success) {
+                lock_guard lock(*placing);
+                success = region.reserve(key, encoded.size(), zstd, entry);
+            }
+            if (success) {
+                const bool written = region.writeReserved(key, entry, encoded);
+                lock_guard lock(*placing);
+                if (written) region.commit(key, entry);
+                else region.cancel(entry);
+                success = written;
+            }
+            detail::report(i, success, queue);
+        });
+        return true;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,188 @@
+#pragma once
+#include <bit>
+#include <format>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "auxiliary.hpp"
+#include "error.hpp"
+#include "types.hpp"
+#include "write.hpp"
+
+namespace NBT::IO {
+    typedef uint8_t u8;
+    typedef uint32_t u32;
+    typedef int64_t i64;
+    typedef uint64_t u64;
+    using namespace NBT::Type;
+    using std::span, std::string_view, std::vector, std::format, std::bit_cast, NBT::Aux::writeVarText, NBT::Error::clearErrors, NBT::Error::pushError;
+
+    //Encodes CGNBT straight into a byte buffer, without building a `Tag` tree first. The calls follow the document:
+    //members of objects take a key, elements of arrays don't. The first misuse (wrong element type, element count mismatch,
+    //unbalanced begin/end) is reported through `pushError`, after which every call is a no-op and `finish` returns `false`.
+    //`Bool`, `Hex`, `Float`, `Double` and `Raw` can't be array elements, use the typed array calls for those.
+    struct Builder {
+        [[nodiscard]] explicit Builder(vector<u8>& out, bool addMagic = false) noexcept : out_(&out) { reset(addMagic); }
+
+        //Starts a new document in the same buffer, keeping every allocation.
+        void reset(bool addMagic = false) noexcept {
+            clearErrors();
+            out_->clear();
+            if (addMagic) out_->insert(out_->end(), MAGIC.begin(), MAGIC.end());
+            stack_.clear();
+            stack_.push_back({false, Types::Object, 0});
+            failed_ = false;
+        }
+
+        Builder& beginObject(string_view key) noexcept {
+            if (member(getHead(Types::Object), key)) stack_.push_back({false, Types::Object, 0});
+            return *this;
+        }
+        Builder& beginObject() noexcept {
+            if (element(Types::Object)) stack_.push_back({false, Types::Object, 0});
+            return *this;
+        }
+        Builder& endObject() noexcept {
+            if (failed_) return *this;
+            if (stack_.size() < 2 || stack_.back().array) return fail("endObject() without a matching beginObject()!");
+            stack_.pop_back();
+            out_->push_back(static_cast<u8>(Types::ObjectEnd));
+            return *this;
+        }
+
+        //`elementType` is one of `Object`, `IVarInt`, `UVarInt`, `Array`, `String` or a typed array type.
+        Builder& beginArray(string_view key, Types elementType, u64 count) noexcept {
+            if (!validElement(elementType)) return fail(format("Invalid array element type {}!", static_cast<u8>(elementType)));
+            if (member(getHead(Types::Array) | static_cast<u8>(getOriginalType(elementType)), key)) openArray(elementType, count);
+            return *this;
+        }
+        Builder& beginArray(Types elementType, u64 count) noexcept {
+            if (!validElement(elementType)) return fail(format("Invalid array element type {}!", static_cast<u8>(elementType)));
+            if (element(Types::Array)) {
+                out_->push_back(getHead(Types::Array) | static_cast<u8>(getOriginalType(elementType)));
+                openArray(elementType, count);
+            }
+            return *this;
+        }
+        Builder& endArray() noexcept {
+            if (failed_) return *this;
+            if (stack_.size() < 2 || !stack_.back().array) return fail("endArray() without a matching beginArray()!");
+            if (stack_.back().remaining != 0) return fail(format("Array closed with {} element(s) missing!", stack_.back().remaining));
+            stack_.pop_back();
+            return *this;
+        }
+
+        Builder& writeIVarInt(string_view key, i64 value) noexcept { if (member(getHead(Types::IVarInt), key)) Aux::writeIVarInt(value, *out_); return *this; }
+        Builder& writeIVarInt(i64 value) noexcept { if (element(Types::IVarInt)) Aux::writeIVarInt(value, *out_); return *this; }
+        Builder& writeUVarInt(string_view key, u64 value) noexcept { if (member(getHead(Types::UVarInt), key)) Aux::writeUVarInt(value, *out_); return *this; }
+        Builder& writeUVarInt(u64 value) noexcept { if (element(Types::UVarInt)) Aux::writeUVarInt(value, *out_); return *this; }
+        Builder& writeBool(string_view key, bool value) noexcept { (void)member(getHead(Types::Bool) | (value ? 0x01 : 0x00), key); return *this; }
+        Builder& writeHex(string_view key, u8 value) noexcept { (void)member(getHead(Types::Hex) | (value & 0x0F), key); return *this; }
+        Builder& writeFloat(string_view key, float value) noexcept { if (member(getHead(Types::Float), key)) fixed(bit_cast<u32>(value)); return *this; }
+        Builder& writeDouble(string_view key, double value) noexcept { if (member(getHead(Types::Double), key)) fixed(bit_cast<u64>(value)); return *this; }
+        Builder& writeRaw(string_view key, u8 value) noexcept { if (member(getHead(Types::Raw), key)) out_->push_back(value); return *this; }
+        Builder& writeString(string_view key, string_view value) noexcept { if (member(getHead(Types::String), key)) bulk(span<const char>(value)); return *this; }
+        Builder& writeString(string_view value) noexcept { if (element(Types::String)) bulk(span<const char>(value)); return *this; }
+
+        //Typed arrays. Booleans and hex digits are one byte per entry like in `TagArrayBool`/`TagArrayHex`, and are masked on the way out.
+        Builder& writeArrayBool(string_view key, span<const u8> values) noexcept { if (member(getHead(Types::ArrayBool), key)) masked(values, 0x01); return *this; }
+        Builder& writeArrayBool(span<const u8> values) noexcept { if (typedElement(Types::ArrayBool)) masked(values, 0x01); return *this; }
+        Builder& writeArrayHex(string_view key, span<const u8> values) noexcept { if (member(getHead(Types::ArrayHex), key)) masked(values, 0x0F); return *this; }
+        Builder& writeArrayHex(span<const u8> values) noexcept { if (typedElement(Types::ArrayHex)) masked(values, 0x0F); return *this; }
+        Builder& writeArrayFloat(string_view key, span<const float> values) noexcept { if (member(getHead(Types::ArrayFloat), key)) bulk(values); return *this; }
+        Builder& writeArrayFloat(span<const float> values) noexcept { if (typedElement(Types::ArrayFloat)) bulk(values); return *this; }
+        Builder& writeArrayDouble(string_view key, span<const double> values) noexcept { if (member(getHead(Types::ArrayDouble), key)) bulk(values); return *this; }
+        Builder& writeArrayDouble(span<const double> values) noexcept { if (typedElement(Types::ArrayDouble)) bulk(values); return *this; }
+        Builder& writeArrayRaw(string_view key, span<const u8> values) noexcept { if (member(getHead(Types::ArrayRaw), key)) bulk(values); return *this; }
+        Builder& writeArrayRaw(span<const u8> values) noexcept { if (typedElement(Types::ArrayRaw)) bulk(values); return *this; }
+
+        //`true` if the document is complete and well-formed. The buffer is then ready for `writeBlock` or zstd.
+        [[nodiscard]] bool finish() noexcept {
+            if (!failed_ && stack_.size() != 1) fail(format("{} object(s) or array(s) left open!", stack_.size() - 1));
+            return !failed_;
+        }
+
+        [[nodiscard]] bool good() const noexcept { return !failed_; }
+
+    private:
+        //For arrays, `type` is the element type.
+        struct Frame {
+            bool array;
+            Types type;
+            u64 remaining;
+        };
+        vector<u8>* out_;
+        vector<Frame> stack_;
+        bool failed_{false};
+
+        Builder& fail(const string& error) noexcept {
+            if (!failed_) pushError(error);
+            failed_ = true;
+            return *this;
+        }
+
+        [[nodiscard]] static constexpr bool validElement(Types type) noexcept {
+            switch (type) {
+                case Types::Object: case Types::IVarInt: case Types::UVarInt: case Types::Array: case Types::String:
+                case Types::ArrayBool: case Types::ArrayHex: case Types::ArrayFloat: case Types::ArrayDouble: case Types::ArrayRaw:
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        [[nodiscard]] bool member(u8 head, string_view key) noexcept {
+            if (failed_) return false;
+            if (stack_.back().array) {
+                fail(format("Keyed member \"{}\" written inside an array!", key));
+                return false;
+            }
+            out_->push_back(head);
+            writeVarText(key, *out_);
+            return true;
+        }
+
+        [[nodiscard]] bool element(Types type) noexcept {
+            if (failed_) return false;
+            auto& frame = stack_.back();
+            if (!frame.array) fail(format("Array element of type {} written into an object without a key!", static_cast<u8>(type)));
+            else if (frame.type != type) fail(format("Array element of type {} written into an array of type {}!", static_cast<u8>(type), static_cast<u8>(frame.type)));
+            else if (frame.remaining == 0) fail("More array elements written than announced!");
+            else {
+                frame.remaining--;
+                return true;
+            }
+            return false;
+        }
+
+        //Typed arrays nested in an array repeat their head byte per element.
+        [[nodiscard]] bool typedElement(Types type) noexcept {
+            if (!element(type)) return false;
+            out_->push_back(getHead(type));
+            return true;
+        }
+
+        void openArray(Types elementType, u64 count) noexcept {
+            Aux::writeUVarInt(count, *out_);
+            stack_.push_back({true, elementType, count});
+        }
+
+        template <typename T>
+        void fixed(T bits) noexcept {
+            for (u8 i = 0; i < sizeof(T); i++) out_->push_back(static_cast<u8>(bits >> i * 8));
+        }
+
+        template <typename T>
+        void bulk(span<const T> values) noexcept {
+            Aux::writeUVarInt(values.size(), *out_);
+            const auto* const bytes = reinterpret_cast<const u8*>(values.data());
+            out_->insert(out_->end(), bytes, bytes + values.size_bytes());
+        }
+
+        void masked(span<const u8> values, u8 mask) noexcept {
+            Aux::writeUVarInt(values.size(), *out_);
+            for (const auto value : values) out_->push_back(value & mask);
+        }
+    };
+}
\ No newline at end of file
@@ -0,0 +1,217 @@
+#pragma once
+#include <filesystem>
+#include <format>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+
+#include "adapters.hpp"
+#include "error.hpp"
+#include "mapLike.hpp"
+#include "read.hpp"
+#include "types.hpp"
+
+namespace NBT::Cache {
+    typedef uint64_t u64;
+    using namespace NBT::Type;
+    using std::string, std::list, std::unordered_map, std::function, std::shared_ptr, std::make_shared, std::shared_future, std::promise, std::mutex, std::lock_guard, std::unique_lock, std::move, std::format, std::error_code, std::filesystem::path, NBT::Error::clearErrors, NBT::Error::pushError, NBT::MapLike::MapLike;
+
+    namespace detail {
+        //Heap bytes behind a string; short strings live inside the object.
+        [[nodiscard]] inline u64 heap(const string& text) noexcept { return text.capacity() > string().capacity() ? text.capacity() + 1 : 0; }
+
+        template <typename P> requires MapLike<P>
+        [[nodiscard]] inline u64 footprint(const Tag<P>& tag) noexcept;
+
+        template <typename P> requires MapLike<P>
+        [[nodiscard]] inline u64 footprint(const typename P::template map<string, Tag<P>>& members) noexcept {
+            using Map = typename P::template map<string, Tag<P>>;
+            //One heap node per member with two links, as node-based maps allocate them.
+            u64 result = 0;
+            for (const auto& [key, value] : members) result += sizeof(typename Map::value_type) + 2 * sizeof(void*) + heap(key) + footprint<P>(value);
+            if constexpr (requires { members.bucket_count(); }) result += members.bucket_count() * sizeof(void*);
+            return result;
+        }
+
+        template <typename P> requires MapLike<P>
+        [[nodiscard]] inline u64 footprint(const Tag<P>& tag) noexcept {
+            switch (tag.type) {
+                case Types::Object:      return footprint<P>(tag.tagObject.payload);
+                case Types::String:      return heap(tag.tagString.payload);
+                case Types::ArrayBool:   return tag.tagArrayBool.payload.capacity();
+                case Types::ArrayHex:    return tag.tagArrayHex.payload.capacity();
+                case Types::ArrayRaw:    return tag.tagArrayRaw.payload.capacity();
+                case Types::ArrayFloat:  return tag.tagArrayFloat.payload.capacity() * sizeof(float);
+                case Types::ArrayDouble: return tag.tagArrayDouble.payload.capacity() * sizeof(double);
+                case Types::Array: {
+                    u64 result = tag.tagArray.payload.capacity() * sizeof(Tag<P>);
+                    for (const auto& element : tag.tagArray.payload) result += footprint<P>(element);
+                    return result;
+                }
+                default:                 return 0;
+            }
+        }
+    }
+
+    //Heap memory a decoded document holds on to, measured from its actual containers rather than its encoded size.
+    template <typename P> requires MapLike<P>
+    [[nodiscard]] inline u64 footprint(const typename P::template map<string, Tag<P>>& data) noexcept { return sizeof(data) + detail::footprint<P>(data); }
+
+    //Keeps decoded documents in memory for repeated reads, least recently used first out once `budget` bytes are exceeded.
+    //Documents are handed out as `shared_ptr<const Map>`: they are immutable, and evicting one doesn't invalidate handles to it.
+    //Files are keyed by path and revalidated against their modification time and size on every lookup. Caller keys share
+    //the same namespace. Concurrent misses on one key are coalesced: one thread decodes while the others wait for its result.
+    //Thread-safe.
+    template <typename P> requires MapLike<P>
+    class DocumentCache {
+    public:
+        using Map = typename P::template map<string, Tag<P>>;
+        using Handle = shared_ptr<const Map>;
+        //Fills the map, returns false (with errors pushed) on failure.
+        using Loader = function<bool(Map&)>;
+
+        [[nodiscard]] explicit DocumentCache(u64 budget) noexcept : budget_(budget) {}
+        DocumentCache(const DocumentCache&) = delete;
+        DocumentCache& operator=(const DocumentCache&) = delete;
+
+        //Returns the cached document for `file`, decoding it again if it changed on disk since it was cached.
+        [[nodiscard]] bool get(const path& file, Handle& result) noexcept {
+            clearErrors();
+            error_code error;
+            const auto time = std::filesystem::last_write_time(file, error);
+            const u64 size = error ? 0 : static_cast<u64>(std::filesystem::file_size(file, error));
+            if (error) {
+                pushError(format("Can't open \"{}\": {}", file.string(), error.message()));
+                return false;
+            }
+            const Identity identity{static_cast<u64>(time.time_since_epoch().count()), size};
+            return fetch(file.string(), identity, [&file](Map& data) {
+                IO::MappedFile mapped;
+                return mapped.open(file) && IO::readData<P>(mapped.data(), data);
+            }, result);
+        }
+
+        //Returns the document cached under `key`, calling `load` to produce it on a miss.
+        [[nodiscard]] bool get(const string& key, const Loader& load, Handle& result) noexcept {
+            clearErrors();
+            return fetch(key, Identity{}, load, result);
+        }
+
+        //Drops `key` from the cache; handles given out before stay valid.
+        void erase(const string& key) noexcept {
+            lock_guard lock(lock_);
+            if (const auto it = entries_.find(key); it != entries_.end() && it->second.value) drop(it);
+        }
+
+        void clear() noexcept {
+            lock_guard lock(lock_);
+            for (auto it = entries_.begin(); it != entries_.end();) {
+                if (it->second.value) {
+                    bytes_ -= it->second.bytes;
+                    order_.erase(it->second.position);
+                    it = entries_.erase(it);
+                }
+                else ++it;
+            }
+        }
+
+        //Lowering the budget evicts right away.
+        void setBudget(u64 budget) noexcept {
+            lock_guard lock(lock_);
+            budget_ = budget;
+            evict();
+        }
+
+        [[nodiscard]] u64 budget() const noexcept { lock_guard lock(lock_); return budget_; }
+        [[nodiscard]] u64 bytes() const noexcept { lock_guard lock(lock_); return bytes_; }
+        [[nodiscard]] u64 size() const noexcept { lock_guard lock(lock_); return order_.size(); }
+        [[nodiscard]] u64 hits() const noexcept { lock_guard lock(lock_); return hits_; }
+        [[nodiscard]] u64 misses() const noexcept { lock_guard lock(lock_); return misses_; }
+
+    private:
+        struct Identity {
+            u64 time{0}, size{0};
+            [[nodiscard]] bool operator==(const Identity&) const noexcept = default;
+        };
+        struct Entry {
+            Identity identity;
+            //Empty while the document is being decoded; `pending` delivers it to everyone who asked in the meantime.
+            Handle value;
+            shared_future<Handle> pending;
+            u64 bytes{0};
+            list<string>::iterator position;
+        };
+
+        mutable mutex lock_;
+        unordered_map<string, Entry> entries_;
+        //Most recently used at the front.
+        list<string> order_;
+        u64 budget_, bytes_{0}, hits_{0}, misses_{0};
+
+        [[nodiscard]] bool fetch(const string& key, const Identity& identity, const Loader& load, Handle& result) noexcept {
+            promise<Handle> loaded;
+            {
+                unique_lock lock(lock_);
+                auto it = entries_.find(key);
+                if (it != entries_.end() && it->second.identity == identity) {
+                    hits_++;
+                    if (it->second.value) {
+                        order_.splice(order_.begin(), order_, it->second.position);
+                        result = it->second.value;
+                        return true;
+                    }
+                    shared_future<Handle> pending = it->second.pending;
+                    lock.unlock();
+                    result = pending.get();
+                    if (result) return true;
+                    pushError(format("Loading \"{}\" failed in another thread!", key));
+                    return false;
+                }
+                //A stale file is replaced. If it is still being decoded, its waiters keep their own future.
+                if (it != entries_.end()) {
+                    if (it->second.value) drop(it);
+                    else entries_.erase(it);
+                }
+                misses_++;
+                entries_.emplace(key, Entry{identity, nullptr, loaded.get_future().share(), 0, {}});
+            }
+            auto data = make_shared<Map>();
+            const bool success = load(*data);
+            const u64 bytes = success ? footprint<P>(*data) : 0;
+            {
+                lock_guard lock(lock_);
+                auto it = entries_.find(key);
+                const bool ours = it != entries_.end() && !it->second.value && it->second.identity == identity;
+                if (ours && !success) entries_.erase(it);
+                else if (ours) {
+                    order_.push_front(key);
+                    it->second.value = data;
+                    it->second.bytes = bytes;
+                    it->second.position = order_.begin();
+                    bytes_ += bytes;
+                    evict();
+                }
+            }
+            loaded.set_value(success ? Handle(data) : nullptr);
+            if (success) result = move(data);
+            return success;
+        }
+
+        void drop(typename unordered_map<string, Entry>::iterator it) noexcept {
+            bytes_ -= it->second.bytes;
+            order_.erase(it->second.position);
+            entries_.erase(it);
+        }
+
+        //A document larger than the whole budget is still returned to its caller, just not kept.
+        void evict() noexcept {
+            while (bytes_ > budget_ && !order_.empty()) drop(entries_.find(order_.back()));
+        }
+    };
+}
\ No newline at end of file
@@ -0,0 +1,292 @@
+#pragma once
+#include <algorithm>
+#include <format>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "error.hpp"
+#include "mapLike.hpp"
+#include "query.hpp"
+#include "read.hpp"
+#include "types.hpp"
+#include "write.hpp"
+
+namespace NBT::Diff {
+    typedef uint8_t u8;
+    typedef uint64_t u64;
+    using namespace NBT::Type;
+    using std::span, std::string, std::vector, std::format, std::move, NBT::Error::clearErrors, NBT::Error::pushError, NBT::MapLike::MapLike, NBT::Query::Path, NBT::Query::Step, NBT::Query::Steps;
+
+    //Runs of changed elements closer than this are sent as one `Range`, since each op costs about a dozen bytes on its own.
+    inline constexpr u64 RANGE_GAP = 16;
+
+    enum class Ops : u8 {
+        Set,    //Inserts or replaces the value at `path` with `value`.
+        Remove, //Removes the object member `path` points to.
+        Resize, //Resizes the array, string or typed array at `path` to `count` elements. New `Array` elements are invalid until `Set`.
+        Range   //Overwrites elements `[count, count + size)` of the string or typed array at `path` with `value`, which has the same type.
+    };
+
+    template <typename P> requires MapLike<P>
+    struct Op {
+        Ops kind;
+        Path path;
+        Tag<P> value;
+        u64 count{0};
+    };
+
+    //An edit script. Ops are applied in order; `diff` emits `Resize` before the `Set`s/`Range`s that fill the new elements.
+    template <typename P> requires MapLike<P>
+    using Patch = vector<Op<P>>;
+
+    namespace detail {
+        [[nodiscard]] inline Path child(const Path& path, Step step) noexcept {
+            Path result{path.steps};
+            result.steps.push_back(move(step));
+            return result;
+        }
+
+        [[nodiscard]] inline Path key(const Path& path, const string& key) noexcept { return child(path, {Steps::Key, key, NBT::Utils::hashKey(key)}); }
+        [[nodiscard]] inline Path index(const Path& path, u64 index) noexcept { return child(path, {Steps::Index, {}, 0, index}); }
+
+        //Element-wise diff of a string or typed array. Changed elements are grouped into runs; if they cover more than half
+        //of the new value, replacing the whole value is smaller.
+        template <typename P, typename T, typename V> requires MapLike<P>
+        inline void sequence(const Path& path, const V& before, const V& after, const Tag<P>& whole, Patch<P>& result) noexcept {
+            const u64 shared = std::min(before.size(), after.size());
+            vector<std::pair<u64, u64>> runs;
+            for (u64 i = 0; i < shared; i++) {
+                if (NBT::Type::detail::samePayload(before[i], after[i])) continue;
+                if (!runs.empty() && i - runs.back().second <= RANGE_GAP) runs.back().second = i + 1;
+                else runs.push_back({i, i + 1});
+            }
+            if (after.size() > shared) {
+                if (!runs.empty() && shared - runs.back().second <= RANGE_GAP) runs.back().second = after.size();
+                else runs.push_back({shared, after.size()});
+            }
+            u64 changed = 0;
+            for (const auto& [begin, end] : runs) changed += end - begin;
+            if (changed * 2 > after.size()) {
+                result.push_back({Ops::Set, path, whole});
+                return;
+            }
+            if (before.size() != after.size()) result.push_back({Ops::Resize, path, {}, after.size()});
+            for (const auto& [begin, end] : runs) result.push_back({Ops::Range, path, T(V(after.begin() + begin, after.begin() + end)), begin});
+        }
+
+        template <typename P> requires MapLike<P>
+        inline void object(const Path& path, const typename P::template map<string, Tag<P>>& before, const typename P::template map<string, Tag<P>>& after, Patch<P>& result) noexcept;
+
+        template <typename P> requires MapLike<P>
+        inline void tag(const Path& path, const Tag<P>& before, const Tag<P>& after, Patch<P>& result) noexcept {
+            if (before.type != after.type) {
+                result.push_back({Ops::Set, path, after});
+                return;
+            }
+            switch (after.type) {
+                case Types::Object: object<P>(path, before.tagObject.payload, after.tagObject.payload, result); return;
+                case Types::Array: {
+                    const auto& old = before.tagArray.payload;
+                    const auto& now = after.tagArray.payload;
+                    if (old.size() != now.size()) result.push_back({Ops::Resize, path, {}, now.size()});
+                    for (u64 i = 0; i < now.size(); i++) {
+                        if (i < old.size()) tag<P>(index(path, i), old[i], now[i], result);
+                        else result.push_back({Ops::Set, index(path, i), now[i]});
+                    }
+                    return;
+                }
+                case Types::String:      sequence<P, TagString>(path, before.tagString.payload, after.tagString.payload, after, result);                return;
+                case Types::ArrayBool:   sequence<P, TagArrayBool>(path, before.tagArrayBool.payload, after.tagArrayBool.payload, after, result);       return;
+                case Types::ArrayHex:    sequence<P, TagArrayHex>(path, before.tagArrayHex.payload, after.tagArrayHex.payload, after, result);          return;
+                case Types::ArrayFloat:  sequence<P, TagArrayFloat>(path, before.tagArrayFloat.payload, after.tagArrayFloat.payload, after, result);    return;
+                case Types::ArrayDouble: sequence<P, TagArrayDouble>(path, before.tagArrayDouble.payload, after.tagArrayDouble.payload, after, result); return;
+                case Types::ArrayRaw:    sequence<P, TagArrayRaw>(path, before.tagArrayRaw.payload, after.tagArrayRaw.payload, after, result);          return;
+                default: if (!(before == after)) result.push_back({Ops::Set, path, after}); return;
+            }
+        }
+
+        template <typename P> requires MapLike<P>
+        inline void object(const Path& path, const typename P::template map<string, Tag<P>>& before, const typename P::template map<string, Tag<P>>& after, Patch<P>& result) noexcept {
+            for (const auto& [name, value] : before) if (after.find(name) == after.end()) result.push_back({Ops::Remove, key(path, name), {}});
+            for (const auto& [name, value] : after) {
+                const auto it = before.find(name);
+                if (it == before.end()) result.push_back({Ops::Set, key(path, name), value});
+                else tag<P>(key(path, name), it->second, value, result);
+            }
+        }
+    }
+
+    //Appends the ops turning `before` into `after` to `result`. Object members are compared by key, arrays element by element,
+    //strings and typed arrays as ranges of changed elements. Unchanged subtrees produce no ops.
+    template <typename P> requires MapLike<P>
+    inline void diff(const typename P::template map<string, Tag<P>>& before, const typename P::template map<string, Tag<P>>& after, Patch<P>& result) noexcept {
+        detail::object<P>({}, before, after, result);
+    }
+
+    namespace detail {
+        [[nodiscard]] inline bool patchError(const Path& path, const char* reason) noexcept {
+            pushError(format("Can't apply patch at \"{}\": {}", Query::toString(path), reason));
+            return false;
+        }
+
+        //Resolves every step but the last. `nullptr` if that fails, or if the path has one step and the parent is the document itself.
+        template <typename P> requires MapLike<P>
+        [[nodiscard]] inline Tag<P>* parent(const Path& path, typename P::template map<string, Tag<P>>& data) noexcept {
+            Tag<P>* current = nullptr;
+            for (u64 i = 0; i + 1 < path.steps.size(); i++) {
+                const auto& step = path.steps[i];
+                if (step.kind == Steps::Key) {
+                    auto* members = current == nullptr ? &data : current->type == Types::Object ? &current->tagObject.payload : nullptr;
+                    if (members == nullptr) return nullptr;
+                    const auto it = members->find(step.key);
+                    if (it == members->end()) return nullptr;
+                    current = &it->second;
+                }
+                else if (step.kind == Steps::Index) {
+                    if (current == nullptr || current->type != Types::Array || step.index >= current->tagArray.payload.size()) return nullptr;
+                    current = &current->tagArray.payload[step.index];
+                }
+                else return nullptr;
+            }
+            return current;
+        }
+
+        template <typename V>
+        inline void resize(V& payload, u64 count) noexcept { payload.resize(count); }
+
+        template <typename V>
+        [[nodiscard]] inline bool range(V& payload, const V& value, u64 offset) noexcept {
+            if (offset > payload.size() || value.size() > payload.size() - offset) return false;
+            std::copy(value.begin(), value.end(), payload.begin() + offset);
+            return true;
+        }
+    }
+
+    //Applies `ops` to `data` in place. Stops at the first op whose path doesn't resolve or whose target has the wrong type;
+    //the ops before it stay applied.
+    template <typename P> requires MapLike<P>
+    [[nodiscard]] inline bool patch(typename P::template map<string, Tag<P>>& data, const Patch<P>& ops) noexcept {
+        clearErrors();
+        for (const auto& op : ops) {
+            if (op.path.steps.empty()) return detail::patchError(op.path, "empty path");
+            Tag<P>* owner = detail::parent<P>(op.path, data);
+            if (owner == nullptr && op.path.steps.size() > 1) return detail::patchError(op.path, "path not found");
+            const auto& last = op.path.steps.back();
+            //Object members are reached through the owning map, array elements through the owning array.
+            auto* members = owner == nullptr ? &data : owner->type == Types::Object ? &owner->tagObject.payload : nullptr;
+            Tag<P>* target = nullptr;
+            if (last.kind == Steps::Key && members != nullptr) {
+                if (op.kind == Ops::Set) {
+                    (*members)[last.key] = op.value;
+                    continue;
+                }
+                if (op.kind == Ops::Remove) {
+                    if (members->erase(last.key) == 0) return detail::patchError(op.path, "no such member");
+                    continue;
+                }
+                const auto it = members->find(last.key);
+                if (it != members->end()) target = &it->second;
+            }
+            else if (last.kind == Steps::Index && owner != nullptr && owner->type == Types::Array && last.index < owner->tagArray.payload.size()) target = &owner->tagArray.payload[last.index];
+            if (target == nullptr) return detail::patchError(op.path, "path not found");
+            switch (op.kind) {
+                case Ops::Set: *target = op.value; break;
+                case Ops::Remove: return detail::patchError(op.path, "only object members can be removed");
+                case Ops::Resize: {
+                    switch (target->type) {
+                        case Types::Array:       detail::resize(target->tagArray.payload, op.count);       break;
+                        case Types::String:      detail::resize(target->tagString.payload, op.count);      break;
+                        case Types::ArrayBool:   detail::resize(target->tagArrayBool.payload, op.count);   break;
+                        case Types::ArrayHex:    detail::resize(target->tagArrayHex.payload, op.count);    break;
+                        case Types::ArrayFloat:  detail::resize(target->tagArrayFloat.payload, op.count);  break;
+                        case Types::ArrayDouble: detail::resize(target->tagArrayDouble.payload, op.count); break;
+                        case Types::ArrayRaw:    detail::resize(target->tagArrayRaw.payload, op.count);    break;
+                        default: return detail::patchError(op.path, "target can't be resized");
+                    }
+                    break;
+                }
+                case Ops::Range: {
+                    if (target->type != op.value.type) return detail::patchError(op.path, "range type mismatch");
+                    bool fits;
+                    switch (target->type) {
+                        case Types::String:      fits = detail::range(target->tagString.payload, op.value.tagString.payload, op.count);           break;
+                        case Types::ArrayBool:   fits = detail::range(target->tagArrayBool.payload, op.value.tagArrayBool.payload, op.count);     break;
+                        case Types::ArrayHex:    fits = detail::range(target->tagArrayHex.payload, op.value.tagArrayHex.payload, op.count);       break;
+                        case Types::ArrayFloat:  fits = detail::range(target->tagArrayFloat.payload, op.value.tagArrayFloat.payload, op.count);   break;
+                        case Types::ArrayDouble: fits = detail::range(target->tagArrayDouble.payload, op.value.tagArrayDouble.payload, op.count); break;
+                        case Types::ArrayRaw:    fits = detail::range(target->tagArrayRaw.payload, op.value.tagArrayRaw.payload, op.count);       break;
+                        default: return detail::patchError(op.path, "target has no ranges");
+                    }
+                    if (!fits) return detail::patchError(op.path, "range out of bounds");
+                    break;
+                }
+            }
+        }
+        return true;
+    }
+
+    //A patch is itself a CGNBT document: `ops` holds one object per op, with the op kind in `o` (a `Hex`), the path in `p`
+    //(in `Query` syntax), the value in `v` and the count or offset in `n` where the op has them. An empty patch has no `ops`.
+    template <typename P> requires MapLike<P>
+    [[nodiscard]] inline bool encodePatch(const Patch<P>& ops, vector<u8>& result) noexcept {
+        typename P::template map<string, Tag<P>> document;
+        if (!ops.empty()) {
+            vector<Tag<P>> encoded;
+            encoded.reserve(ops.size());
+            for (const auto& op : ops) {
+                typename P::template map<string, Tag<P>> entry;
+                entry.emplace("o", TagHex(static_cast<u8>(op.kind)));
+                entry.emplace("p", TagString(Query::toString(op.path)));
+                if (op.kind == Ops::Set || op.kind == Ops::Range) entry.emplace("v", op.value);
+                if (op.kind == Ops::Resize || op.kind == Ops::Range) entry.emplace("n", TagUVarInt(op.count));
+                encoded.push_back(TagObject<P>(move(entry)));
+            }
+            document.emplace("ops", TagArray<P>(move(encoded)));
+        }
+        return IO::writeData<P>(document, result, true);
+    }
+
+    template <typename P> requires MapLike<P>
+    [[nodiscard]] inline bool decodePatch(span<const u8> data, Patch<P>& result) noexcept {
+        typename P::template map<string, Tag<P>> document;
+        if (!IO::readData<P>(data, document)) return false;
+        result.clear();
+        const auto ops = document.find("ops");
+        if (ops == document.end()) return true;
+        if (ops->second.type != Types::Array) {
+            pushError("Invalid patch: `ops` isn't an array");
+            return false;
+        }
+        for (auto& entry : ops->second.tagArray.payload) {
+            if (entry.type != Types::Object) {
+                pushError("Invalid patch: op isn't an object");
+                return false;
+            }
+            auto& members = entry.tagObject.payload;
+            const auto kind = members.find("o");
+            const auto path = members.find("p");
+            if (kind == members.end() || kind->second.type != Types::Hex || kind->second.tagHex.payload > static_cast<u8>(Ops::Range) || path == members.end() || path->second.type != Types::String) {
+                pushError("Invalid patch: op without a valid kind or path");
+                return false;
+            }
+            Op<P> op{static_cast<Ops>(kind->second.tagHex.payload), {}, {}};
+            if (!Query::compile(path->second.tagString.payload, op.path)) return false;
+            const auto value = members.find("v");
+            const auto count = members.find("n");
+            if ((op.kind == Ops::Set || op.kind == Ops::Range) && value == members.end()) {
+                pushError(format("Invalid patch: op on `{}` without a value", path->second.tagString.payload));
+                return false;
+            }
+            if ((op.kind == Ops::Resize || op.kind == Ops::Range) && (count == members.end() || count->second.type != Types::UVarInt)) {
+                pushError(format("Invalid patch: op on `{}` without a count", path->second.tagString.payload));
+                return false;
+            }
+            if (value != members.end()) op.value = move(value->second);
+            if (count != members.end() && count->second.type == Types::UVarInt) op.count = count->second.tagUVarInt.payload;
+            result.push_back(move(op));
+        }
+        return true;
+    }
+}
\ No newline at end of file
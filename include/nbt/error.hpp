@@ -1,19 +1,82 @@
 #pragma once
+#include <cstdint>
+#include <format>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 namespace NBT::Error {
-    using std::vector, std::string;
+    typedef uint8_t u8;
+    typedef uint64_t u64;
+    using std::vector, std::string, std::string_view, std::format, std::to_string, std::move;
 
-    inline thread_local vector<string> errors;
+    enum struct Code : u8 {
+        //Free text, see `Record::text`.
+        Message,
+        //The input ended inside a value or an object.
+        EndOfInput,
+        InvalidType,
+        InvalidSecondType,
+        //More than `ReadLimits::depth` levels.
+        TooDeep,
+        //A string or array announced more items than the input has left.
+        CountTooLarge,
+        ArrayTooLong,
+        TooManyTags,
+        InputTooLong,
+    };
+
+    inline constexpr u8 NO_TYPE = 0xFF;
+
+    //One error, kept as data and only turned into text when asked for, so failing on a corrupt input costs no formatting.
+    struct Record {
+        Code code{Code::Message};
+        //Type ID the error is about, `NO_TYPE` if none.
+        u8 type{NO_TYPE};
+        //Decoded bytes read before the error.
+        u64 offset{0};
+        //What the input asked for and what was allowed; what they count depends on `code`.
+        u64 count{0}, limit{0};
+        //Where in the document, e.g. `entities[3].name`; filled in by the reader as it unwinds.
+        string path;
+        string text;
+
+        [[nodiscard]] string message() const noexcept {
+            string result;
+            switch (code) {
+                case Code::Message:           result = text; break;
+                case Code::EndOfInput:        result = format("Failed to read data, EOF reached at pos {}!", offset); break;
+                case Code::InvalidType:       result = format("Invalid type ID {} at pos {}!", type, offset); break;
+                case Code::InvalidSecondType: result = format("Invalid second type {} at pos {}!", type, offset); break;
+                case Code::TooDeep:           result = format("Nesting deeper than {} levels at pos {}!", limit, offset); break;
+                case Code::CountTooLarge:     result = format("{} items announced at pos {}, but at most {} fit in the input left!", count, offset, limit); break;
+                case Code::ArrayTooLong:      result = format("Array of {} elements at pos {} is longer than the limit of {}!", count, offset, limit); break;
+                case Code::TooManyTags:       result = format("More than {} tags at pos {}!", limit, offset); break;
+                case Code::InputTooLong:      result = format("Input is longer than the limit of {} bytes!", limit); break;
+            }
+            if (!path.empty()) result += format(" (at {})", path);
+            return result;
+        }
+    };
+
+    inline thread_local vector<Record> errors;
 
     //Error vector copied on-purpose.
-    [[nodiscard]] inline vector<string> getErrors() noexcept { return vector(errors); }
+    [[nodiscard]] inline vector<string> getErrors() noexcept {
+        vector<string> result;
+        result.reserve(errors.size());
+        for (const auto& error : errors) result.push_back(error.message());
+        return result;
+    }
+
+    //Without formatting them. Valid until the next call into the library on this thread.
+    [[nodiscard]] inline const vector<Record>& getRecords() noexcept { return errors; }
 
     [[nodiscard]] inline string getLastError() noexcept {
         if (errors.empty()) return "";
         else {
-            const string result = errors.back();
+            const string result = errors.back().message();
             errors.pop_back();
             return result;
         }
@@ -21,5 +84,20 @@ namespace NBT::Error {
 
     inline void clearErrors() noexcept { errors.clear(); }
 
-    inline void pushError(const string& error) noexcept { errors.push_back(error); }
+    inline void pushError(const string& error) noexcept { errors.push_back({.text = error}); }
+
+    inline void pushError(Record&& error) noexcept { errors.push_back(move(error)); }
+
+    //Prepends a step to the path of the last error, for readers unwinding past the member or element that failed.
+    inline void enclose(string_view key) noexcept {
+        if (errors.empty()) return;
+        string& path = errors.back().path;
+        path.insert(0, path.empty() || path.front() == '[' ? string(key) : string(key) + ".");
+    }
+
+    inline void enclose(u64 index) noexcept {
+        if (errors.empty()) return;
+        string& path = errors.back().path;
+        path.insert(0, "[" + to_string(index) + (path.empty() || path.front() == '[' ? "]" : "]."));
+    }
 }
\ No newline at end of file
@@ -0,0 +1,257 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <format>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "error.hpp"
+#include "mapLike.hpp"
+#include "read.hpp"
+#include "types.hpp"
+#include "utils.hpp"
+
+//Frozen layout: a read-only, position-independent image of a document meant to be memory-mapped and queried in place.
+//All integers are host-endian, every block starts on an 8-byte boundary.
+//  Header:  "cGnbF", version, 2 bytes padding | u64 total size | root slot
+//  Slot:    u8 type, 7 bytes padding | u64 value. Scalars are stored in the value, everything else is the offset of its block.
+//  Object:  u64 count | count * (u64 key hash, u64 key block offset, slot), sorted by hash, then key
+//  Array:   u64 count | count * slot
+//  String:  u64 length | bytes
+//  Typed:   u64 count | elements, exactly as in memory
+namespace NBT::Frozen {
+    typedef uint8_t u8;
+    typedef uint32_t u32;
+    typedef int64_t i64;
+    typedef uint64_t u64;
+    using namespace NBT::Type;
+    using std::array, std::span, std::string, std::string_view, std::vector, std::bit_cast, std::memcpy, NBT::Error::clearErrors, NBT::Error::pushError, NBT::MapLike::MapLike, NBT::Utils::hashKey;
+
+    inline constexpr array<u8, 5> MAGIC = {'c', 'G', 'n', 'b', 'F'};
+    inline constexpr u8 VERSION = 1;
+    inline constexpr u64 HEADER_SIZE = 32, SLOT_SIZE = 16, ENTRY_SIZE = 32;
+
+    namespace detail {
+        inline void align(vector<u8>& result) noexcept { result.resize((result.size() + 7) & ~static_cast<u64>(7)); }
+
+        template <typename T>
+        inline void put(vector<u8>& result, u64 offset, T value) noexcept { memcpy(result.data() + offset, &value, sizeof(T)); }
+
+        //Appends a block made of a `u64` count and `size` bytes of data (zeroes if `data` is `nullptr`), and returns its offset.
+        inline u64 block(vector<u8>& result, u64 count, const void* data, u64 size) noexcept {
+            align(result);
+            const u64 offset = result.size();
+            result.resize(offset + sizeof(u64) + size);
+            put(result, offset, count);
+            if (data != nullptr && size > 0) memcpy(result.data() + offset + sizeof(u64), data, size);
+            return offset;
+        }
+
+        template <typename P> requires MapLike<P>
+        [[nodiscard]] inline bool object(const typename P::template map<string, Tag<P>>& members, vector<u8>& result, u64& offset) noexcept;
+
+        //Fills the slot at `slot`. `result` may grow, so positions are kept as offsets.
+        template <typename P> requires MapLike<P>
+        [[nodiscard]] inline bool slot(const Tag<P>& tag, vector<u8>& result, u64 slot) noexcept {
+            u64 value = 0;
+            switch (tag.type) {
+                case Types::Object:      if (!object<P>(tag.tagObject.payload, result, value)) return false; break;
+                case Types::IVarInt:     value = static_cast<u64>(tag.tagIVarInt.payload); break;
+                case Types::UVarInt:     value = tag.tagUVarInt.payload; break;
+                case Types::Bool:        value = tag.tagBool.payload; break;
+                case Types::Hex:         value = tag.tagHex.payload; break;
+                case Types::Float:       value = bit_cast<u32>(tag.tagFloat.payload); break;
+                case Types::Double:      value = bit_cast<u64>(tag.tagDouble.payload); break;
+                case Types::Raw:         value = tag.tagRaw.payload; break;
+                case Types::String:      value = block(result, tag.tagString.payload.size(), tag.tagString.payload.data(), tag.tagString.payload.size()); break;
+                case Types::ArrayBool:   value = block(result, tag.tagArrayBool.payload.size(), tag.tagArrayBool.payload.data(), tag.tagArrayBool.payload.size()); break;
+                case Types::ArrayHex:    value = block(result, tag.tagArrayHex.payload.size(), tag.tagArrayHex.payload.data(), tag.tagArrayHex.payload.size()); break;
+                case Types::ArrayFloat:  value = block(result, tag.tagArrayFloat.payload.size(), tag.tagArrayFloat.payload.data(), sizeof(float) * tag.tagArrayFloat.payload.size()); break;
+                case Types::ArrayDouble: value = block(result, tag.tagArrayDouble.payload.size(), tag.tagArrayDouble.payload.data(), sizeof(double) * tag.tagArrayDouble.payload.size()); break;
+                case Types::ArrayRaw:    value = block(result, tag.tagArrayRaw.payload.size(), tag.tagArrayRaw.payload.data(), tag.tagArrayRaw.payload.size()); break;
+                case Types::Array: {
+                    const auto& elements = tag.tagArray.payload;
+                    value = block(result, elements.size(), nullptr, SLOT_SIZE * elements.size());
+                    for (u64 i = 0; i < elements.size(); i++) if (!detail::slot<P>(elements[i], result, value + sizeof(u64) + SLOT_SIZE * i)) return false;
+                    break;
+                }
+                default: {
+                    pushError(std::format("Invalid type ID {} while freezing!", static_cast<u8>(tag.type)));
+                    return false;
+                }
+            }
+            result[slot] = static_cast<u8>(tag.type);
+            put(result, slot + sizeof(u64), value);
+            return true;
+        }
+
+        template <typename P> requires MapLike<P>
+        [[nodiscard]] inline bool object(const typename P::template map<string, Tag<P>>& members, vector<u8>& result, u64& offset) noexcept {
+            struct Sorted {
+                u64 hash;
+                const string* key;
+                const Tag<P>* value;
+            };
+            vector<Sorted> sorted;
+            sorted.reserve(members.size());
+            for (const auto& [key, value] : members) sorted.push_back({hashKey(key), &key, &value});
+            std::sort(sorted.begin(), sorted.end(), [](const Sorted& a, const Sorted& b) { return a.hash != b.hash ? a.hash < b.hash : *a.key < *b.key; });
+            offset = block(result, sorted.size(), nullptr, ENTRY_SIZE * sorted.size());
+            for (u64 i = 0; i < sorted.size(); i++) {
+                const u64 entry = offset + sizeof(u64) + ENTRY_SIZE * i;
+                const u64 key = block(result, sorted[i].key->size(), sorted[i].key->data(), sorted[i].key->size());
+                put(result, entry, sorted[i].hash);
+                put(result, entry + sizeof(u64), key);
+                if (!slot<P>(*sorted[i].value, result, entry + 2 * sizeof(u64))) return false;
+            }
+            return true;
+        }
+    }
+
+    //Builds the frozen image of a document. The output can be written to a file as is and opened with `View`, e.g. over a `MappedFile`.
+    template <typename P> requires MapLike<P>
+    [[nodiscard]] inline bool freeze(const typename P::template map<string, Tag<P>>& data, vector<u8>& result) noexcept {
+        clearErrors();
+        result.assign(HEADER_SIZE, 0);
+        std::copy(MAGIC.begin(), MAGIC.end(), result.begin());
+        result[MAGIC.size()] = VERSION;
+        u64 root = 0;
+        if (!detail::object<P>(data, result, root)) return false;
+        detail::align(result);
+        result[16] = static_cast<u8>(Types::Object);
+        detail::put(result, 24, root);
+        detail::put(result, 8, static_cast<u64>(result.size()));
+        return true;
+    }
+
+    //Freezes a CGNBT file (plain or zstd) held in memory.
+    template <typename P> requires MapLike<P>
+    [[nodiscard]] inline bool freezeData(span<const u8> data, vector<u8>& result) noexcept {
+        typename P::template map<string, Tag<P>> document;
+        if (!IO::readData<P>(data, document)) return false;
+        return freeze<P>(document, result);
+    }
+
+    //A value inside a frozen image. Every access is bounds-checked against the image, so a corrupt image yields empty values instead of crashes.
+    //Copying is free and nothing allocates. Missing members, out-of-range indices and type mismatches give an invalid value, or zero/empty.
+    struct Value {
+        [[nodiscard]] Value() noexcept = default;
+        [[nodiscard]] Value(span<const u8> image, u64 slot) noexcept : image_(image), slot_(slot) {}
+
+        [[nodiscard]] explicit operator bool() const noexcept { return !image_.empty(); }
+
+        [[nodiscard]] Types type() const noexcept { return image_.empty() ? Types::ObjectEnd : static_cast<Types>(image_[slot_]); }
+
+        //Members of an object or elements of an array, 0 for everything else.
+        [[nodiscard]] u64 size() const noexcept {
+            if (type() != Types::Object && type() != Types::Array) return 0;
+            return count(type() == Types::Object ? ENTRY_SIZE : SLOT_SIZE);
+        }
+
+        //Binary search over the key hashes.
+        [[nodiscard]] Value operator[](string_view key) const noexcept {
+            if (type() != Types::Object) return {};
+            const u64 hash = hashKey(key), entries = value() + sizeof(u64);
+            u64 low = 0, high = count(ENTRY_SIZE);
+            while (low < high) {
+                const u64 middle = low + (high - low) / 2;
+                if (read<u64>(entries + ENTRY_SIZE * middle) < hash) low = middle + 1;
+                else high = middle;
+            }
+            for (; low < count(ENTRY_SIZE) && read<u64>(entries + ENTRY_SIZE * low) == hash; low++) {
+                if (keyAt(low) == key) return {image_, entries + ENTRY_SIZE * low + 2 * sizeof(u64)};
+            }
+            return {};
+        }
+
+        [[nodiscard]] Value operator[](u64 index) const noexcept {
+            if (type() != Types::Array || index >= count(SLOT_SIZE)) return {};
+            return {image_, value() + sizeof(u64) + SLOT_SIZE * index};
+        }
+
+        //Members of an object by position, in hash order.
+        [[nodiscard]] string_view keyAt(u64 index) const noexcept {
+            if (type() != Types::Object || index >= count(ENTRY_SIZE)) return {};
+            return text(read<u64>(value() + sizeof(u64) + ENTRY_SIZE * index + sizeof(u64)));
+        }
+        [[nodiscard]] Value valueAt(u64 index) const noexcept {
+            if (type() != Types::Object || index >= count(ENTRY_SIZE)) return {};
+            return {image_, value() + sizeof(u64) + ENTRY_SIZE * index + 2 * sizeof(u64)};
+        }
+
+        [[nodiscard]] i64 asIVarInt() const noexcept { return type() == Types::IVarInt ? static_cast<i64>(value()) : 0; }
+        [[nodiscard]] u64 asUVarInt() const noexcept { return type() == Types::UVarInt ? value() : 0; }
+        [[nodiscard]] bool asBool() const noexcept { return type() == Types::Bool && value() != 0; }
+        [[nodiscard]] u8 asHex() const noexcept { return type() == Types::Hex ? static_cast<u8>(value()) : 0; }
+        [[nodiscard]] float asFloat() const noexcept { return type() == Types::Float ? bit_cast<float>(static_cast<u32>(value())) : 0.0f; }
+        [[nodiscard]] double asDouble() const noexcept { return type() == Types::Double ? bit_cast<double>(value()) : 0.0; }
+        [[nodiscard]] u8 asRaw() const noexcept { return type() == Types::Raw ? static_cast<u8>(value()) : 0; }
+        [[nodiscard]] string_view asString() const noexcept { return type() == Types::String ? text(value()) : string_view(); }
+        [[nodiscard]] span<const u8> asArrayBool() const noexcept { return type() == Types::ArrayBool ? bytes<u8>(value()) : span<const u8>(); }
+        [[nodiscard]] span<const u8> asArrayHex() const noexcept { return type() == Types::ArrayHex ? bytes<u8>(value()) : span<const u8>(); }
+        [[nodiscard]] span<const float> asArrayFloat() const noexcept { return type() == Types::ArrayFloat ? bytes<float>(value()) : span<const float>(); }
+        [[nodiscard]] span<const double> asArrayDouble() const noexcept { return type() == Types::ArrayDouble ? bytes<double>(value()) : span<const double>(); }
+        [[nodiscard]] span<const u8> asArrayRaw() const noexcept { return type() == Types::ArrayRaw ? bytes<u8>(value()) : span<const u8>(); }
+
+    private:
+        span<const u8> image_;
+        u64 slot_{0};
+
+        template <typename T>
+        [[nodiscard]] T read(u64 offset) const noexcept {
+            T result{};
+            if (offset <= image_.size() && image_.size() - offset >= sizeof(T)) memcpy(&result, image_.data() + offset, sizeof(T));
+            return result;
+        }
+
+        [[nodiscard]] u64 value() const noexcept { return read<u64>(slot_ + sizeof(u64)); }
+
+        //Number of `stride`-sized items in the block the slot points to, clamped to what the image actually holds.
+        [[nodiscard]] u64 count(u64 stride) const noexcept {
+            const u64 offset = value();
+            if (offset > image_.size() || image_.size() - offset < sizeof(u64)) return 0;
+            return std::min(read<u64>(offset), (image_.size() - offset - sizeof(u64)) / stride);
+        }
+
+        //Blocks are 8-byte aligned and the image is expected to be too (mappings are page-aligned), so typed arrays are viewed in place.
+        template <typename T>
+        [[nodiscard]] span<const T> bytes(u64 offset) const noexcept {
+            if (offset % 8 != 0 || offset > image_.size() || image_.size() - offset < sizeof(u64)) return {};
+            const u64 length = read<u64>(offset);
+            if (length > (image_.size() - offset - sizeof(u64)) / sizeof(T)) return {};
+            return {reinterpret_cast<const T*>(image_.data() + offset + sizeof(u64)), length};
+        }
+        [[nodiscard]] string_view text(u64 offset) const noexcept {
+            const auto text = bytes<u8>(offset);
+            return {reinterpret_cast<const char*>(text.data()), text.size()};
+        }
+    };
+
+    //Opens a frozen image. `image` is not copied and has to outlive every `Value` taken from it.
+    struct View {
+        [[nodiscard]] explicit View(span<const u8> image) noexcept {
+            if (image.size() < HEADER_SIZE || !std::equal(MAGIC.begin(), MAGIC.end(), image.begin())) {
+                pushError("Not a frozen CGNBT image!");
+                return;
+            }
+            u64 size = 0;
+            memcpy(&size, image.data() + 8, sizeof(u64));
+            if (image[MAGIC.size()] != VERSION || size > image.size() || size < HEADER_SIZE) {
+                pushError("Unsupported or truncated frozen CGNBT image!");
+                return;
+            }
+            image_ = image.first(size);
+        }
+
+        [[nodiscard]] explicit operator bool() const noexcept { return !image_.empty(); }
+
+        //The top-level object, invalid if the image was rejected.
+        [[nodiscard]] Value root() const noexcept { return image_.empty() ? Value() : Value(image_, 16); }
+    private:
+        span<const u8> image_;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,251 @@
+#pragma once
+#include <ostream>
+#include <span>
+#include <string>
+#include <vector>
+#include <zstd.h>
+
+#include "adapters.hpp"
+#include "auxiliary.hpp"
+#include "error.hpp"
+#include "FileReader.hpp"
+#include "mapLike.hpp"
+#include "types.hpp"
+#include "write.hpp"
+
+namespace NBT::IO {
+    typedef uint8_t u8;
+    typedef uint64_t u64;
+    using namespace NBT::Type;
+    using std::span, std::string, std::vector, std::ostream, std::format, NBT::Aux::writeVarText, NBT::Aux::writeUVarInt, NBT::Error::clearErrors, NBT::Error::pushError, NBT::MapLike::MapLike;
+
+    //Payloads shorter than this are copied next to their headers, a separate segment would cost more than the copy.
+    inline constexpr u64 GATHER_THRESHOLD = 512;
+
+    //Encoded output kept as small owned header runs plus borrowed references to the tags' own buffers.
+    //The source tree must stay alive and unmodified until the segments have been written out.
+    struct SegmentList {
+        vector<u8> bytes;
+
+        void reference(const u8* data, u64 size) noexcept {
+            if (size < GATHER_THRESHOLD) {
+                bytes.insert(bytes.end(), data, data + size);
+                return;
+            }
+            cut();
+            pieces_.push_back({data, 0, size});
+        }
+
+        //Only valid until the next append: `bytes` may reallocate.
+        [[nodiscard]] vector<Segment> segments() noexcept {
+            cut();
+            vector<Segment> result;
+            result.reserve(pieces_.size());
+            for (const auto& piece : pieces_) result.push_back({piece.external != nullptr ? piece.external : bytes.data() + piece.offset, piece.size});
+            return result;
+        }
+
+        [[nodiscard]] u64 size() const noexcept {
+            u64 result = bytes.size() - cut_;
+            for (const auto& piece : pieces_) result += piece.size;
+            return result;
+        }
+
+        void clear() noexcept {
+            bytes.clear();
+            pieces_.clear();
+            cut_ = 0;
+        }
+
+    private:
+        //`external == nullptr` means the piece lives in `bytes` at `offset`.
+        struct Piece {
+            const u8* external;
+            u64 offset, size;
+        };
+        vector<Piece> pieces_;
+        u64 cut_{0};
+
+        void cut() noexcept {
+            if (bytes.size() == cut_) return;
+            pieces_.push_back({nullptr, cut_, bytes.size() - cut_});
+            cut_ = bytes.size();
+        }
+    };
+
+    template <typename P> requires MapLike<P>
+    [[nodiscard]] inline bool gatherObject(const typename P::template map<string, Tag<P>>&, SegmentList&) noexcept;
+    template <typename P> requires MapLike<P>
+    [[nodiscard]] inline bool gatherArray (const TagArray<P>&                               , SegmentList&) noexcept;
+
+    template <typename C>
+    inline void gatherPayload(const C& payload, SegmentList& result) noexcept {
+        writeUVarInt(payload.size(), result.bytes);
+        if (!payload.empty()) result.reference(reinterpret_cast<const u8*>(payload.data()), sizeof(typename C::value_type) * payload.size());
+    }
+
+    template <typename P> requires MapLike<P>
+    [[nodiscard]] inline bool writeSegments(const typename P::template map<string, Tag<P>>& data, SegmentList& result, bool addMagic = false) noexcept {
+        clearErrors();
+        if (addMagic) result.bytes.insert(result.bytes.end(), MAGIC.begin(), MAGIC.end());
+        return gatherObject<P>(data, result);
+    }
+
+    template<Writable W>
+    [[nodiscard]] inline bool emitSegments(W& dest, span<const Segment> segments) noexcept {
+        if constexpr (GatherWritable<W>) return dest.writeSegments(segments);
+        else {
+            for (const auto& segment : segments) if (!dest.writeBlock(segment.data, segment.size)) return false;
+            return true;
+        }
+    }
+
+    //Streams the segments through one zstd frame, so the uncompressed document is never made contiguous.
+    template<Writable W>
+    [[nodiscard]] inline bool compressSegments(W& dest, span<const Segment> segments, u64 totalSize, u8 compressionLevel) noexcept {
+        ZSTD_CCtx* const context = ZSTD_createCCtx();
+        if (context == nullptr) {
+            pushError("Failed to create a ZSTD compression context!");
+            return false;
+        }
+        ZSTD_CCtx_setParameter(context, ZSTD_c_compressionLevel, compressionLevel > 22 ? 22 : compressionLevel == 0 ? 1 : compressionLevel);
+        ZSTD_CCtx_setPledgedSrcSize(context, totalSize);
+        vector<u8> buffer(ZSTD_CStreamOutSize());
+        const auto pump = [&](ZSTD_inBuffer& in, ZSTD_EndDirective directive) -> bool {
+            while (true) {
+                ZSTD_outBuffer out{buffer.data(), buffer.size(), 0};
+                const auto remaining = ZSTD_compressStream2(context, &out, &in, directive);
+                if (ZSTD_isError(remaining)) {
+                    pushError(format("ZSTD compression error: {}", ZSTD_getErrorName(remaining)));
+                    return false;
+                }
+                if (out.pos > 0 && !dest.writeBlock(buffer.data(), out.pos)) {
+                    pushError("Failed to write compressed data to stream!");
+                    return false;
+                }
+                if (directive == ZSTD_e_end ? remaining == 0 : in.pos == in.size) return true;
+            }
+        };
+        bool success = true;
+        for (const auto& segment : segments) {
+            ZSTD_inBuffer in{segment.data, segment.size, 0};
+            if (!(success = pump(in, ZSTD_e_continue))) break;
+        }
+        if (success) {
+            ZSTD_inBuffer in{nullptr, 0, 0};
+            success = pump(in, ZSTD_e_end);
+        }
+        ZSTD_freeCCtx(context);
+        return success;
+    }
+
+    //Same output as `writeStream`, but large `String` and typed array payloads go to the sink straight from the tags instead of being copied into one buffer first.
+    template<typename P, Writable W> requires MapLike<P>
+    [[nodiscard]] inline bool writeStreamVectored(W& dest, const typename P::template map<string, Tag<P>>& data, bool zstd = false, u8 compressionLevel = 3) noexcept {
+        SegmentList list;
+        if (!writeSegments<P>(data, list, !zstd)) return false;
+        const auto segments = list.segments();
+        if (zstd) return compressSegments(dest, segments, list.size(), compressionLevel);
+        if (!emitSegments(dest, segments)) {
+            pushError("Failed to write data to stream!");
+            return false;
+        }
+        return true;
+    }
+
+    template <typename P> requires MapLike<P>
+    [[nodiscard]] inline bool writeStreamVectored(ostream& s, const typename P::template map<string, Tag<P>>& data, bool zstd = false, u8 compressionLevel = 3) noexcept {
+        StdOut adapter(s);
+        return writeStreamVectored<P>(adapter, data, zstd, compressionLevel);
+    }
+
+    template <typename P> requires MapLike<P>
+    [[nodiscard]] inline bool gatherObject(const typename P::template map<string, Tag<P>>& data, SegmentList& result) noexcept {
+        for (const auto& [key, value] : data) switch (value.type) {
+            case Types::Object: {
+                result.bytes.push_back(getHead(Types::Object));
+                writeVarText(key, result.bytes);
+                if (!gatherObject<P>(value.tagObject.payload, result)) return false;
+                result.bytes.push_back(static_cast<u8>(Types::ObjectEnd));
+                break;
+            }
+            case Types::Array: {
+                result.bytes.push_back(getHead(Types::Array) | static_cast<u8>(getOriginalType(value.tagArray.payload[0].type)));
+                writeVarText(key, result.bytes);
+                if (!gatherArray(value.tagArray, result)) return false;
+                break;
+            }
+            case Types::String:
+            case Types::ArrayBool:
+            case Types::ArrayHex:
+            case Types::ArrayFloat:
+            case Types::ArrayDouble:
+            case Types::ArrayRaw: {
+                result.bytes.push_back(getHead(value.type));
+                writeVarText(key, result.bytes);
+                switch (value.type) {
+                    case Types::String:      gatherPayload(value.tagString.payload, result);      break;
+                    case Types::ArrayBool:   gatherPayload(value.tagArrayBool.payload, result);   break;
+                    case Types::ArrayHex:    gatherPayload(value.tagArrayHex.payload, result);    break;
+                    case Types::ArrayFloat:  gatherPayload(value.tagArrayFloat.payload, result);  break;
+                    case Types::ArrayDouble: gatherPayload(value.tagArrayDouble.payload, result); break;
+                    default:                 gatherPayload(value.tagArrayRaw.payload, result);    break;
+                }
+                break;
+            }
+            default: {
+                if (!writeMember(key, value, result.bytes)) return false;
+                break;
+            }
+        }
+        return true;
+    }
+
+    template <typename P> requires MapLike<P>
+    [[nodiscard]] inline bool gatherArray(const TagArray<P>& data, SegmentList& result) noexcept {
+        if (data.payload.empty()) return writeArray(data, result.bytes);
+        switch (data.payload[0].type) {
+            case Types::Object: {
+                writeUVarInt(data.payload.size(), result.bytes);
+                for (const auto& element : data.payload) {
+                    if (!gatherObject<P>(element.tagObject.payload, result)) return false;
+                    result.bytes.push_back(static_cast<u8>(Types::ObjectEnd));
+                }
+                return true;
+            }
+            case Types::Array: {
+                writeUVarInt(data.payload.size(), result.bytes);
+                for (const auto& element : data.payload) {
+                    result.bytes.push_back(getHead(Types::Array) | static_cast<u8>(element.tagArray.payload[0].type));
+                    if (!gatherArray(element.tagArray, result)) return false;
+                }
+                return true;
+            }
+            case Types::String: {
+                writeUVarInt(data.payload.size(), result.bytes);
+                for (const auto& element : data.payload) gatherPayload(element.tagString.payload, result);
+                return true;
+            }
+            case Types::ArrayBool:
+            case Types::ArrayHex:
+            case Types::ArrayFloat:
+            case Types::ArrayDouble:
+            case Types::ArrayRaw: {
+                writeUVarInt(data.payload.size(), result.bytes);
+                for (const auto& element : data.payload) {
+                    result.bytes.push_back(getHead(element.type));
+                    switch (element.type) {
+                        case Types::ArrayBool:   gatherPayload(element.tagArrayBool.payload, result);   break;
+                        case Types::ArrayHex:    gatherPayload(element.tagArrayHex.payload, result);    break;
+                        case Types::ArrayFloat:  gatherPayload(element.tagArrayFloat.payload, result);  break;
+                        case Types::ArrayDouble: gatherPayload(element.tagArrayDouble.payload, result); break;
+                        default:                 gatherPayload(element.tagArrayRaw.payload, result);    break;
+                    }
+                }
+                return true;
+            }
+            //Varint arrays have nothing worth referencing.
+            default: return writeArray(data, result.bytes);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,95 @@
+#pragma once
+#include <bit>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "mapLike.hpp"
+#include "types.hpp"
+#include "utils.hpp"
+
+namespace NBT::Hash {
+    typedef uint8_t u8;
+    typedef uint32_t u32;
+    typedef uint64_t u64;
+    using namespace NBT::Type;
+    using std::string, std::vector, std::bit_cast, NBT::MapLike::MapLike, NBT::Utils::hashKey;
+
+    //The splitmix64 finalizer.
+    [[nodiscard]] inline constexpr u64 mix(u64 x) noexcept {
+        x ^= x >> 30;
+        x *= 0xBF58476D1CE4E5B9;
+        x ^= x >> 27;
+        x *= 0x94D049BB133111EB;
+        return x ^ x >> 31;
+    }
+
+    //Folds in the type so that e.g. `IVarInt 1` and `UVarInt 1` differ. Never 0, so callers can use 0 for "not computed yet".
+    [[nodiscard]] inline constexpr u64 finish(Types type, u64 state) noexcept {
+        const u64 result = mix(state ^ static_cast<u64>(type) << 56);
+        return result == 0 ? 1 : result;
+    }
+
+    //Hashes 8 bytes per step; the tail is zero-padded and the size folded in so that padding can't collide.
+    [[nodiscard]] inline u64 bytes(const void* data, u64 size) noexcept {
+        const u8* cursor = static_cast<const u8*>(data);
+        u64 result = size * 0x9E3779B97F4A7C15;
+        u64 i = 0;
+        for (; i + 8 <= size; i += 8) {
+            u64 word;
+            std::memcpy(&word, cursor + i, 8);
+            result = (result ^ word) * 0x9E3779B97F4A7C15;
+            result ^= result >> 32;
+        }
+        if (i < size) {
+            u64 word = 0;
+            std::memcpy(&word, cursor + i, size - i);
+            result = (result ^ word) * 0x9E3779B97F4A7C15;
+        }
+        return mix(result);
+    }
+
+    //Objects are unordered, so member digests are combined with a commutative sum.
+    [[nodiscard]] inline constexpr u64 member(u64 keyHash, u64 valueDigest) noexcept { return mix(keyHash + valueDigest * 0x9E3779B97F4A7C15); }
+    //Arrays are ordered, so element digests are chained.
+    [[nodiscard]] inline constexpr u64 element(u64 state, u64 elementDigest) noexcept { return mix(state ^ elementDigest) * 0x9E3779B97F4A7C15; }
+
+    template <typename P> requires MapLike<P>
+    [[nodiscard]] inline u64 digest(const Tag<P>& tag) noexcept;
+
+    //Same as the digest of a `TagObject` holding `data`.
+    template <typename P> requires MapLike<P>
+    [[nodiscard]] inline u64 digest(const typename P::template map<string, Tag<P>>& data) noexcept {
+        u64 sum = data.size();
+        for (const auto& [key, value] : data) sum += member(hashKey(key), digest(value));
+        return finish(Types::Object, sum);
+    }
+
+    //A structural 64-bit digest: equal tags (see `Tag::operator==`) always have equal digests, and `Shared::Node::digest` gives
+    //the same value for the same tree. Not cryptographic.
+    template <typename P> requires MapLike<P>
+    [[nodiscard]] inline u64 digest(const Tag<P>& tag) noexcept {
+        switch (tag.type) {
+            case Types::Object: return digest<P>(tag.tagObject.payload);
+            case Types::Array: {
+                u64 state = tag.tagArray.payload.size();
+                for (const auto& element : tag.tagArray.payload) state = Hash::element(state, digest(element));
+                return finish(Types::Array, state);
+            }
+            case Types::IVarInt:     return finish(Types::IVarInt, static_cast<u64>(tag.tagIVarInt.payload));
+            case Types::UVarInt:     return finish(Types::UVarInt, tag.tagUVarInt.payload);
+            case Types::Bool:        return finish(Types::Bool, tag.tagBool.payload);
+            case Types::Hex:         return finish(Types::Hex, tag.tagHex.payload);
+            case Types::Float:       return finish(Types::Float, bit_cast<u32>(tag.tagFloat.payload));
+            case Types::Double:      return finish(Types::Double, bit_cast<u64>(tag.tagDouble.payload));
+            case Types::String:      return finish(Types::String, bytes(tag.tagString.payload.data(), tag.tagString.payload.size()));
+            case Types::Raw:         return finish(Types::Raw, tag.tagRaw.payload);
+            case Types::ArrayBool:   return finish(Types::ArrayBool, bytes(tag.tagArrayBool.payload.data(), tag.tagArrayBool.payload.size()));
+            case Types::ArrayHex:    return finish(Types::ArrayHex, bytes(tag.tagArrayHex.payload.data(), tag.tagArrayHex.payload.size()));
+            case Types::ArrayFloat:  return finish(Types::ArrayFloat, bytes(tag.tagArrayFloat.payload.data(), tag.tagArrayFloat.payload.size() * sizeof(float)));
+            case Types::ArrayDouble: return finish(Types::ArrayDouble, bytes(tag.tagArrayDouble.payload.data(), tag.tagArrayDouble.payload.size() * sizeof(double)));
+            case Types::ArrayRaw:    return finish(Types::ArrayRaw, bytes(tag.tagArrayRaw.payload.data(), tag.tagArrayRaw.payload.size()));
+            default:                 return finish(Types::Count, 0);
+        }
+    }
+}
\ No newline at end of file
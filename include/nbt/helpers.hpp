@@ -1,11 +1,22 @@
 #pragma once
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <span>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 
 #include "mapLike.hpp"
 #include "types.hpp"
+#include "utils.hpp"
 
 namespace NBT::Helpers {
+    typedef uint64_t u64;
     using namespace NBT::Type;
-    using NBT::MapLike::MapLike;
+    using std::size_t, std::span, std::string, std::string_view, std::tuple, std::unordered_map, NBT::MapLike::MapLike, NBT::Utils::hashKey;
 
     template <Types T, typename P> requires MapLike<P>
     struct TagOf {
@@ -49,4 +60,156 @@ namespace NBT::Helpers {
         if (it == members.end()) return defaultValue;
         return valueOr<T, P>(it->second, defaultValue);
     }
+
+    //A string literal usable as a template argument: `get<"position", Types::ArrayDouble>(object)`.
+    template <size_t N>
+    struct FixedString {
+        char data[N]{};
+
+        consteval FixedString(const char (&text)[N]) noexcept { std::copy_n(text, N, data); }
+
+        [[nodiscard]] constexpr string_view view() const noexcept { return {data, N - 1}; }
+    };
+
+    //A key whose hash is already known, so that maps using `KeyHash` don't hash it again.
+    struct PrehashedKey {
+        string_view key;
+        u64 hash;
+    };
+
+    //Transparent hash and equality for `string` keys: lookups by `string_view`, `const char*` or `PrehashedKey` don't build a temporary `string`.
+    struct KeyHash {
+        using is_transparent = void;
+
+        [[nodiscard]] size_t operator()(string_view key) const noexcept { return hashKey(key); }
+        [[nodiscard]] size_t operator()(const string& key) const noexcept { return hashKey(key); }
+        [[nodiscard]] size_t operator()(const char* key) const noexcept { return hashKey(key); }
+        [[nodiscard]] size_t operator()(const PrehashedKey& key) const noexcept { return key.hash; }
+    };
+
+    struct KeyEqual {
+        using is_transparent = void;
+
+        template <typename A, typename B>
+        [[nodiscard]] bool operator()(const A& a, const B& b) const noexcept { return view(a) == view(b); }
+
+    private:
+        [[nodiscard]] static string_view view(string_view key) noexcept { return key; }
+        [[nodiscard]] static string_view view(const PrehashedKey& key) noexcept { return key.key; }
+    };
+
+    //The map to hand to `CGNBT_USE_MAP_CONTAINER` for the fastest `get`: `CGNBT_USE_MAP_CONTAINER(NBT::Helpers::HashedMap, Map, Policy)`.
+    template <typename K, typename V>
+    using HashedMap = unordered_map<K, V, KeyHash, KeyEqual>;
+
+    template <typename M>
+    concept PrehashedLookup = requires { typename M::hasher; typename M::key_equal; } && std::is_invocable_v<const typename M::hasher&, const PrehashedKey&> && std::is_invocable_v<const typename M::key_equal&, const string&, const PrehashedKey&>;
+
+    //Uses the precomputed hash if the map's hasher accepts `PrehashedKey`, then heterogeneous lookup, and builds a `string` only as a last resort.
+    template <typename M>
+    [[nodiscard]] inline auto findKey(const M& members, const PrehashedKey& key) noexcept {
+        if constexpr (PrehashedLookup<M>) return members.find(key);
+        else if constexpr (requires { members.find(key.key); }) return members.find(key.key);
+        else return members.find(string(key.key));
+    }
+
+    //Pointer to the payload of member `Key` if it exists and has type `T`, `nullptr` otherwise. Nothing is copied and the key is hashed at compile time.
+    template <FixedString Key, Types T, typename P> requires MapLike<P>
+    [[nodiscard]] inline const decltype(TagOf<T, P>::type::payload)* get(const typename P::template map<string, Tag<P>>& members) noexcept {
+        static constexpr PrehashedKey key{Key.view(), hashKey(Key.view())};
+        const auto it = findKey(members, key);
+        if (it == members.end() || it->second.type != T) return nullptr;
+        return &(it->second.*(TagOf<T, P>::field)).payload;
+    }
+
+    template <FixedString Key, Types T, typename P> requires MapLike<P>
+    [[nodiscard]] inline const decltype(TagOf<T, P>::type::payload)* get(const TagObject<P>& object) noexcept { return get<Key, T, P>(object.payload); }
+
+    template <FixedString Key, Types T, typename P> requires MapLike<P>
+    [[nodiscard]] inline const decltype(TagOf<T, P>::type::payload)* get(const Tag<P>& tag) noexcept {
+        if (tag.type != Types::Object) return nullptr;
+        return get<Key, T, P>(tag.tagObject.payload);
+    }
+
+    //Zero-copy accessors: they return `nullptr` or an empty span/view where `valueOr`/`memberOr` would return the default value.
+    //The results point into the tree and stay valid as long as the tag isn't modified or destroyed.
+    template <Types T, typename P> requires MapLike<P>
+    using PayloadOf = decltype(TagOf<T, P>::type::payload);
+
+    template <Types T, typename P> requires MapLike<P>
+    [[nodiscard]] inline const PayloadOf<T, P>* valuePtr(const Tag<P>& tag) noexcept {
+        if (tag.type != T) return nullptr;
+        return &(tag.*(TagOf<T, P>::field)).payload;
+    }
+
+    template <Types T, typename P> requires MapLike<P>
+    [[nodiscard]] inline const PayloadOf<T, P>* memberPtr(const typename P::template map<string, Tag<P>>& members, string_view name) noexcept {
+        const auto it = findKey(members, PrehashedKey{name, hashKey(name)});
+        if (it == members.end()) return nullptr;
+        return valuePtr<T, P>(it->second);
+    }
+
+    //For `Array` and the typed arrays, e.g. `memberSpan<Types::ArrayDouble, Policy>(members, "position")` is a `span<const double>`.
+    template <Types T, typename P> requires MapLike<P> && (getOriginalType(T) == Types::Array)
+    [[nodiscard]] inline span<const typename PayloadOf<T, P>::value_type> valueSpan(const Tag<P>& tag) noexcept {
+        const auto* payload = valuePtr<T, P>(tag);
+        if (payload == nullptr) return {};
+        return *payload;
+    }
+
+    template <Types T, typename P> requires MapLike<P> && (getOriginalType(T) == Types::Array)
+    [[nodiscard]] inline span<const typename PayloadOf<T, P>::value_type> memberSpan(const typename P::template map<string, Tag<P>>& members, string_view name) noexcept {
+        const auto* payload = memberPtr<T, P>(members, name);
+        if (payload == nullptr) return {};
+        return *payload;
+    }
+
+    template <typename P> requires MapLike<P>
+    [[nodiscard]] inline string_view valueView(const Tag<P>& tag) noexcept {
+        const auto* payload = valuePtr<Types::String, P>(tag);
+        if (payload == nullptr) return {};
+        return *payload;
+    }
+
+    template <typename P> requires MapLike<P>
+    [[nodiscard]] inline string_view memberView(const typename P::template map<string, Tag<P>>& members, string_view name) noexcept {
+        const auto* payload = memberPtr<Types::String, P>(members, name);
+        if (payload == nullptr) return {};
+        return *payload;
+    }
+
+    //One requested member for `extract`.
+    template <FixedString Key, Types T>
+    struct Member {
+        static constexpr string_view key = Key.view();
+        static constexpr u64 hash = hashKey(Key.view());
+        static constexpr Types type = T;
+    };
+
+    //Objects with at most this many members per requested field are scanned once instead of being probed field by field.
+    inline constexpr u64 EXTRACT_SCAN_RATIO = 4;
+
+    //Pointers to several members at once, `nullptr` for missing or mistyped ones:
+    //`const auto [position, hp] = extract<Policy, Member<"position", Types::ArrayDouble>, Member<"hp", Types::IVarInt>>(members);`
+    template <typename P, typename... M> requires MapLike<P>
+    [[nodiscard]] inline tuple<const PayloadOf<M::type, P>*...> extract(const typename P::template map<string, Tag<P>>& members) noexcept {
+        tuple<const PayloadOf<M::type, P>*...> result{};
+        if (members.size() > EXTRACT_SCAN_RATIO * sizeof...(M)) {
+            [&]<size_t... I>(std::index_sequence<I...>) {
+                ((std::get<I>(result) = [&] {
+                    const auto it = findKey(members, PrehashedKey{M::key, M::hash});
+                    return it == members.end() ? nullptr : valuePtr<M::type, P>(it->second);
+                }()), ...);
+            }(std::index_sequence_for<M...>{});
+            return result;
+        }
+        u64 remaining = sizeof...(M);
+        for (const auto& [key, value] : members) {
+            [&]<size_t... I>(std::index_sequence<I...>) {
+                ((key == M::key ? (remaining--, std::get<I>(result) = valuePtr<M::type, P>(value)) : nullptr), ...);
+            }(std::index_sequence_for<M...>{});
+            if (remaining == 0) break;
+        }
+        return result;
+    }
 }
\ No newline at end of file
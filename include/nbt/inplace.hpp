@@ -0,0 +1,287 @@
+#pragma once
+#include <concepts>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <span>
+#include <string>
+#include <system_error>
+#ifdef _WIN32
+    #include <fcntl.h>
+    #include <io.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif // _WIN32
+
+#include "adapters.hpp"
+#include "auxiliary.hpp"
+#include "error.hpp"
+#include "FileReader.hpp"
+#include "query.hpp"
+#include "read.hpp"
+#include "types.hpp"
+#include "write.hpp"
+
+namespace NBT::InPlace {
+    typedef uint8_t u8;
+    typedef uint64_t u64;
+    using namespace NBT::Type;
+    using std::span, std::string, std::format, std::ifstream, std::ios, std::same_as, std::filesystem::path, NBT::Aux::readVarText, NBT::Aux::readUVarInt, NBT::Error::clearErrors, NBT::Error::pushError, NBT::IO::FileReader, NBT::IO::Readable, NBT::IO::MAGIC, NBT::Query::Path, NBT::Query::Steps;
+
+    //Where a fixed-width value lives in a plain file. `offset` counts from the start of the file, magic included.
+    //`packed` values (`Bool`, `Hex`) share their byte with the head byte; `type` is the scalar type, also for typed array elements.
+    struct Location {
+        u64 offset{0};
+        Types type{Types::Count};
+        bool packed{false};
+    };
+
+    template <typename T>
+    concept FixedWidth = same_as<T, TagBool> || same_as<T, TagHex> || same_as<T, TagFloat> || same_as<T, TagDouble> || same_as<T, TagRaw>;
+
+    namespace detail {
+        [[nodiscard]] inline bool notFound(const Path& path, const char* reason) noexcept {
+            pushError(format("Can't locate \"{}\": {}", Query::toString(path), reason));
+            return false;
+        }
+
+        [[nodiscard]] inline constexpr u64 width(Types element) noexcept {
+            switch (element) {
+                case Types::Float:  return sizeof(float);
+                case Types::Double: return sizeof(double);
+                default:            return 1;
+            }
+        }
+
+        [[nodiscard]] inline constexpr Types elementType(Types array) noexcept {
+            switch (array) {
+                case Types::ArrayBool:   return Types::Bool;
+                case Types::ArrayHex:    return Types::Hex;
+                case Types::ArrayFloat:  return Types::Float;
+                case Types::ArrayDouble: return Types::Double;
+                case Types::ArrayRaw:    return Types::Raw;
+                default:                 return Types::Count;
+            }
+        }
+
+        //The bytes `location` covers have to lie inside the document: forged counts and cut-off documents point past its end.
+        [[nodiscard]] inline bool inside(const Path& path, const Location& location, u64 size) noexcept {
+            if (location.offset <= size && width(location.type) <= size - location.offset) return true;
+            return notFound(path, "the value lies past the end of the document");
+        }
+
+        template<Readable S>
+        [[nodiscard]] inline bool members(FileReader<S>& cursor, const Path& path, u64 step, Location& result) noexcept;
+
+        //`head` has been consumed, and so has the key for members. `headOffset` is the decoded offset of `head`.
+        template<Readable S>
+        [[nodiscard]] inline bool value(FileReader<S>& cursor, u8 head, u64 headOffset, const Path& path, u64 step, Location& result) noexcept {
+            const Types type = getType(head);
+            if (step == path.steps.size()) {
+                switch (type) {
+                    case Types::Bool:
+                    case Types::Hex:    result = {headOffset + MAGIC.size(), type, true}; return true;
+                    case Types::Float:
+                    case Types::Double:
+                    case Types::Raw:    result = {cursor.currentOffset() + MAGIC.size(), type, false}; return true;
+                    default:            return notFound(path, "not a fixed-width value");
+                }
+            }
+            const auto& next = path.steps[step];
+            if (next.kind == Steps::Key) {
+                if (type != Types::Object) return notFound(path, "not an object");
+                return members(cursor, path, step, result);
+            }
+            if (next.kind != Steps::Index) return notFound(path, "wildcards aren't supported");
+            const u64 count = readUVarInt(cursor);
+            if (!cursor || cursor.overrun()) return notFound(path, "unexpected EOF");
+            if (next.index >= count) return notFound(path, "index out of range");
+            if (const Types element = elementType(type); element != Types::Count) {
+                if (step + 1 != path.steps.size()) return notFound(path, "typed array elements have no children");
+                //Also keeps `next.index * width` from wrapping around.
+                if (const auto left = cursor.remaining(); left < 0 || next.index >= static_cast<u64>(left) / width(element)) return notFound(path, "the value lies past the end of the document");
+                result = {cursor.currentOffset() + MAGIC.size() + next.index * width(element), element, false};
+                return true;
+            }
+            if (type != Types::Array) return notFound(path, "not an array");
+            const Types second = getSecondType(head);
+            for (u64 i = 0; i < next.index; i++) if (!IO::skipElement(cursor, second)) return false;
+            if (second == Types::Object) {
+                if (step + 1 == path.steps.size() || path.steps[step + 1].kind != Steps::Key) return notFound(path, "not a fixed-width value");
+                return members(cursor, path, step + 1, result);
+            }
+            if (second == Types::Array) {
+                const u64 elementOffset = cursor.currentOffset();
+                const u8 elementHead = *cursor;
+                ++cursor;
+                if (cursor.overrun()) return notFound(path, "unexpected EOF");
+                return value(cursor, elementHead, elementOffset, path, step + 1, result);
+            }
+            return notFound(path, "not a fixed-width value");
+        }
+
+        template<Readable S>
+        [[nodiscard]] inline bool members(FileReader<S>& cursor, const Path& path, u64 step, Location& result) noexcept {
+            const string& wanted = path.steps[step].key;
+            string key;
+            while (!!cursor) {
+                const u64 headOffset = cursor.currentOffset();
+                const u8 head = *cursor;
+                ++cursor;
+                if (getType(head) == Types::ObjectEnd) return notFound(path, "no such member");
+                readVarText(cursor, key);
+                if (cursor.overrun()) break;
+                if (key == wanted) return value(cursor, head, headOffset, path, step + 1, result);
+                if (!IO::skipValue(cursor, head)) return false;
+            }
+            return notFound(path, "unexpected EOF");
+        }
+
+        template<Readable S>
+        [[nodiscard]] inline bool open(FileReader<S>& cursor, const Path& path) noexcept {
+            if (!cursor) return false;
+            if (cursor.compressed()) return notFound(path, "in-place updates need an uncompressed file");
+            if (path.steps.empty() || path.steps.front().kind != Steps::Key) return notFound(path, "paths must start with a key");
+            if (cursor.empty()) return notFound(path, "empty file");
+            return true;
+        }
+
+        //Appended files may repeat top-level keys, and only the last copy is live. This counts the copies before it.
+        template<Readable S>
+        [[nodiscard]] inline bool earlierCopies(S& source, const Path& path, u64& result) noexcept {
+            FileReader<S> cursor(source);
+            if (!open(cursor, path)) return false;
+            string key;
+            u64 seen = 0;
+            while (!!cursor) {
+                const u8 head = *cursor;
+                ++cursor;
+                readVarText(cursor, key);
+                if (cursor.overrun()) return notFound(path, "unexpected EOF");
+                if (key == path.steps.front().key) seen++;
+                if (!IO::skipValue(cursor, head)) return false;
+            }
+            if (seen == 0) return notFound(path, "no such member");
+            result = seen - 1;
+            return true;
+        }
+
+        template<Readable S>
+        [[nodiscard]] inline bool find(S& source, const Path& path, u64 skipCopies, Location& result) noexcept {
+            FileReader<S> cursor(source);
+            if (!open(cursor, path)) return false;
+            string key;
+            while (!!cursor) {
+                const u64 headOffset = cursor.currentOffset();
+                const u8 head = *cursor;
+                ++cursor;
+                readVarText(cursor, key);
+                if (cursor.overrun()) return notFound(path, "unexpected EOF");
+                if (key == path.steps.front().key && skipCopies-- == 0) return value(cursor, head, headOffset, path, 1, result);
+                if (!IO::skipValue(cursor, head)) return false;
+            }
+            return notFound(path, "no such member");
+        }
+    }
+
+    //Finds the fixed-width value `path` points to with a skip-scan: everything but the target is skipped, not parsed.
+    //`path` may only contain `Key` and `Index` steps. Compressed documents are rejected, since their offsets can't be written to.
+    //The top level is scanned twice, because a later copy of a key (see `appendFile`) supersedes earlier ones.
+    [[nodiscard]] inline bool locate(span<const u8> data, const Path& path, Location& result) noexcept {
+        clearErrors();
+        result = {};
+        u64 earlier = 0;
+        IO::SpanIn first(data), second(data);
+        return detail::earlierCopies(first, path, earlier) && detail::find(second, path, earlier, result) && detail::inside(path, result, data.size());
+    }
+
+    [[nodiscard]] inline bool locate(const path& file, const Path& path, Location& result) noexcept {
+        clearErrors();
+        result = {};
+        u64 earlier = 0;
+        ifstream s(file, ios::binary);
+        IO::StdIn first(s);
+        if (!detail::earlierCopies(first, path, earlier)) return false;
+        s.clear();
+        IO::StdIn second(s);
+        if (!detail::find(second, path, earlier, result)) return false;
+        std::error_code error;
+        const auto size = std::filesystem::file_size(file, error);
+        if (error) return detail::notFound(path, "can't stat the file");
+        return detail::inside(path, result, static_cast<u64>(size));
+    }
+
+    namespace detail {
+        [[nodiscard]] inline bool rejected(const Path& path, const char* reason) noexcept {
+            pushError(format("Can't overwrite \"{}\": {}", Query::toString(path), reason));
+            return false;
+        }
+
+        template <FixedWidth T>
+        [[nodiscard]] inline bool encode(const T& value, const Location& location, const Path& path, u8* bytes, u64& size) noexcept {
+            Types type;
+            if constexpr (same_as<T, TagBool>) type = Types::Bool;
+            else if constexpr (same_as<T, TagHex>) type = Types::Hex;
+            else if constexpr (same_as<T, TagFloat>) type = Types::Float;
+            else if constexpr (same_as<T, TagDouble>) type = Types::Double;
+            else type = Types::Raw;
+            if (type != location.type) return rejected(path, "the stored value has another type");
+            if constexpr (same_as<T, TagBool> || same_as<T, TagHex>) {
+                if (location.packed) {
+                    if constexpr (same_as<T, TagHex>) if (value.payload > 0x0F) return rejected(path, "`Hex` values are 4 bits wide");
+                    bytes[0] = getHead(type) | static_cast<u8>(value.payload);
+                }
+                else bytes[0] = static_cast<u8>(value.payload);
+                size = 1;
+            }
+            else {
+                std::memcpy(bytes, &value.payload, sizeof(value.payload));
+                size = sizeof(value.payload);
+            }
+            return true;
+        }
+    }
+
+    //Overwrites one fixed-width value of an uncompressed document held in writable memory, e.g. a shared `mmap` of the file.
+    template <FixedWidth T>
+    [[nodiscard]] inline bool overwrite(span<u8> data, const Path& path, const T& value) noexcept {
+        Location location;
+        if (!locate(data, path, location)) return false;
+        u8 bytes[sizeof(double)];
+        u64 size;
+        if (!detail::encode(value, location, path, bytes, size)) return false;
+        std::memcpy(data.data() + location.offset, bytes, size);
+        return true;
+    }
+
+    //Overwrites one fixed-width value of an uncompressed file with a single positioned write; nothing else is read past it
+    //or rewritten. The file keeps its size, so concurrent readers see either the old or the new value of a single scalar.
+    template <FixedWidth T>
+    [[nodiscard]] inline bool overwrite(const path& file, const Path& path, const T& value) noexcept {
+        Location location;
+        if (!locate(file, path, location)) return false;
+        u8 bytes[sizeof(double)];
+        u64 size;
+        if (!detail::encode(value, location, path, bytes, size)) return false;
+#ifdef _WIN32
+        const int fd = _wopen(file.c_str(), _O_WRONLY | _O_BINARY);
+#else
+        const int fd = ::open(file.c_str(), O_WRONLY);
+#endif // _WIN32
+        if (fd < 0) {
+            pushError(format("Can't open \"{}\" for writing!", file.string()));
+            return false;
+        }
+        IO::FdOut out(fd, static_cast<IO::i64>(location.offset));
+        const bool written = out.writeBlock(bytes, size);
+#ifdef _WIN32
+        _close(fd);
+#else
+        ::close(fd);
+#endif // _WIN32
+        if (!written) pushError(format("Failed to write to \"{}\"!", file.string()));
+        return written;
+    }
+}
\ No newline at end of file
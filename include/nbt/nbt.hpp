@@ -1,18 +1,44 @@
 #pragma once 
 
+#include "append.hpp"    // IWYU pragma: export
+#include "batch.hpp"     // IWYU pragma: export
+#include "builder.hpp"   // IWYU pragma: export
+#include "cache.hpp"     // IWYU pragma: export
+#include "diff.hpp"      // IWYU pragma: export
 #include "error.hpp"     // IWYU pragma: export
+#include "frozen.hpp"    // IWYU pragma: export
+#include "gather.hpp"    // IWYU pragma: export
+#include "hash.hpp"      // IWYU pragma: export
 #include "helpers.hpp"   // IWYU pragma: export
+#include "inplace.hpp"   // IWYU pragma: export
+#include "parallel.hpp"  // IWYU pragma: export
+#include "query.hpp"     // IWYU pragma: export
 #include "read.hpp"      // IWYU pragma: export
+#include "reflect.hpp"   // IWYU pragma: export
+#include "region.hpp"    // IWYU pragma: export
+#include "reparse.hpp"   // IWYU pragma: export
 #include "serialize.hpp" // IWYU pragma: export
+#include "shared.hpp"    // IWYU pragma: export
+#include "tape.hpp"      // IWYU pragma: export
 #include "types.hpp"     // IWYU pragma: export
+#include "versioned.hpp" // IWYU pragma: export
 #include "write.hpp"     // IWYU pragma: export
 
 namespace NBT {
     //IO APIs
-    using NBT::IO::readStream, NBT::IO::readData, NBT::IO::writeStream, NBT::IO::writeData, NBT::IO::serialize, NBT::IO::getFileInfo, NBT::IO::NBTFileInfo;
+    using NBT::IO::readStream, NBT::IO::readData, NBT::IO::ReadLimits, NBT::IO::readStreamInto, NBT::IO::readDataInto, NBT::IO::writeStream, NBT::IO::writeData, NBT::IO::writeStreamVectored, NBT::IO::writeSegments, NBT::IO::SegmentList, NBT::IO::writeDataParallel, NBT::IO::writeStreamParallel, NBT::IO::Builder, NBT::IO::serialize, NBT::IO::getFileInfo, NBT::IO::NBTFileInfo, NBT::IO::appendFile, NBT::IO::compactFile;
     
+    //Reflection
+    using NBT::Reflect::Reflected;
+
+    //Hashing
+    using NBT::Hash::digest;
+
+    //Caching
+    using NBT::Cache::DocumentCache;
+
     //Errors
-    using NBT::Error::getLastError, NBT::Error::getErrors;
+    using NBT::Error::getLastError, NBT::Error::getErrors, NBT::Error::getRecords;
 
     //Tags
     using NBT::Type::Tag;
@@ -21,7 +47,7 @@ namespace NBT {
     using NBT::Type::Types;
 
     //Helpers
-    using NBT::Helpers::TagOf, NBT::Helpers::valueOr, NBT::Helpers::memberOr;
+    using NBT::Helpers::TagOf, NBT::Helpers::valueOr, NBT::Helpers::memberOr, NBT::Helpers::valuePtr, NBT::Helpers::memberPtr, NBT::Helpers::valueSpan, NBT::Helpers::memberSpan, NBT::Helpers::valueView, NBT::Helpers::memberView, NBT::Helpers::extract, NBT::Helpers::Member, NBT::Helpers::get, NBT::Helpers::FixedString, NBT::Helpers::KeyHash, NBT::Helpers::KeyEqual, NBT::Helpers::HashedMap;
     #define CGNBT_USE_MAP_CONTAINER(mapTemplate, mapTypeOutput, policyOutput) \
     struct policyOutput { \
         template <typename K, typename V> \
@@ -0,0 +1,280 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "adapters.hpp"
+#include "auxiliary.hpp"
+#include "error.hpp"
+#include "FileReader.hpp"
+#include "mapLike.hpp"
+#include "types.hpp"
+#include "write.hpp"
+
+namespace NBT::Parallel {
+    typedef uint32_t u32;
+    typedef uint64_t u64;
+    using std::atomic, std::condition_variable, std::deque, std::function, std::unique_ptr, std::make_unique, std::mutex, std::lock_guard, std::unique_lock, std::optional, std::nullopt, std::thread, std::vector, std::move;
+
+    //Work-stealing thread pool. Every worker owns a deque: it pops its own work from the back and steals from the front of the others.
+    //Tasks must not throw. `wait` is meant for one submitting thread at a time, which also runs queued tasks while it waits.
+    struct Pool {
+        //`threads == 0` uses one worker per hardware thread.
+        [[nodiscard]] explicit Pool(u32 threads = 0) noexcept {
+            if (threads == 0) threads = thread::hardware_concurrency() > 0 ? thread::hardware_concurrency() : 1;
+            for (u32 i = 0; i < threads; i++) queues_.push_back(make_unique<Queue>());
+            for (u32 i = 0; i < threads; i++) workers_.emplace_back([this, i] { run(i); });
+        }
+
+        Pool(const Pool&) = delete;
+        Pool& operator=(const Pool&) = delete;
+
+        ~Pool() {
+            {
+                lock_guard lock(sleep_);
+                stop_ = true;
+            }
+            wake_.notify_all();
+            for (auto& worker : workers_) worker.join();
+        }
+
+        [[nodiscard]] u32 size() const noexcept { return static_cast<u32>(workers_.size()); }
+
+        //Called from a worker, the task goes to that worker's own deque; otherwise the deques are filled round-robin.
+        void submit(function<void()> task) noexcept {
+            const u64 target = current_ == this ? currentIndex_ : next_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+            pending_.fetch_add(1, std::memory_order_relaxed);
+            {
+                lock_guard lock(queues_[target]->lock);
+                queues_[target]->tasks.push_back(move(task));
+            }
+            {
+                lock_guard lock(sleep_);
+                queued_++;
+            }
+            wake_.notify_one();
+        }
+
+        //Blocks until every submitted task has finished, helping out in the meantime.
+        void wait() noexcept {
+            while (pending_.load(std::memory_order_acquire) > 0) {
+                if (auto task = take(next_.fetch_add(1, std::memory_order_relaxed) % queues_.size(), false)) {
+                    (*task)();
+                    finish();
+                    continue;
+                }
+                unique_lock lock(sleep_);
+                done_.wait(lock, [this] { return pending_.load(std::memory_order_acquire) == 0 || queued_ > 0; });
+            }
+        }
+
+    private:
+        struct Queue {
+            mutex lock;
+            deque<function<void()>> tasks;
+        };
+        vector<unique_ptr<Queue>> queues_;
+        vector<thread> workers_;
+        mutex sleep_;
+        condition_variable wake_, done_;
+        //`queued_` is guarded by `sleep_` so that sleepers can't miss a submission.
+        u64 queued_{0};
+        bool stop_{false};
+        atomic<u64> pending_{0}, next_{0};
+        static inline thread_local const Pool* current_ = nullptr;
+        static inline thread_local u64 currentIndex_ = 0;
+
+        [[nodiscard]] optional<function<void()>> take(u64 self, bool own) noexcept {
+            optional<function<void()>> result;
+            for (u64 i = 0; i < queues_.size() && !result; i++) {
+                auto& queue = *queues_[(self + i) % queues_.size()];
+                lock_guard lock(queue.lock);
+                if (queue.tasks.empty()) continue;
+                //Owners work LIFO for locality, thieves take the oldest (usually largest) task.
+                if (own && i == 0) {
+                    result = move(queue.tasks.back());
+                    queue.tasks.pop_back();
+                }
+                else {
+                    result = move(queue.tasks.front());
+                    queue.tasks.pop_front();
+                }
+            }
+            if (result) {
+                lock_guard lock(sleep_);
+                queued_--;
+            }
+            return result;
+        }
+
+        void finish() noexcept {
+            if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                lock_guard lock(sleep_);
+                done_.notify_all();
+            }
+        }
+
+        void run(u32 index) noexcept {
+            current_ = this;
+            currentIndex_ = index;
+            while (true) {
+                if (auto task = take(index, true)) {
+                    (*task)();
+                    finish();
+                    continue;
+                }
+                unique_lock lock(sleep_);
+                wake_.wait(lock, [this] { return stop_ || queued_ > 0; });
+                if (stop_ && queued_ == 0) return;
+            }
+        }
+    };
+}
+
+namespace NBT::IO {
+    typedef uint8_t u8;
+    typedef uint32_t u32;
+    typedef uint64_t u64;
+    using namespace NBT::Type;
+    using std::vector, std::string, std::ostream, std::move, NBT::Aux::writeVarText, NBT::Aux::writeUVarInt, NBT::Error::clearErrors, NBT::Error::pushError, NBT::Error::getErrors, NBT::MapLike::MapLike, NBT::Parallel::Pool;
+
+    //Rough encoded size of one task worth handing to another thread.
+    inline constexpr u64 PARALLEL_GRAIN = 64 * 1024;
+    //Objects with at least this many members are split member by member instead of being encoded as one task.
+    inline constexpr u64 PARALLEL_SPLIT_MEMBERS = 64;
+    //Arrays of objects with at least this many elements are split into element ranges.
+    inline constexpr u64 PARALLEL_SPLIT_ELEMENTS = 64;
+
+    namespace detail {
+        //A piece of the final output, in document order. Exactly one of the three is used.
+        template <typename P> requires MapLike<P>
+        struct Job {
+            vector<u8> bytes;
+            vector<const typename P::template map<string, Tag<P>>::value_type*> members;
+            const Tag<P>* elements{nullptr};
+            u64 count{0};
+            bool ok{true};
+            vector<string> errors;
+        };
+
+        //Shallow estimate only: walking the whole tree up front would cost as much as a good part of the encoding itself.
+        template <typename P> requires MapLike<P>
+        [[nodiscard]] inline u64 estimate(const Tag<P>& tag) noexcept {
+            switch (tag.type) {
+                case Types::Object:      return 64 * tag.tagObject.payload.size() + 1;
+                case Types::Array:       return 64 * tag.tagArray.payload.size() + 1;
+                case Types::String:      return tag.tagString.payload.size() + 2;
+                case Types::ArrayBool:   return tag.tagArrayBool.payload.size() + 2;
+                case Types::ArrayHex:    return tag.tagArrayHex.payload.size() + 2;
+                case Types::ArrayFloat:  return sizeof(float) * tag.tagArrayFloat.payload.size() + 2;
+                case Types::ArrayDouble: return sizeof(double) * tag.tagArrayDouble.payload.size() + 2;
+                case Types::ArrayRaw:    return tag.tagArrayRaw.payload.size() + 2;
+                default:                 return 10;
+            }
+        }
+
+        template <typename P> requires MapLike<P>
+        inline void plan(const typename P::template map<string, Tag<P>>& data, vector<Job<P>>& jobs) noexcept {
+            Job<P> run;
+            u64 runWeight = 0;
+            const auto flush = [&] {
+                if (run.members.empty()) return;
+                jobs.push_back(move(run));
+                run = {};
+                runWeight = 0;
+            };
+            const auto header = [&](u8 head, const string& key) -> vector<u8>& {
+                flush();
+                jobs.push_back({});
+                jobs.back().bytes.push_back(head);
+                writeVarText(key, jobs.back().bytes);
+                return jobs.back().bytes;
+            };
+            for (const auto& member : data) {
+                const auto& [key, value] = member;
+                if (value.type == Types::Object && value.tagObject.payload.size() >= PARALLEL_SPLIT_MEMBERS) {
+                    header(getHead(Types::Object), key);
+                    plan<P>(value.tagObject.payload, jobs);
+                    jobs.push_back({});
+                    jobs.back().bytes.push_back(static_cast<u8>(Types::ObjectEnd));
+                }
+                else if (value.type == Types::Array && value.tagArray.payload.size() >= PARALLEL_SPLIT_ELEMENTS && value.tagArray.payload[0].type == Types::Object) {
+                    const auto& elements = value.tagArray.payload;
+                    writeUVarInt(elements.size(), header(getHead(Types::Array) | static_cast<u8>(Types::Object), key));
+                    //Same grain for elements as for members, measured on the first element.
+                    const u64 step = std::max<u64>(1, PARALLEL_GRAIN / estimate(elements[0]));
+                    for (u64 i = 0; i < elements.size(); i += step) {
+                        jobs.push_back({});
+                        jobs.back().elements = elements.data() + i;
+                        jobs.back().count = std::min<u64>(step, elements.size() - i);
+                    }
+                }
+                else {
+                    run.members.push_back(&member);
+                    runWeight += key.size() + estimate(value);
+                    if (runWeight >= PARALLEL_GRAIN) flush();
+                }
+            }
+            flush();
+        }
+
+        template <typename P> requires MapLike<P>
+        inline void encode(Job<P>& job) noexcept {
+            clearErrors();
+            for (const auto* member : job.members) if (!(job.ok = writeMember(member->first, member->second, job.bytes))) break;
+            for (u64 i = 0; i < job.count && job.ok; i++) {
+                if ((job.ok = writeObject(job.elements[i].tagObject, job.bytes))) job.bytes.push_back(static_cast<u8>(Types::ObjectEnd));
+            }
+            if (!job.ok) job.errors = getErrors();
+            clearErrors();
+        }
+    }
+
+    //Byte-identical to `writeData`: large objects and large arrays of objects are cut into independent subtrees, encoded on `pool` into separate buffers and concatenated in document order.
+    template <typename P> requires MapLike<P>
+    [[nodiscard]] inline bool writeDataParallel(const typename P::template map<string, Tag<P>>& data, vector<u8>& result, Pool& pool, bool addMagic = false) noexcept {
+        clearErrors();
+        vector<detail::Job<P>> jobs;
+        detail::plan<P>(data, jobs);
+        u64 tasks = 0;
+        for (auto& job : jobs) if (!job.members.empty() || job.count > 0) tasks++;
+        if (tasks <= 1 || pool.size() <= 1) return writeData<P>(data, result, addMagic);
+        for (auto& job : jobs) if (!job.members.empty() || job.count > 0) pool.submit([&job] { detail::encode(job); });
+        pool.wait();
+        u64 total = addMagic ? MAGIC.size() : 0;
+        for (const auto& job : jobs) {
+            if (!job.ok) {
+                for (const auto& error : job.errors) pushError(error);
+                return false;
+            }
+            total += job.bytes.size();
+        }
+        result.reserve(result.size() + total);
+        if (addMagic) result.insert(result.end(), MAGIC.begin(), MAGIC.end());
+        for (const auto& job : jobs) result.insert(result.end(), job.bytes.begin(), job.bytes.end());
+        return true;
+    }
+
+    //The decompressed content matches `writeStream`; with `zstd` the compressor also runs on `pool.size()` threads, so the compressed bytes may differ.
+    template<typename P, Writable W> requires MapLike<P>
+    [[nodiscard]] inline bool writeStreamParallel(W& dest, const typename P::template map<string, Tag<P>>& data, Pool& pool, bool zstd = false, u8 compressionLevel = 3) noexcept {
+        vector<u8> result;
+        if (!writeDataParallel<P>(data, result, pool, !zstd)) return false;
+        return emitBuffer(dest, result, zstd, compressionLevel, pool.size());
+    }
+
+    template <typename P> requires MapLike<P>
+    [[nodiscard]] inline bool writeStreamParallel(ostream& s, const typename P::template map<string, Tag<P>>& data, Pool& pool, bool zstd = false, u8 compressionLevel = 3) noexcept {
+        StdOut adapter(s);
+        return writeStreamParallel<P>(adapter, data, pool, zstd, compressionLevel);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,234 @@
+#pragma once
+#include <charconv>
+#include <format>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "error.hpp"
+#include "helpers.hpp"
+#include "mapLike.hpp"
+#include "types.hpp"
+#include "utils.hpp"
+
+namespace NBT::Query {
+    typedef uint8_t u8;
+    typedef int64_t i64;
+    typedef uint64_t u64;
+    using namespace NBT::Type;
+    using std::span, std::string, std::string_view, std::vector, std::format, NBT::Error::clearErrors, NBT::Error::pushError, NBT::Helpers::PrehashedKey, NBT::Helpers::findKey, NBT::MapLike::MapLike, NBT::Utils::hashKey;
+
+    enum class Steps : u8 {
+        Key,        //`name` or `["any text"]`
+        Index,      //`[3]`
+        AnyMember,  //`*`
+        AnyElement  //`[*]`
+    };
+
+    struct Step {
+        Steps kind;
+        string key;
+        u64 hash{0}, index{0};
+    };
+
+    //A compiled path expression such as `entities[*].inventory[3].id` or `regions.*.meta.version`.
+    //Compile once with `compile`, then run it any number of times with `select`.
+    struct Path {
+        vector<Step> steps;
+    };
+
+    //`index < 0`: `tag` itself matched. Otherwise the match is element `index` of `tag`, which is a `String` or a typed array.
+    //`document` is the position of the source document for `selectAll`.
+    template <typename P> requires MapLike<P>
+    struct Match {
+        const Tag<P>* tag;
+        i64 index{-1};
+        u64 document{0};
+    };
+
+    namespace detail {
+        [[nodiscard]] inline bool keyChar(char c) noexcept { return c != '.' && c != '[' && c != ']' && c != '*' && c != '"'; }
+
+        [[nodiscard]] inline bool syntaxError(string_view expression, u64 position, const char* reason) noexcept {
+            pushError(format("Invalid path \"{}\" at pos {}: {}", expression, position, reason));
+            return false;
+        }
+    }
+
+    //Syntax: steps are separated by `.`; `*` matches every member of an object, `[n]` an array element, `[*]` every element.
+    //Keys containing `.`, `[`, `]`, `*` or `"` are written as `["key"]`, with `\"` and `\\` escapes.
+    [[nodiscard]] inline bool compile(string_view expression, Path& result) noexcept {
+        clearErrors();
+        result.steps.clear();
+        u64 i = 0;
+        //Whether a `.` or the start of the expression precedes the current position, i.e. whether a bare key may follow.
+        bool separated = true;
+        while (i < expression.size()) {
+            const char c = expression[i];
+            if (c == '.') {
+                if (separated) return detail::syntaxError(expression, i, "empty step");
+                separated = true;
+                i++;
+            }
+            else if (c == '*') {
+                if (!separated) return detail::syntaxError(expression, i, "`*` must follow a `.`");
+                result.steps.push_back({Steps::AnyMember, {}});
+                separated = false;
+                i++;
+            }
+            else if (c == '[') {
+                if (separated && !result.steps.empty()) return detail::syntaxError(expression, i, "`[` can't follow a `.`");
+                i++;
+                if (i < expression.size() && expression[i] == '*') {
+                    result.steps.push_back({Steps::AnyElement, {}});
+                    i++;
+                }
+                else if (i < expression.size() && expression[i] == '"') {
+                    string key;
+                    for (i++; i < expression.size() && expression[i] != '"'; i++) {
+                        if (expression[i] == '\\' && i + 1 < expression.size()) i++;
+                        key.push_back(expression[i]);
+                    }
+                    if (i >= expression.size()) return detail::syntaxError(expression, i, "unterminated quoted key");
+                    i++;
+                    const u64 hash = hashKey(key);
+                    result.steps.push_back({Steps::Key, std::move(key), hash});
+                }
+                else {
+                    u64 index = 0;
+                    const auto [end, error] = std::from_chars(expression.data() + i, expression.data() + expression.size(), index);
+                    if (error != std::errc()) return detail::syntaxError(expression, i, "expected an index, `*` or a quoted key");
+                    i = end - expression.data();
+                    result.steps.push_back({Steps::Index, {}, 0, index});
+                }
+                if (i >= expression.size() || expression[i] != ']') return detail::syntaxError(expression, i, "expected `]`");
+                i++;
+                separated = false;
+            }
+            else if (detail::keyChar(c)) {
+                if (!separated) return detail::syntaxError(expression, i, "expected `.` or `[`");
+                const u64 start = i;
+                while (i < expression.size() && detail::keyChar(expression[i])) i++;
+                const string_view key = expression.substr(start, i - start);
+                result.steps.push_back({Steps::Key, string(key), hashKey(key)});
+                separated = false;
+            }
+            else return detail::syntaxError(expression, i, "unexpected character");
+        }
+        if (separated) return detail::syntaxError(expression, i, result.steps.empty() ? "empty path" : "trailing `.`");
+        return true;
+    }
+
+    //Inverse of `compile` for paths made of `Key` and `Index` steps only. Keys that aren't valid bare keys are quoted.
+    [[nodiscard]] inline string toString(const Path& path) noexcept {
+        string result;
+        for (const auto& step : path.steps) switch (step.kind) {
+            case Steps::Key: {
+                bool bare = !step.key.empty();
+                for (const char c : step.key) if (!detail::keyChar(c)) bare = false;
+                if (bare) {
+                    if (!result.empty()) result.push_back('.');
+                    result += step.key;
+                }
+                else {
+                    result += "[\"";
+                    for (const char c : step.key) {
+                        if (c == '"' || c == '\\') result.push_back('\\');
+                        result.push_back(c);
+                    }
+                    result += "\"]";
+                }
+                break;
+            }
+            case Steps::Index:      result += format("[{}]", step.index); break;
+            case Steps::AnyMember:  result += result.empty() ? "*" : ".*";  break;
+            case Steps::AnyElement: result += "[*]";                       break;
+        }
+        return result;
+    }
+
+    namespace detail {
+        template <typename P> requires MapLike<P>
+        [[nodiscard]] inline u64 elementCount(const Tag<P>& tag) noexcept {
+            switch (tag.type) {
+                case Types::String:      return tag.tagString.payload.size();
+                case Types::ArrayBool:   return tag.tagArrayBool.payload.size();
+                case Types::ArrayHex:    return tag.tagArrayHex.payload.size();
+                case Types::ArrayFloat:  return tag.tagArrayFloat.payload.size();
+                case Types::ArrayDouble: return tag.tagArrayDouble.payload.size();
+                case Types::ArrayRaw:    return tag.tagArrayRaw.payload.size();
+                default:                 return 0;
+            }
+        }
+
+        template <typename P> requires MapLike<P>
+        inline void run(const Path& path, u64 step, const typename P::template map<string, Tag<P>>& members, u64 document, vector<Match<P>>& result) noexcept;
+
+        template <typename P> requires MapLike<P>
+        inline void run(const Path& path, u64 step, const Tag<P>& tag, u64 document, vector<Match<P>>& result) noexcept {
+            if (step == path.steps.size()) {
+                result.push_back({&tag, -1, document});
+                return;
+            }
+            const auto& current = path.steps[step];
+            switch (current.kind) {
+                case Steps::Key:
+                case Steps::AnyMember: {
+                    if (tag.type == Types::Object) run<P>(path, step, tag.tagObject.payload, document, result);
+                    return;
+                }
+                case Steps::Index: {
+                    if (tag.type == Types::Array) {
+                        if (current.index < tag.tagArray.payload.size()) run<P>(path, step + 1, tag.tagArray.payload[current.index], document, result);
+                    }
+                    //Elements of strings and typed arrays aren't tags, so nothing can follow them.
+                    else if (step + 1 == path.steps.size() && current.index < elementCount(tag)) result.push_back({&tag, static_cast<i64>(current.index), document});
+                    return;
+                }
+                case Steps::AnyElement: {
+                    if (tag.type == Types::Array) for (const auto& element : tag.tagArray.payload) run<P>(path, step + 1, element, document, result);
+                    else if (step + 1 == path.steps.size()) for (u64 i = 0; i < elementCount(tag); i++) result.push_back({&tag, static_cast<i64>(i), document});
+                    return;
+                }
+            }
+        }
+
+        template <typename P> requires MapLike<P>
+        inline void run(const Path& path, u64 step, const typename P::template map<string, Tag<P>>& members, u64 document, vector<Match<P>>& result) noexcept {
+            const auto& current = path.steps[step];
+            if (current.kind == Steps::Key) {
+                const auto it = findKey(members, PrehashedKey{current.key, current.hash});
+                if (it != members.end()) run<P>(path, step + 1, it->second, document, result);
+            }
+            else if (current.kind == Steps::AnyMember) for (const auto& [key, value] : members) run<P>(path, step + 1, value, document, result);
+        }
+    }
+
+    //Appends every match of `path` in the document to `result`, in the map's iteration order. Nothing is copied: matches point into `data`.
+    template <typename P> requires MapLike<P>
+    inline void select(const Path& path, const typename P::template map<string, Tag<P>>& data, vector<Match<P>>& result) noexcept {
+        if (!path.steps.empty()) detail::run<P>(path, 0, data, 0, result);
+    }
+
+    template <typename P> requires MapLike<P>
+    inline void select(const Path& path, const Tag<P>& data, vector<Match<P>>& result) noexcept {
+        if (!path.steps.empty()) detail::run<P>(path, 0, data, 0, result);
+    }
+
+    //Runs one path over many documents; `Match::document` tells which one each match came from.
+    template <typename P> requires MapLike<P>
+    inline void selectAll(const Path& path, span<const typename P::template map<string, Tag<P>>* const> documents, vector<Match<P>>& result) noexcept {
+        if (path.steps.empty()) return;
+        for (u64 i = 0; i < documents.size(); i++) detail::run<P>(path, 0, *documents[i], i, result);
+    }
+
+    //The first match, or `nullptr`. Only tag matches count, use `select` to reach elements of typed arrays.
+    template <typename P> requires MapLike<P>
+    [[nodiscard]] inline const Tag<P>* first(const Path& path, const typename P::template map<string, Tag<P>>& data) noexcept {
+        vector<Match<P>> matches;
+        select<P>(path, data, matches);
+        for (const auto& match : matches) if (match.index < 0) return match.tag;
+        return nullptr;
+    }
+}
\ No newline at end of file
@@ -1,9 +1,12 @@
 #pragma once
+#include <algorithm>
 #include <array>
+#include <bit>
 #include <format>
 #include <istream>
 #include <span>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "adapters.hpp"
@@ -16,12 +19,37 @@
 namespace NBT::IO {
     typedef uint8_t u8;
     typedef uint32_t u32;
+    typedef int64_t i64;
     typedef uint64_t u64;
     using namespace NBT::Type;
-    using std::vector, std::array, std::span, std::string, std::istream, std::move, std::bit_cast, std::to_string, std::format, NBT::Aux::readVarText, NBT::Aux::readIVarInt, NBT::Aux::readUVarInt, NBT::Error::clearErrors, NBT::Error::pushError, NBT::MapLike::MapLike;
+    using std::vector, std::array, std::span, std::string, std::istream, std::move, std::bit_cast, std::to_string, std::format, NBT::Aux::readVarText, NBT::Aux::skipVarText, NBT::Aux::readIVarInt, NBT::Aux::readUVarInt, NBT::Error::clearErrors, NBT::Error::pushError, NBT::Error::enclose, NBT::Error::Code, NBT::MapLike::MapLike;
+
+    //Deep enough for any document that isn't built to be deep, shallow enough to keep the parse stack small.
+    inline constexpr u64 DEFAULT_MAX_DEPTH = 512;
+
+    //Bounds for one parse. Only the depth is bounded by default; set the others for input that can't be trusted.
+    //Whatever the limits, no count read from the input is allocated for before it has been checked against them and
+    //against the input that is left.
+    struct ReadLimits {
+        //Objects and arrays open at the same time, the top level included.
+        u64 depth{DEFAULT_MAX_DEPTH};
+        //Decoded bytes, the magic not included.
+        u64 bytes{UINT64_MAX};
+        //Members and elements of generic arrays, nested ones included. Elements of typed arrays are payload, not tags.
+        u64 tags{UINT64_MAX};
+        //Elements of any one array, typed or generic.
+        u64 arrayLength{UINT64_MAX};
+    };
+
+    //What gets allocated for a payload before its bytes arrive, when how much input is left isn't known (compressed data,
+    //unsized sources). Payloads grow by doubling from there, so a forged count costs at most about twice the real input.
+    inline constexpr u64 UNSIZED_GROWTH = 64 * 1024;
+
+    //For readers that report errors as text.
+    inline constexpr const char* EOF_ERROR = "Failed to read data, EOF reached!";
 
     template<Readable S, typename P> requires MapLike<P>
-    [[nodiscard]] inline bool readObject     (FileReader<S>&, TagObject<P>&  , bool topLevel = false) noexcept;
+    [[nodiscard]] inline bool readObject     (FileReader<S>&, TagObject<P>&  , bool topLevel = false, const ReadLimits& = ReadLimits()) noexcept;
     template<Readable S>
                   inline void readIVarInt    (FileReader<S>&, TagIVarInt&      )                        noexcept;
     template<Readable S>
@@ -35,57 +63,66 @@ namespace NBT::IO {
     template<Readable S>
                   inline void readDouble     (FileReader<S>&, TagDouble&       )                        noexcept;
     template<Readable S, typename P> requires MapLike<P>
-    [[nodiscard]] inline bool readArray      (FileReader<S>&, TagArray<P>&   , const Types)           noexcept;
+    [[nodiscard]] inline bool readArray      (FileReader<S>&, TagArray<P>&   , const Types, const ReadLimits& = ReadLimits()) noexcept;
     template<Readable S>
-    [[nodiscard]] inline bool readString     (FileReader<S>&, TagString&       )                        noexcept;
+    [[nodiscard]] inline bool readString     (FileReader<S>&, TagString&       , const ReadLimits& = ReadLimits()) noexcept;
     template<Readable S>
                   inline void readRaw        (FileReader<S>&, TagRaw&          )                        noexcept;
     template<Readable S>
-    [[nodiscard]] inline bool readArrayBool  (FileReader<S>&, TagArrayBool&    )                        noexcept;
+    [[nodiscard]] inline bool readArrayBool  (FileReader<S>&, TagArrayBool&    , const ReadLimits& = ReadLimits()) noexcept;
     template<Readable S>
-    [[nodiscard]] inline bool readArrayHex   (FileReader<S>&, TagArrayHex&     )                        noexcept;
+    [[nodiscard]] inline bool readArrayHex   (FileReader<S>&, TagArrayHex&     , const ReadLimits& = ReadLimits()) noexcept;
     template<Readable S>
-    [[nodiscard]] inline bool readArrayFloat (FileReader<S>&, TagArrayFloat&   )                        noexcept;
+    [[nodiscard]] inline bool readArrayFloat (FileReader<S>&, TagArrayFloat&   , const ReadLimits& = ReadLimits()) noexcept;
     template<Readable S>
-    [[nodiscard]] inline bool readArrayDouble(FileReader<S>&, TagArrayDouble&  )                        noexcept;
+    [[nodiscard]] inline bool readArrayDouble(FileReader<S>&, TagArrayDouble&  , const ReadLimits& = ReadLimits()) noexcept;
     template<Readable S>
-    [[nodiscard]] inline bool readArrayRaw   (FileReader<S>&, TagArrayRaw&     )                        noexcept;
+    [[nodiscard]] inline bool readArrayRaw   (FileReader<S>&, TagArrayRaw&     , const ReadLimits& = ReadLimits()) noexcept;
+    template<Readable S>
+    [[nodiscard]] inline bool skipValue      (FileReader<S>&, u8               )                        noexcept;
+    template<Readable S>
+    [[nodiscard]] inline bool skipObject     (FileReader<S>&                   )                        noexcept;
+    template<Readable S>
+    [[nodiscard]] inline bool skipArray      (FileReader<S>&, const Types      )                        noexcept;
+    template<Readable S>
+    [[nodiscard]] inline bool skipElement    (FileReader<S>&, const Types      )                        noexcept;
 
     struct NBTFileInfo {
         u64 fileSize{0};
         bool validFile{false}, compressed{false};
     };
 
+    //`context` optionally lends a zstd decompression stream, so that callers decoding many documents can reuse one.
     template<typename P, Readable S> requires MapLike<P>
-    [[nodiscard]] inline bool readStream(S& source, typename P::template map<string, Tag<P>>& result) noexcept {
+    [[nodiscard]] inline bool readStream(S& source, typename P::template map<string, Tag<P>>& result, ZSTD_DStream* context = nullptr, const ReadLimits& limits = ReadLimits()) noexcept {
         clearErrors();
-        FileReader<S> cursor(source);
+        FileReader<S> cursor(source, context);
         result.clear();
         if (!cursor) return false;
         if (cursor.empty()) {
             cursor.close();
             return true;
         }
+        //Parsed in `result`'s own storage, so a map that is read into again keeps its buckets.
         TagObject<P> topLevel;
-        if (readObject(cursor, topLevel, true)) {
-            result = move(topLevel.payload);
-            cursor.close();
-            return true;
-        }
+        topLevel.payload = move(result);
+        const bool success = readObject(cursor, topLevel, true, limits);
+        result = move(topLevel.payload);
+        if (!success) result.clear();
         cursor.close();
-        return false;
+        return success;
     }
 
     template <typename P> requires MapLike<P>
-    [[nodiscard]] inline bool readStream(istream& s, typename P::template map<string, Tag<P>>& result) noexcept {
+    [[nodiscard]] inline bool readStream(istream& s, typename P::template map<string, Tag<P>>& result, const ReadLimits& limits = ReadLimits()) noexcept {
         StdIn adapter(s);
-        return readStream<P>(adapter, result);
+        return readStream<P>(adapter, result, nullptr, limits);
     }
 
     template <typename P> requires MapLike<P>
-    [[nodiscard]] inline bool readData(const span<const u8> data, typename P::template map<string, Tag<P>>& result) noexcept {
+    [[nodiscard]] inline bool readData(const span<const u8> data, typename P::template map<string, Tag<P>>& result, const ReadLimits& limits = ReadLimits()) noexcept {
         SpanIn adapter(data);
-        return readStream<P>(adapter, result);
+        return readStream<P>(adapter, result, nullptr, limits);
     }
 
     template<Readable S>
@@ -99,144 +136,444 @@ namespace NBT::IO {
         };
     }
 
-    template<Readable S, typename P> requires MapLike<P>
-    [[nodiscard]] inline bool readObject(FileReader<S>& cursor, TagObject<P>& result, bool topLevel) noexcept {
-        auto type = getType(*cursor);
-        while (topLevel ? !!cursor : type != Types::ObjectEnd) {
-            switch (type) {
-                case Types::Object: {
-                    ++cursor;
-                    TagObject<P> temp;
-                    string name = readVarText(cursor);
-                    if (readObject(cursor, temp)) result.payload.emplace(name, move(temp));
-                    else return false;
-                    break;
+    //Top-level keys may repeat in files grown with `appendFile`; the last occurrence wins. In nested objects the first one does.
+    //`try_emplace` looks the key up once and neither builds a node nor moves from `name` and `value` when it is taken.
+    template <typename M, typename T>
+    inline void storeMember(M& members, string& name, T&& value, bool replace) noexcept {
+        if constexpr (requires { members.try_emplace(move(name), std::forward<T>(value)); }) {
+            const auto [it, inserted] = members.try_emplace(move(name), std::forward<T>(value));
+            if (!inserted && replace) it->second = std::forward<T>(value);
+        }
+        else {
+            if (replace) {
+                const auto it = members.find(name);
+                if (it != members.end()) {
+                    it->second = std::forward<T>(value);
+                    return;
                 }
+            }
+            members.emplace(move(name), std::forward<T>(value));
+        }
+    }
+
+    namespace detail {
+        template<Readable S>
+        inline void truncated(const FileReader<S>& cursor) noexcept { pushError({.code = Code::EndOfInput, .offset = cursor.currentOffset()}); }
+
+        //Bytes the parse may still read: what is left of the input if that is known, and of `limits.bytes` in any case.
+        template<Readable S>
+        [[nodiscard]] inline u64 room(const FileReader<S>& cursor, const ReadLimits& limits) noexcept {
+            const u64 consumed = cursor.currentOffset(), budget = consumed < limits.bytes ? limits.bytes - consumed : 0;
+            const i64 remaining = cursor.remaining();
+            return remaining >= 0 && static_cast<u64>(remaining) < budget ? static_cast<u64>(remaining) : budget;
+        }
+
+        //`count` items announced by the input, each taking at least `width` bytes of it.
+        template<Readable S>
+        [[nodiscard]] inline bool fits(const FileReader<S>& cursor, u64 count, u64 width, const ReadLimits& limits) noexcept {
+            const u64 fitting = room(cursor, limits) / width;
+            if (count <= fitting) return true;
+            pushError({.code = Code::CountTooLarge, .offset = cursor.currentOffset(), .count = count, .limit = fitting});
+            return false;
+        }
+
+        template<Readable S>
+        [[nodiscard]] inline bool admitArray(const FileReader<S>& cursor, u64 count, u64 width, const ReadLimits& limits) noexcept {
+            if (count <= limits.arrayLength) return fits(cursor, count, width, limits);
+            pushError({.code = Code::ArrayTooLong, .offset = cursor.currentOffset(), .count = count, .limit = limits.arrayLength});
+            return false;
+        }
+
+        template<Readable S>
+        [[nodiscard]] inline bool admitTags(const FileReader<S>& cursor, u64& tags, u64 added, const ReadLimits& limits) noexcept {
+            tags = added > UINT64_MAX - tags ? UINT64_MAX : tags + added;
+            if (tags <= limits.tags) return true;
+            pushError({.code = Code::TooManyTags, .offset = cursor.currentOffset(), .count = tags, .limit = limits.tags});
+            return false;
+        }
+
+        template<Readable S>
+        [[nodiscard]] inline bool withinBytes(const FileReader<S>& cursor, const ReadLimits& limits) noexcept {
+            if (cursor.currentOffset() <= limits.bytes) return true;
+            pushError({.code = Code::InputTooLong, .offset = cursor.currentOffset(), .limit = limits.bytes});
+            return false;
+        }
+
+        //How many of `count` items of `size` bytes to allocate before any of them has arrived: as many as the rest of a known
+        //input could fill byte for byte, a first `UNSIZED_GROWTH` otherwise. Items decoded to more bytes than they are stored in,
+        //like the tags of a generic array, grow the rest of the way as they arrive.
+        template<Readable S>
+        [[nodiscard]] inline u64 upfront(const FileReader<S>& cursor, u64 count, u64 size) noexcept {
+            const i64 remaining = cursor.remaining();
+            return std::min(count, std::max<u64>((remaining >= 0 ? static_cast<u64>(remaining) : UNSIZED_GROWTH) / size, 1));
+        }
+
+        [[nodiscard]] inline u64 grown(u64 size, u64 count) noexcept { return std::min(count, std::max<u64>(size * 2, 1)); }
+
+        //Reads `count` items straight into `result`'s storage, growing it as the bytes arrive. `count` has been admitted.
+        template<Readable S, typename C>
+        [[nodiscard]] inline bool readBulk(FileReader<S>& cursor, C& result, u64 count) noexcept {
+            constexpr u64 size = sizeof(typename C::value_type);
+            result.resize(upfront(cursor, count, size));
+            u64 done = 0;
+            while (true) {
+                const u64 bytes = (result.size() - done) * size;
+                if (cursor.getContent(reinterpret_cast<u8*>(result.data() + done), bytes) < bytes) { truncated(cursor); return false; }
+                done = result.size();
+                if (done == count) return true;
+                result.resize(grown(done, count));
+            }
+        }
+
+        //One open object or array of the iterative reader. `value` is built in its frame and moved into the parent once
+        //complete, so a failed parse never leaves half a container in the result.
+        template <typename P> requires MapLike<P>
+        struct ReadFrame {
+            Tag<P> value;
+            //Where `value` goes in its parent object; unused below arrays.
+            string key;
+            //Arrays: the elements' second type, that of the elements' elements when these are arrays too, the next element and
+            //how many were announced. The payload may not have room for all of them yet.
+            Types second{Types::Count}, nested{Types::Count};
+            u64 index{0}, count{0};
+            //Top-level objects run to the end of the input instead of an `ObjectEnd`, and let repeated keys replace each other.
+            bool topLevel{false};
+        };
+
+        //Kept per thread, so nesting costs no allocations once it has been warmed up.
+        template <typename P> requires MapLike<P>
+        [[nodiscard]] inline vector<ReadFrame<P>>& readStack() noexcept {
+            static thread_local vector<ReadFrame<P>> result;
+            return result;
+        }
+
+        template<Readable S>
+        [[nodiscard]] inline bool deeper(FileReader<S>& cursor, u64 depth, const ReadLimits& limits) noexcept {
+            if (depth < limits.depth) return true;
+            pushError({.code = Code::TooDeep, .offset = cursor.currentOffset(), .count = depth + 1, .limit = limits.depth});
+            return false;
+        }
+
+        //Element `index` of an array frame, making room for it first if the payload hasn't got that far yet.
+        template <typename P> requires MapLike<P>
+        [[nodiscard]] inline Tag<P>& slot(ReadFrame<P>& frame) noexcept {
+            auto& elements = frame.value.tagArray.payload;
+            if (frame.index == elements.size()) elements.resize(grown(elements.size(), frame.count));
+            return elements[frame.index];
+        }
+
+        //The value of a member that is neither an object nor an array, after its key.
+        template<Readable S, typename M>
+        [[nodiscard]] inline bool readLeafValue(FileReader<S>& cursor, u8 head, Types type, string& name, M& members, bool topLevel, const ReadLimits& limits) noexcept {
+            switch (type) {
                 case Types::IVarInt: {
-                    ++cursor;
                     TagIVarInt temp;
-                    string name = readVarText(cursor);
                     readIVarInt(cursor, temp);
-                    result.payload.emplace(name, move(temp));
-                    break;
+                    storeMember(members, name, move(temp), topLevel);
+                    return true;
                 }
                 case Types::UVarInt: {
-                    ++cursor;
                     TagUVarInt temp;
-                    string name = readVarText(cursor);
                     readUVarInt(cursor, temp);
-                    result.payload.emplace(name, move(temp));
-                    break;
+                    storeMember(members, name, move(temp), topLevel);
+                    return true;
                 }
                 case Types::Bool: {
-                    auto cv = *cursor;
-                    ++cursor;
                     TagBool temp;
-                    string name = readVarText(cursor);
-                    readBool(cursor, temp, cv);
-                    result.payload.emplace(name, move(temp));
-                    break;
+                    readBool(cursor, temp, head);
+                    storeMember(members, name, move(temp), topLevel);
+                    return true;
                 }
                 case Types::Hex: {
-                    auto cv = *cursor;
-                    ++cursor;
                     TagHex temp;
-                    string name = readVarText(cursor);
-                    readHex(cursor, temp, cv);
-                    result.payload.emplace(name, move(temp));
-                    break;
+                    readHex(cursor, temp, head);
+                    storeMember(members, name, move(temp), topLevel);
+                    return true;
                 }
                 case Types::Float: {
-                    ++cursor;
                     TagFloat temp;
-                    string name = readVarText(cursor);
                     readFloat(cursor, temp);
-                    result.payload.emplace(name, move(temp));
-                    break;
+                    storeMember(members, name, move(temp), topLevel);
+                    return true;
                 }
                 case Types::Double: {
-                    ++cursor;
                     TagDouble temp;
-                    string name = readVarText(cursor);
                     readDouble(cursor, temp);
-                    result.payload.emplace(name, move(temp));
-                    break;
-                }
-                case Types::Array: {
-                    auto secType = getSecondType(*cursor);
-                    ++cursor;
-                    TagArray<P> temp;
-                    string name = readVarText(cursor);
-                    if (readArray(cursor, temp, secType)) result.payload.emplace(name, move(temp));
-                    else return false;
-                    break;
+                    storeMember(members, name, move(temp), topLevel);
+                    return true;
                 }
                 case Types::String: {
-                    ++cursor;
                     TagString temp;
-                    string name = readVarText(cursor);
-                    if (readString(cursor, temp)) result.payload.emplace(name, move(temp));
-                    else return false;
-                    break;
+                    if (!readString(cursor, temp, limits)) return false;
+                    storeMember(members, name, move(temp), topLevel);
+                    return true;
                 }
                 case Types::Raw: {
-                    ++cursor;
                     TagRaw temp;
-                    string name = readVarText(cursor);
                     readRaw(cursor, temp);
-                    result.payload.emplace(name, move(temp));
-                    break;
+                    storeMember(members, name, move(temp), topLevel);
+                    return true;
                 }
                 case Types::ArrayBool: {
-                    ++cursor;
                     TagArrayBool temp;
-                    string name = readVarText(cursor);
-                    if (readArrayBool(cursor, temp)) result.payload.emplace(name, move(temp));
-                    else return false;
-                    break;
+                    if (!readArrayBool(cursor, temp, limits)) return false;
+                    storeMember(members, name, move(temp), topLevel);
+                    return true;
                 }
                 case Types::ArrayHex: {
-                    ++cursor;
                     TagArrayHex temp;
-                    string name = readVarText(cursor);
-                    if (readArrayHex(cursor, temp)) result.payload.emplace(name, move(temp));
-                    else return false;
-                    break;
+                    if (!readArrayHex(cursor, temp, limits)) return false;
+                    storeMember(members, name, move(temp), topLevel);
+                    return true;
                 }
                 case Types::ArrayFloat: {
-                    ++cursor;
                     TagArrayFloat temp;
-                    string name = readVarText(cursor);
-                    if (readArrayFloat(cursor, temp)) result.payload.emplace(name, move(temp));
-                    else return false;
-                    break;
+                    if (!readArrayFloat(cursor, temp, limits)) return false;
+                    storeMember(members, name, move(temp), topLevel);
+                    return true;
                 }
                 case Types::ArrayDouble: {
-                    ++cursor;
                     TagArrayDouble temp;
-                    string name = readVarText(cursor);
-                    if (readArrayDouble(cursor, temp)) result.payload.emplace(name, move(temp));
-                    else return false;
-                    break;
+                    if (!readArrayDouble(cursor, temp, limits)) return false;
+                    storeMember(members, name, move(temp), topLevel);
+                    return true;
                 }
-                case Types::ArrayRaw: {
-                    ++cursor;
+                default: {
                     TagArrayRaw temp;
-                    string name = readVarText(cursor);
-                    if (readArrayRaw(cursor, temp)) result.payload.emplace(name, move(temp));
-                    else return false;
-                    break;
+                    if (!readArrayRaw(cursor, temp, limits)) return false;
+                    storeMember(members, name, move(temp), topLevel);
+                    return true;
+                }
+            }
+        }
+
+        //A member that is neither an object nor an array; `head` hasn't been consumed yet.
+        template<Readable S, typename M>
+        [[nodiscard]] inline bool readLeafMember(FileReader<S>& cursor, u8 head, M& members, bool topLevel, const ReadLimits& limits) noexcept {
+            const Types type = getType(head);
+            if (type == Types::ObjectEnd) {
+                pushError({.code = Code::InvalidType, .type = static_cast<u8>(type), .offset = cursor.currentOffset()});
+                return false;
+            }
+            ++cursor;
+            string name = readVarText(cursor);
+            const bool success = readLeafValue(cursor, head, type, name, members, topLevel, limits);
+            if (!success) enclose(name);
+            return success;
+        }
+
+        //Reads and admits the count and checks the second types; the head has been consumed.
+        template<Readable S, typename P> requires MapLike<P>
+        [[nodiscard]] inline bool openArray(FileReader<S>& cursor, ReadFrame<P>& frame, const Types second, const ReadLimits& limits, u64& tags) noexcept {
+            const auto count = readUVarInt(cursor);
+            //Every element takes a byte at least.
+            if (!admitArray(cursor, count, 1, limits) || !admitTags(cursor, tags, count, limits)) return false;
+            frame.value.tagArray.payload.resize(upfront(cursor, count, sizeof(Tag<P>)));
+            frame.count = count;
+            frame.second = second;
+            switch (second) {
+                case Types::Object:
+                case Types::IVarInt:
+                case Types::UVarInt:
+                case Types::String:  return true;
+                case Types::Array:   break;
+                default: {
+                    pushError({.code = Code::InvalidSecondType, .type = static_cast<u8>(second), .offset = cursor.currentOffset() - 1});
+                    return false;
                 }
+            }
+            //Every nested array repeats its head byte; the first one decides for all of them.
+            if (count == 0) return true;
+            frame.nested = getSecondType(*cursor);
+            switch (frame.nested) {
+                case Types::Object:
+                case Types::IVarInt:
+                case Types::UVarInt:
+                case Types::Array:
+                case Types::String:
+                case Types::Bool:
+                case Types::Hex:
+                case Types::Float:
+                case Types::Double:
+                case Types::Raw:     return true;
                 default: {
-                    pushError(format("Invalid type ID {} in object at pos {}!", static_cast<u8>(type), cursor.currentOffset()));
+                    pushError({.code = Code::InvalidSecondType, .type = static_cast<u8>(frame.nested), .offset = cursor.currentOffset() - 1});
                     return false;
                 }
             }
-            if (!cursor) break;
-            type = getType(*cursor);
         }
-        if (!topLevel) ++cursor;
-        return true;
+
+        //Prefixes the last error's path with the members and elements open above `base`, innermost first.
+        template <typename P> requires MapLike<P>
+        inline void locate(const vector<ReadFrame<P>>& stack, u64 base) noexcept {
+            const auto& top = stack.back();
+            if (top.value.type == Types::Array && top.index < top.count) enclose(top.index);
+            for (u64 i = stack.size() - 1; i > base; i--) {
+                const auto& parent = stack[i - 1];
+                if (parent.value.type == Types::Object) enclose(stack[i].key);
+                else enclose(parent.index);
+            }
+        }
+
+        //Reads into the frames above `base` until the bottom one is complete, which is left on the stack for the caller.
+        //Objects and arrays met on the way get a frame of their own instead of a recursive call, so the depth of the
+        //document only costs heap, and is bounded by `limits.depth`.
+        template<Readable S, typename P> requires MapLike<P>
+        [[nodiscard]] inline bool read(FileReader<S>& cursor, vector<ReadFrame<P>>& stack, u64 base, const ReadLimits& limits, u64& tags) noexcept {
+            while (true) {
+                auto& top = stack.back();
+                const u64 depth = stack.size() - base;
+                if (cursor.overrun() || (!cursor && top.value.type == Types::Object && !top.topLevel)) {
+                    truncated(cursor);
+                    return false;
+                }
+                if (!withinBytes(cursor, limits)) return false;
+                if (top.value.type == Types::Object) {
+                    if (!cursor || (!top.topLevel && getType(*cursor) == Types::ObjectEnd)) {
+                        if (!top.topLevel) ++cursor;
+                    }
+                    else {
+                        const u8 head = *cursor;
+                        const Types type = getType(head);
+                        if (!admitTags(cursor, tags, 1, limits)) return false;
+                        if (type != Types::Object && type != Types::Array) {
+                            if (!readLeafMember(cursor, head, top.value.tagObject.payload, top.topLevel, limits)) return false;
+                            continue;
+                        }
+                        if (!deeper(cursor, depth, limits)) return false;
+                        ++cursor;
+                        string name = readVarText(cursor);
+                        if (type == Types::Object) stack.push_back({TagObject<P>(), move(name)});
+                        else {
+                            stack.push_back({TagArray<P>(), move(name)});
+                            if (!openArray(cursor, stack.back(), getSecondType(head), limits, tags)) return false;
+                        }
+                        continue;
+                    }
+                }
+                else if (top.index < top.count) {
+                    switch (top.second) {
+                        case Types::Object: {
+                            if (!deeper(cursor, depth, limits)) return false;
+                            stack.push_back({TagObject<P>()});
+                            continue;
+                        }
+                        case Types::IVarInt: {
+                            for (; top.index < top.count && !cursor.overrun(); top.index++) {
+                                auto& element = slot(top);
+                                new (&element.tagIVarInt) TagIVarInt;
+                                element.type = Types::IVarInt;
+                                readIVarInt(cursor, element.tagIVarInt);
+                            }
+                            continue;
+                        }
+                        case Types::UVarInt: {
+                            for (; top.index < top.count && !cursor.overrun(); top.index++) {
+                                auto& element = slot(top);
+                                new (&element.tagUVarInt) TagUVarInt;
+                                element.type = Types::UVarInt;
+                                readUVarInt(cursor, element.tagUVarInt);
+                            }
+                            continue;
+                        }
+                        case Types::String: {
+                            for (; top.index < top.count && !cursor.overrun(); top.index++) {
+                                auto& element = slot(top);
+                                new (&element.tagString) TagString;
+                                element.type = Types::String;
+                                if (!readString(cursor, element.tagString, limits)) return false;
+                            }
+                            continue;
+                        }
+                        default: break;
+                    }
+                    //Arrays of arrays.
+                    switch (top.nested) {
+                        case Types::Bool: {
+                            for (; top.index < top.count && !cursor.overrun(); top.index++) {
+                                auto& element = slot(top);
+                                new (&element.tagArrayBool) TagArrayBool;
+                                element.type = Types::ArrayBool;
+                                ++cursor;
+                                if (!readArrayBool(cursor, element.tagArrayBool, limits)) return false;
+                            }
+                            continue;
+                        }
+                        case Types::Hex: {
+                            for (; top.index < top.count && !cursor.overrun(); top.index++) {
+                                auto& element = slot(top);
+                                new (&element.tagArrayHex) TagArrayHex;
+                                element.type = Types::ArrayHex;
+                                ++cursor;
+                                if (!readArrayHex(cursor, element.tagArrayHex, limits)) return false;
+                            }
+                            continue;
+                        }
+                        case Types::Float: {
+                            for (; top.index < top.count && !cursor.overrun(); top.index++) {
+                                auto& element = slot(top);
+                                new (&element.tagArrayFloat) TagArrayFloat;
+                                element.type = Types::ArrayFloat;
+                                ++cursor;
+                                if (!readArrayFloat(cursor, element.tagArrayFloat, limits)) return false;
+                            }
+                            continue;
+                        }
+                        case Types::Double: {
+                            for (; top.index < top.count && !cursor.overrun(); top.index++) {
+                                auto& element = slot(top);
+                                new (&element.tagArrayDouble) TagArrayDouble;
+                                element.type = Types::ArrayDouble;
+                                ++cursor;
+                                if (!readArrayDouble(cursor, element.tagArrayDouble, limits)) return false;
+                            }
+                            continue;
+                        }
+                        case Types::Raw: {
+                            for (; top.index < top.count && !cursor.overrun(); top.index++) {
+                                auto& element = slot(top);
+                                new (&element.tagArrayRaw) TagArrayRaw;
+                                element.type = Types::ArrayRaw;
+                                ++cursor;
+                                if (!readArrayRaw(cursor, element.tagArrayRaw, limits)) return false;
+                            }
+                            continue;
+                        }
+                        default: {
+                            if (!deeper(cursor, depth, limits)) return false;
+                            const Types nested = top.nested;
+                            ++cursor;
+                            stack.push_back({TagArray<P>()});
+                            if (!openArray(cursor, stack.back(), nested, limits, tags)) return false;
+                            continue;
+                        }
+                    }
+                }
+                //`top` is complete.
+                if (stack.size() == base + 1) return true;
+                auto& parent = stack[stack.size() - 2];
+                if (parent.value.type == Types::Object) storeMember(parent.value.tagObject.payload, top.key, move(top.value), parent.topLevel);
+                else {
+                    slot(parent) = move(top.value);
+                    parent.index++;
+                }
+                stack.pop_back();
+            }
+        }
+    }
+
+    template<Readable S, typename P> requires MapLike<P>
+    [[nodiscard]] inline bool readObject(FileReader<S>& cursor, TagObject<P>& result, bool topLevel, const ReadLimits& limits) noexcept {
+        auto& stack = detail::readStack<P>();
+        const u64 base = stack.size();
+        stack.push_back({move(result)});
+        stack.back().topLevel = topLevel;
+        u64 tags = 0;
+        const bool success = detail::read(cursor, stack, base, limits, tags);
+        if (success) result = move(stack[base].value.tagObject);
+        else detail::locate(stack, base);
+        stack.resize(base);
+        return success;
     }
 
     template<Readable S> inline void readIVarInt(FileReader<S>& cursor, TagIVarInt& result) noexcept { result.payload = readIVarInt(cursor); }
@@ -270,172 +607,206 @@ namespace NBT::IO {
     }
 
     template<Readable S, typename P> requires MapLike<P>
-    [[nodiscard]] inline bool readArray(FileReader<S>& cursor, TagArray<P>& result, const Types type) noexcept {
-        auto count = readUVarInt(cursor);
-        result.payload.resize(count);
-        switch (type) {
-            case Types::Object: {
-                for (u64 i = 0; i < count; i++) {
-                    new (&result.payload[i].tagObject) TagObject<P>;
-                    result.payload[i].type = Types::Object;
-                    if (!readObject(cursor, result.payload[i].tagObject)) return false;
-                }
-                break;
-            }
-            case Types::IVarInt: {
-                for (u64 i = 0; i < count; i++) {
-                    new (&result.payload[i].tagIVarInt) TagIVarInt;
-                    result.payload[i].type = Types::IVarInt;
-                    readIVarInt(cursor, result.payload[i].tagIVarInt);
-                }
-                break;
-            }
-            case Types::UVarInt: {
-                for (u64 i = 0; i < count; i++) {
-                    new (&result.payload[i].tagUVarInt) TagUVarInt;
-                    result.payload[i].type = Types::UVarInt;
-                    readUVarInt(cursor, result.payload[i].tagUVarInt);
-                }
-                break;
-            }
-            case Types::Array: {
-                auto type = getSecondType(*cursor);
-                switch (type) {
-                    case Types::Object:
-                    case Types::IVarInt:
-                    case Types::UVarInt:
-                    case Types::Array:
-                    case Types::String: {
-                        for (u64 i = 0; i < count; i++) {
-                            new (&result.payload[i].tagArray) TagArray<P>;
-                            result.payload[i].type = Types::Array;
-                            ++cursor;
-                            if (!readArray(cursor, result.payload[i].tagArray, type)) return false;
-                        }
-                        break;
-                    }
-                    case Types::Bool: {
-                        for(u64 i = 0; i < count; i++) {
-                            new (&result.payload[i].tagArrayBool) TagArrayBool;
-                            result.payload[i].type = Types::ArrayBool;
-                            ++cursor;
-                            if (!readArrayBool(cursor, result.payload[i].tagArrayBool)) return false;
-                        }
-                        break;
-                    }
-                    case Types::Hex: {
-                        for (u64 i = 0; i < count; i++) {
-                            new (&result.payload[i].tagArrayHex) TagArrayHex;
-                            result.payload[i].type = Types::ArrayHex;
-                            ++cursor;
-                            if (!readArrayHex(cursor, result.payload[i].tagArrayHex)) return false;
-                        }
-                        break;
-                    }
-                    case Types::Float: {
-                        for (u64 i = 0; i < count; i++) {
-                            new (&result.payload[i].tagArrayFloat) TagArrayFloat;
-                            result.payload[i].type = Types::ArrayFloat;
-                            ++cursor;
-                            if (!readArrayFloat(cursor, result.payload[i].tagArrayFloat)) return false;
-                        }
-                        break;
-                    }
-                    case Types::Double: {
-                        for (u64 i = 0; i < count; i++) {
-                            new (&result.payload[i].tagArrayDouble) TagArrayDouble;
-                            result.payload[i].type = Types::ArrayDouble;
-                            ++cursor;
-                            if (!readArrayDouble(cursor, result.payload[i].tagArrayDouble)) return false;
-                        }
-                        break;
-                    }
-                    case Types::Raw: {
-                        for (u64 i = 0; i < count; i++) {
-                            new (&result.payload[i].tagArrayRaw) TagArrayRaw;
-                            result.payload[i].type = Types::ArrayRaw;
-                            ++cursor;
-                            if (!readArrayRaw(cursor, result.payload[i].tagArrayRaw)) return false;
-                        }
-                        break;
-                    }
-                    default: {
-                        pushError(format("Invalid second type {} at pos {}!", static_cast<u8>(type), cursor.currentOffset() - 1));
-                        return false;
-                    }
-                }
-                break;
-            }
-            case Types::String: {
-                for (u64 i = 0; i < count; i++) {
-                    new (&result.payload[i].tagString) TagString;
-                    result.payload[i].type = Types::String;
-                    if (!readString(cursor, result.payload[i].tagString)) return false;
-                }
-                break;
-            }
-            default: {
-                pushError(format("Invalid second type {} at pos {}!", static_cast<u8>(type), cursor.currentOffset() - 1));
-                return false;
-            }
-        }
-        return true;
+    [[nodiscard]] inline bool readArray(FileReader<S>& cursor, TagArray<P>& result, const Types type, const ReadLimits& limits) noexcept {
+        auto& stack = detail::readStack<P>();
+        const u64 base = stack.size();
+        stack.push_back({move(result)});
+        u64 tags = 0;
+        const bool success = detail::openArray(cursor, stack.back(), type, limits, tags) && detail::read(cursor, stack, base, limits, tags);
+        if (success) result = move(stack[base].value.tagArray);
+        else detail::locate(stack, base);
+        stack.resize(base);
+        return success;
     }
 
-    inline constexpr const char* EOF_ERROR = "Failed to read data, EOF reached!";
-
     template<Readable S>
-    [[nodiscard]] inline bool readString(FileReader<S>& cursor, TagString& result) noexcept {
-        auto byteLength = readUVarInt(cursor);
-        vector<u8> temp(byteLength);
-        u64 actualByteLength = cursor.getContent(reinterpret_cast<u8*>(temp.data()), byteLength);
-        if (actualByteLength < byteLength) { pushError(EOF_ERROR); return false; }
-        result.payload = string(temp.begin(), temp.end());
-        return true;
+    [[nodiscard]] inline bool readString(FileReader<S>& cursor, TagString& result, const ReadLimits& limits) noexcept {
+        const auto byteLength = readUVarInt(cursor);
+        //Straight into the payload, reusing its capacity when `result` is parsed into again.
+        return detail::fits(cursor, byteLength, 1, limits) && detail::readBulk(cursor, result.payload, byteLength);
     }
 
     template<Readable S>
     inline void readRaw(FileReader<S>& cursor, TagRaw& result) noexcept { result.payload = *cursor; ++cursor; }
 
     template<Readable S>
-    [[nodiscard]] inline bool readArrayBool(FileReader<S>& cursor, TagArrayBool& result) noexcept {
-        auto count = readUVarInt(cursor);
-        result.payload.resize(count);
-        if (cursor.getContent(result.payload.data(), count) < count) { pushError(EOF_ERROR); return false; }
+    [[nodiscard]] inline bool readArrayBool(FileReader<S>& cursor, TagArrayBool& result, const ReadLimits& limits) noexcept {
+        const auto count = readUVarInt(cursor);
+        if (!detail::admitArray(cursor, count, 1, limits) || !detail::readBulk(cursor, result.payload, count)) return false;
         for (u64 i = 0; i < count; i++) result.payload[i] &= 0x01;
         return true;
     }
 
     template<Readable S>
-    [[nodiscard]] inline bool readArrayHex(FileReader<S>& cursor, TagArrayHex& result) noexcept {
-        auto count = readUVarInt(cursor);
-        result.payload.resize(count);
-        if (cursor.getContent(result.payload.data(), count) < count) { pushError(EOF_ERROR); return false; }
+    [[nodiscard]] inline bool readArrayHex(FileReader<S>& cursor, TagArrayHex& result, const ReadLimits& limits) noexcept {
+        const auto count = readUVarInt(cursor);
+        if (!detail::admitArray(cursor, count, 1, limits) || !detail::readBulk(cursor, result.payload, count)) return false;
         for (u64 i = 0; i < count; i++) result.payload[i] &= 0x0F;
         return true;
     }
 
     template<Readable S>
-    [[nodiscard]] inline bool readArrayFloat(FileReader<S>& cursor, TagArrayFloat& result) noexcept {
-        auto count = readUVarInt(cursor);
-        result.payload.resize(count);
-        if (cursor.getContent(reinterpret_cast<u8*>(result.payload.data()), count * 4) < count * 4) { pushError(EOF_ERROR); return false; }
-        return true;
+    [[nodiscard]] inline bool readArrayFloat(FileReader<S>& cursor, TagArrayFloat& result, const ReadLimits& limits) noexcept {
+        const auto count = readUVarInt(cursor);
+        return detail::admitArray(cursor, count, sizeof(float), limits) && detail::readBulk(cursor, result.payload, count);
     }
 
     template<Readable S>
-    [[nodiscard]] inline bool readArrayDouble(FileReader<S>& cursor, TagArrayDouble& result) noexcept {
-        auto count = readUVarInt(cursor);
-        result.payload.resize(count);
-        if (cursor.getContent(reinterpret_cast<u8*>(result.payload.data()), count * 8) < count * 8) { pushError(EOF_ERROR); return false; }
-        return true;
+    [[nodiscard]] inline bool readArrayDouble(FileReader<S>& cursor, TagArrayDouble& result, const ReadLimits& limits) noexcept {
+        const auto count = readUVarInt(cursor);
+        return detail::admitArray(cursor, count, sizeof(double), limits) && detail::readBulk(cursor, result.payload, count);
+    }
+
+    template<Readable S>
+    [[nodiscard]] inline bool readArrayRaw(FileReader<S>& cursor, TagArrayRaw& result, const ReadLimits& limits) noexcept {
+        const auto count = readUVarInt(cursor);
+        return detail::admitArray(cursor, count, 1, limits) && detail::readBulk(cursor, result.payload, count);
     }
 
+    //Skipping: same grammar as the readers above, nothing is stored. Used wherever only some members of a document are wanted.
     template<Readable S>
-    [[nodiscard]] inline bool readArrayRaw(FileReader<S>& cursor, TagArrayRaw& result) noexcept {
-        auto count = readUVarInt(cursor);
-        result.payload.resize(count);
-        if (cursor.getContent(result.payload.data(), count) < count) { pushError(EOF_ERROR); return false; }
+    [[nodiscard]] inline bool skipBytes(FileReader<S>& cursor, u64 length) noexcept {
+        if (cursor.skip(length) < length) { detail::truncated(cursor); return false; }
         return true;
     }
+
+    namespace detail {
+        //An object or array being skipped: `remaining` counts the elements left in arrays, objects run to their `ObjectEnd`.
+        struct SkipFrame {
+            u64 remaining{0};
+            //`ObjectEnd` for objects.
+            Types second{Types::ObjectEnd};
+        };
+
+        [[nodiscard]] inline vector<SkipFrame>& skipStack() noexcept {
+            static thread_local vector<SkipFrame> result;
+            return result;
+        }
+
+        //Anything but objects and generic arrays; `head` has been consumed.
+        template<Readable S>
+        [[nodiscard]] inline bool skipLeaf(FileReader<S>& cursor, u8 head) noexcept {
+            switch (getType(head)) {
+                case Types::IVarInt:
+                case Types::UVarInt:     (void)readUVarInt(cursor); return true;
+                case Types::Bool:
+                case Types::Hex:         return true;
+                case Types::Float:       return skipBytes(cursor, sizeof(float));
+                case Types::Double:      return skipBytes(cursor, sizeof(double));
+                case Types::Raw:         return skipBytes(cursor, 1);
+                case Types::String:
+                case Types::ArrayBool:
+                case Types::ArrayHex:
+                case Types::ArrayRaw:    return skipBytes(cursor, readUVarInt(cursor));
+                case Types::ArrayFloat: {
+                    const auto count = readUVarInt(cursor);
+                    if (count > UINT64_MAX / sizeof(float)) { detail::truncated(cursor); return false; }
+                    return skipBytes(cursor, count * sizeof(float));
+                }
+                case Types::ArrayDouble: {
+                    const auto count = readUVarInt(cursor);
+                    if (count > UINT64_MAX / sizeof(double)) { detail::truncated(cursor); return false; }
+                    return skipBytes(cursor, count * sizeof(double));
+                }
+                default: {
+                    pushError({.code = Code::InvalidType, .type = static_cast<u8>(getType(head)), .offset = cursor.currentOffset()});
+                    return false;
+                }
+            }
+        }
+
+        //Opens a frame for the object or generic array `head` starts, or skips any other value whole.
+        template<Readable S>
+        [[nodiscard]] inline bool skipOpen(FileReader<S>& cursor, u8 head, vector<SkipFrame>& stack) noexcept {
+            const Types type = getType(head);
+            if (type == Types::Object) stack.push_back({});
+            else if (type == Types::Array) stack.push_back({readUVarInt(cursor), getSecondType(head)});
+            else return skipLeaf(cursor, head);
+            return true;
+        }
+
+        //Skips until the frames above `base` are closed. Every frame has consumed at least one byte, so the stack can't
+        //outgrow the input.
+        template<Readable S>
+        [[nodiscard]] inline bool skip(FileReader<S>& cursor, vector<SkipFrame>& stack, u64 base) noexcept {
+            bool success = true;
+            while (success && stack.size() > base) {
+                auto& top = stack.back();
+                if (top.second != Types::ObjectEnd && top.remaining == 0) stack.pop_back();
+                else if (!cursor) {
+                    truncated(cursor);
+                    success = false;
+                }
+                else if (top.second == Types::ObjectEnd) {
+                    const u8 head = *cursor;
+                    ++cursor;
+                    if (getType(head) == Types::ObjectEnd) stack.pop_back();
+                    else {
+                        skipVarText(cursor);
+                        success = skipOpen(cursor, head, stack);
+                    }
+                }
+                else {
+                    top.remaining--;
+                    switch (top.second) {
+                        case Types::Object:  stack.push_back({}); break;
+                        case Types::IVarInt:
+                        case Types::UVarInt: (void)readUVarInt(cursor); break;
+                        case Types::String:  success = skipBytes(cursor, readUVarInt(cursor)); break;
+                        //Nested arrays carry their own head byte.
+                        case Types::Array: {
+                            const u8 head = *cursor;
+                            ++cursor;
+                            success = skipOpen(cursor, head, stack);
+                            break;
+                        }
+                        default: {
+                            pushError({.code = Code::InvalidSecondType, .type = static_cast<u8>(top.second), .offset = cursor.currentOffset() - 1});
+                            success = false;
+                        }
+                    }
+                }
+            }
+            if (success && cursor.overrun()) {
+                truncated(cursor);
+                success = false;
+            }
+            stack.resize(base);
+            return success;
+        }
+    }
+
+    //`head` is the already consumed head byte; for members, the key has been consumed as well.
+    template<Readable S>
+    [[nodiscard]] inline bool skipValue(FileReader<S>& cursor, u8 head) noexcept {
+        auto& stack = detail::skipStack();
+        const u64 base = stack.size();
+        return detail::skipOpen(cursor, head, stack) && detail::skip(cursor, stack, base);
+    }
+
+    //Consumes everything up to and including the matching `ObjectEnd`.
+    template<Readable S>
+    [[nodiscard]] inline bool skipObject(FileReader<S>& cursor) noexcept {
+        auto& stack = detail::skipStack();
+        const u64 base = stack.size();
+        stack.push_back({});
+        return detail::skip(cursor, stack, base);
+    }
+
+    //One element of a generic array whose second type is `type`.
+    template<Readable S>
+    [[nodiscard]] inline bool skipElement(FileReader<S>& cursor, const Types type) noexcept {
+        auto& stack = detail::skipStack();
+        const u64 base = stack.size();
+        stack.push_back({1, type});
+        return detail::skip(cursor, stack, base);
+    }
+
+    template<Readable S>
+    [[nodiscard]] inline bool skipArray(FileReader<S>& cursor, const Types type) noexcept {
+        auto& stack = detail::skipStack();
+        const u64 base = stack.size();
+        stack.push_back({readUVarInt(cursor), type});
+        return detail::skip(cursor, stack, base);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,314 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <concepts>
+#include <istream>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "adapters.hpp"
+#include "auxiliary.hpp"
+#include "error.hpp"
+#include "FileReader.hpp"
+#include "read.hpp"
+#include "types.hpp"
+#include "utils.hpp"
+#include "write.hpp"
+
+//Describes the members of a plain struct so that `NBT::Reflect` can read and write it without going through `Tag`.
+//Use it in the struct's own namespace, after the struct: `CGNBT_FIELDS(Player, name, pos, hp)`. Keys are the member names.
+#define CGNBT_FIELDS(Type, ...) \
+    [[maybe_unused]] inline constexpr auto cgnbtFields(const Type*) noexcept { return std::tuple{CGNBT_FOR_EACH_(CGNBT_FIELD_, Type, __VA_ARGS__)}; }
+
+#define CGNBT_FIELD_(Type, member) NBT::Reflect::Field<&Type::member>{#member, NBT::Utils::hashKey(#member)}
+#define CGNBT_PARENS_ ()
+#define CGNBT_EXPAND_(...)  CGNBT_EXPAND3_(CGNBT_EXPAND3_(CGNBT_EXPAND3_(CGNBT_EXPAND3_(__VA_ARGS__))))
+#define CGNBT_EXPAND3_(...) CGNBT_EXPAND2_(CGNBT_EXPAND2_(CGNBT_EXPAND2_(CGNBT_EXPAND2_(__VA_ARGS__))))
+#define CGNBT_EXPAND2_(...) CGNBT_EXPAND1_(CGNBT_EXPAND1_(CGNBT_EXPAND1_(CGNBT_EXPAND1_(__VA_ARGS__))))
+#define CGNBT_EXPAND1_(...) __VA_ARGS__
+#define CGNBT_FOR_EACH_(macro, Type, ...) __VA_OPT__(CGNBT_EXPAND_(CGNBT_FOR_EACH_STEP_(macro, Type, __VA_ARGS__)))
+#define CGNBT_FOR_EACH_STEP_(macro, Type, first, ...) macro(Type, first) __VA_OPT__(, CGNBT_FOR_EACH_AGAIN_ CGNBT_PARENS_ (macro, Type, __VA_ARGS__))
+#define CGNBT_FOR_EACH_AGAIN_() CGNBT_FOR_EACH_STEP_
+
+namespace NBT::Reflect {
+    typedef uint8_t u8;
+    typedef uint32_t u32;
+    typedef uint64_t u64;
+    using namespace NBT::Type;
+    using std::array, std::span, std::string, std::string_view, std::vector, std::tuple, std::istream, std::ostream, std::same_as, std::bit_cast, std::format, NBT::Aux::readVarText, NBT::Aux::readUVarInt, NBT::Aux::readIVarInt, NBT::Aux::writeVarText, NBT::Aux::writeUVarInt, NBT::Aux::writeIVarInt, NBT::IO::Readable, NBT::IO::Writable, NBT::IO::FileReader, NBT::IO::StdIn, NBT::IO::StdOut, NBT::IO::SpanIn, NBT::IO::MAGIC, NBT::IO::skipValue, NBT::IO::emitBuffer, NBT::IO::EOF_ERROR, NBT::IO::ReadLimits, NBT::Error::clearErrors, NBT::Error::pushError, NBT::Utils::hashKey;
+
+    template <auto M>
+    struct Field;
+
+    template <typename C, typename V, V C::* M>
+    struct Field<M> {
+        using type = V;
+        static constexpr auto member = M;
+        string_view name;
+        u64 hash;
+    };
+
+    template <typename T>
+    concept Reflected = std::is_class_v<T> && requires(const T* t) { cgnbtFields(t); };
+
+    template <typename T>
+    inline constexpr auto fieldsOf = cgnbtFields(static_cast<const T*>(nullptr));
+
+    template <typename T>
+    struct IsVector : std::false_type {};
+    template <typename T, typename A>
+    struct IsVector<vector<T, A>> : std::true_type { using element = T; };
+
+    //The wire type a member of type `T` is stored as. `Count` for unsupported types.
+    template <typename T>
+    [[nodiscard]] consteval Types typeOf() noexcept {
+        if constexpr (same_as<T, bool>) return Types::Bool;
+        else if constexpr (std::signed_integral<T>) return Types::IVarInt;
+        else if constexpr (std::unsigned_integral<T>) return Types::UVarInt;
+        else if constexpr (same_as<T, float>) return Types::Float;
+        else if constexpr (same_as<T, double>) return Types::Double;
+        else if constexpr (same_as<T, string>) return Types::String;
+        else if constexpr (same_as<T, vector<bool>>) return Types::ArrayBool;
+        else if constexpr (same_as<T, vector<u8>>) return Types::ArrayRaw;
+        else if constexpr (same_as<T, vector<float>>) return Types::ArrayFloat;
+        else if constexpr (same_as<T, vector<double>>) return Types::ArrayDouble;
+        else if constexpr (IsVector<T>::value) return Types::Array;
+        else if constexpr (Reflected<T>) return Types::Object;
+        else return Types::Count;
+    }
+
+    template <typename T>
+    [[nodiscard]] consteval bool validElement() noexcept {
+        constexpr auto type = typeOf<T>();
+        return type != Types::Count && type != Types::Bool && type != Types::Float && type != Types::Double;
+    }
+
+    //Head byte of a member of type `T`, minus the value bits of `Bool`.
+    template <typename T>
+    [[nodiscard]] consteval u8 headOf() noexcept {
+        constexpr auto type = typeOf<T>();
+        static_assert(type != Types::Count, "Member type has no CGNBT mapping!");
+        if constexpr (type == Types::Array) {
+            using E = typename IsVector<T>::element;
+            static_assert(validElement<E>(), "Array elements can't be bool, float or double, use vector<bool>, vector<float> or vector<double> for the whole member instead!");
+            return getHead(Types::Array) | static_cast<u8>(getOriginalType(typeOf<E>()));
+        }
+        else return getHead(type);
+    }
+
+    template <typename T>
+    inline void writeValue(const T& value, vector<u8>& result) noexcept;
+
+    template <Reflected T>
+    inline void writeFields(const T& value, vector<u8>& result) noexcept {
+        std::apply([&](const auto&... field) {
+            ([&] {
+                using V = typename std::remove_cvref_t<decltype(field)>::type;
+                const auto& member = value.*(std::remove_cvref_t<decltype(field)>::member);
+                if constexpr (same_as<V, bool>) result.push_back(headOf<V>() | (member ? 0x01 : 0x00));
+                else result.push_back(headOf<V>());
+                writeVarText(field.name, result);
+                writeValue(member, result);
+            }(), ...);
+        }, fieldsOf<T>);
+    }
+
+    template <typename T>
+    inline void writeValue(const T& value, vector<u8>& result) noexcept {
+        constexpr auto type = typeOf<T>();
+        if constexpr (type == Types::Object) {
+            writeFields(value, result);
+            result.push_back(static_cast<u8>(Types::ObjectEnd));
+        }
+        else if constexpr (type == Types::Bool) {}
+        else if constexpr (type == Types::IVarInt) writeIVarInt(static_cast<int64_t>(value), result);
+        else if constexpr (type == Types::UVarInt) writeUVarInt(static_cast<u64>(value), result);
+        else if constexpr (type == Types::Float) for (u8 i = 0; i < sizeof(float); i++) result.push_back(static_cast<u8>(bit_cast<u32>(value) >> i * 8));
+        else if constexpr (type == Types::Double) for (u8 i = 0; i < sizeof(double); i++) result.push_back(static_cast<u8>(bit_cast<u64>(value) >> i * 8));
+        else if constexpr (type == Types::ArrayBool) {
+            writeUVarInt(value.size(), result);
+            for (const bool element : value) result.push_back(element ? 0x01 : 0x00);
+        }
+        else if constexpr (type == Types::Array) {
+            using E = typename IsVector<T>::element;
+            writeUVarInt(value.size(), result);
+            for (const auto& element : value) {
+                //Nested arrays carry their own head byte.
+                if constexpr (getOriginalType(typeOf<E>()) == Types::Array) result.push_back(headOf<E>());
+                writeValue(element, result);
+            }
+        }
+        //`String` and the contiguous typed arrays.
+        else {
+            writeUVarInt(value.size(), result);
+            const auto* const bytes = reinterpret_cast<const u8*>(value.data());
+            result.insert(result.end(), bytes, bytes + value.size() * sizeof(typename T::value_type));
+        }
+    }
+
+    template <Reflected T>
+    inline void writeData(const T& value, vector<u8>& result, bool addMagic = false) noexcept {
+        clearErrors();
+        if (addMagic) result.insert(result.end(), MAGIC.begin(), MAGIC.end());
+        writeFields(value, result);
+    }
+
+    template <Reflected T, Writable W>
+    [[nodiscard]] inline bool writeStream(W& dest, const T& value, bool zstd = false, u8 compressionLevel = 3) noexcept {
+        vector<u8> result;
+        writeData(value, result, !zstd);
+        return emitBuffer(dest, result, zstd, compressionLevel);
+    }
+
+    template <Reflected T>
+    [[nodiscard]] inline bool writeStream(ostream& s, const T& value, bool zstd = false, u8 compressionLevel = 3) noexcept {
+        StdOut adapter(s);
+        return writeStream(adapter, value, zstd, compressionLevel);
+    }
+
+    template <Readable S, typename T>
+    [[nodiscard]] inline bool readValue(FileReader<S>& cursor, u8 head, T& result) noexcept;
+
+    //One entry per field, sorted by key hash, so that matching a key is a binary search instead of a string compare per field.
+    template <Readable S, Reflected T>
+    struct Dispatch {
+        u64 hash;
+        string_view name;
+        bool (*read)(FileReader<S>&, u8, T&) noexcept;
+    };
+
+    template <Readable S, Reflected T>
+    inline constexpr auto dispatchOf = std::apply([](const auto&... field) {
+        array<Dispatch<S, T>, sizeof...(field)> result{Dispatch<S, T>{field.hash, field.name, [](FileReader<S>& cursor, u8 head, T& value) noexcept {
+            using F = std::remove_cvref_t<decltype(field)>;
+            using V = typename F::type;
+            //A member stored with another type than the struct's is skipped, the struct keeps its value.
+            if (getType(head) != typeOf<V>() || (typeOf<V>() == Types::Array && getSecondType(head) != getSecondType(headOf<V>()))) return skipValue(cursor, head);
+            return readValue(cursor, head, value.*F::member);
+        }}...};
+        std::sort(result.begin(), result.end(), [](const auto& a, const auto& b) { return a.hash < b.hash; });
+        return result;
+    }, fieldsOf<T>);
+
+    template <Readable S, Reflected T>
+    [[nodiscard]] inline bool readFields(FileReader<S>& cursor, T& result, bool topLevel = false) noexcept {
+        constexpr auto& table = dispatchOf<S, T>;
+        string key;
+        while (true) {
+            if (!cursor) {
+                if (topLevel) return true;
+                pushError(EOF_ERROR);
+                return false;
+            }
+            const u8 head = *cursor;
+            ++cursor;
+            if (getType(head) == Types::ObjectEnd) {
+                if (!topLevel) return true;
+                pushError(format("Unexpected end of object at pos {}!", cursor.currentOffset() - 1));
+                return false;
+            }
+            readVarText(cursor, key);
+            const u64 hash = hashKey(key);
+            auto entry = std::lower_bound(table.begin(), table.end(), hash, [](const auto& a, u64 b) { return a.hash < b; });
+            while (entry != table.end() && entry->hash == hash && entry->name != key) ++entry;
+            const bool success = entry != table.end() && entry->hash == hash ? entry->read(cursor, head, result) : skipValue(cursor, head);
+            if (!success) return false;
+        }
+    }
+
+    template <Readable S, typename T>
+    [[nodiscard]] inline bool readContiguous(FileReader<S>& cursor, T& result) noexcept {
+        const auto count = readUVarInt(cursor);
+        return IO::detail::admitArray(cursor, count, sizeof(typename T::value_type), ReadLimits()) && IO::detail::readBulk(cursor, result, count);
+    }
+
+    template <Readable S, typename T>
+    [[nodiscard]] inline bool readValue(FileReader<S>& cursor, u8 head, T& result) noexcept {
+        constexpr auto type = typeOf<T>();
+        if constexpr (type == Types::Object) return readFields(cursor, result);
+        else if constexpr (type == Types::Bool) { result = head & 0x01; return true; }
+        else if constexpr (type == Types::IVarInt) { result = static_cast<T>(readIVarInt(cursor)); return true; }
+        else if constexpr (type == Types::UVarInt) { result = static_cast<T>(readUVarInt(cursor)); return true; }
+        else if constexpr (type == Types::Float || type == Types::Double) {
+            using Bits = std::conditional_t<type == Types::Float, u32, u64>;
+            array<u8, sizeof(Bits)> bytes{};
+            if (cursor.getContent(bytes.data(), bytes.size()) < bytes.size()) { pushError(EOF_ERROR); return false; }
+            Bits bits = 0;
+            for (u8 i = 0; i < sizeof(Bits); i++) bits |= static_cast<Bits>(bytes[i]) << i * 8;
+            result = bit_cast<T>(bits);
+            return true;
+        }
+        else if constexpr (type == Types::ArrayBool) {
+            const auto count = readUVarInt(cursor);
+            if (!IO::detail::admitArray(cursor, count, 1, ReadLimits())) return false;
+            result.clear();
+            result.reserve(IO::detail::upfront(cursor, count, 1));
+            for (u64 i = 0; i < count; i++) {
+                if (!cursor) { pushError(EOF_ERROR); return false; }
+                result.push_back(*cursor & 0x01);
+                ++cursor;
+            }
+            return true;
+        }
+        else if constexpr (type == Types::Array) {
+            using E = typename IsVector<T>::element;
+            const auto count = readUVarInt(cursor);
+            //Every element takes a byte at least.
+            if (!IO::detail::admitArray(cursor, count, 1, ReadLimits())) return false;
+            result.clear();
+            result.resize(IO::detail::upfront(cursor, count, sizeof(E)));
+            for (u64 i = 0; i < count; i++) {
+                if (!cursor) { pushError(EOF_ERROR); return false; }
+                if (i == result.size()) result.resize(IO::detail::grown(i, count));
+                auto& element = result[i];
+                if constexpr (getOriginalType(typeOf<E>()) == Types::Array) {
+                    const u8 elementHead = *cursor;
+                    ++cursor;
+                    if (elementHead != headOf<E>()) {
+                        if (!skipValue(cursor, elementHead)) return false;
+                        continue;
+                    }
+                    if (!readValue(cursor, elementHead, element)) return false;
+                }
+                else if (!readValue(cursor, 0, element)) return false;
+            }
+            return true;
+        }
+        //`String` and the contiguous typed arrays.
+        else return readContiguous(cursor, result);
+    }
+
+    //Members missing from the document, stored with a different type, or not described by `CGNBT_FIELDS` leave `result` untouched,
+    //so default member initializers act as defaults. Unknown members are skipped without being decoded.
+    template <Readable S, Reflected T>
+    [[nodiscard]] inline bool readStream(S& source, T& result) noexcept {
+        clearErrors();
+        FileReader<S> cursor(source);
+        if (!cursor) return false;
+        bool success = cursor.empty() || readFields(cursor, result, true);
+        if (success && cursor.overrun()) {
+            pushError({.code = NBT::Error::Code::EndOfInput, .offset = cursor.currentOffset()});
+            success = false;
+        }
+        cursor.close();
+        return success;
+    }
+
+    template <Reflected T>
+    [[nodiscard]] inline bool readStream(istream& s, T& result) noexcept {
+        StdIn adapter(s);
+        return readStream(adapter, result);
+    }
+
+    template <Reflected T>
+    [[nodiscard]] inline bool readData(const span<const u8> data, T& result) noexcept {
+        SpanIn adapter(data);
+        return readStream(adapter, result);
+    }
+}
\ No newline at end of file
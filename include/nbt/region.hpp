@@ -0,0 +1,418 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#ifdef _WIN32
+    #include <fcntl.h>
+    #include <io.h>
+    #include <sys/stat.h>
+#else
+    #include <fcntl.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif // _WIN32
+
+#include "adapters.hpp"
+#include "error.hpp"
+#include "helpers.hpp"
+#include "mapLike.hpp"
+#include "read.hpp"
+#include "types.hpp"
+#include "write.hpp"
+
+namespace NBT::Region {
+    typedef uint8_t u8;
+    typedef int64_t i64;
+    typedef uint64_t u64;
+    using namespace NBT::Type;
+    using std::array, std::span, std::string, std::string_view, std::vector, std::pair, std::format, std::move, std::filesystem::path, NBT::Error::clearErrors, NBT::Error::pushError, NBT::Helpers::HashedMap, NBT::MapLike::MapLike;
+
+    //Layout: sector 0 holds the header (magic, version, index location). Every document and the index occupy whole sectors.
+    //The index is itself a CGNBT document mapping each key to `{o: offset, n: length, z: compressed}`.
+    inline constexpr array<u8, 5> MAGIC = {'c', 'G', 'n', 'b', 'R'};
+    inline constexpr u8 VERSION = 1;
+    inline constexpr u64 SECTOR_SIZE = 4096;
+    //Magic, version, 2 bytes of padding, then the index offset and length as host-endian `u64`s.
+    inline constexpr u64 HEADER_SIZE = 24;
+
+    struct Entry {
+        u64 offset{0}, length{0};
+        bool compressed{false};
+    };
+
+    //Transparent, so lookups by `string_view` don't allocate.
+    using Index = HashedMap<string, Entry>;
+
+    namespace detail {
+        struct IndexPolicy {
+            template <typename K, typename V>
+            using map = std::unordered_map<K, V>;
+        };
+        using IndexDocument = IndexPolicy::map<string, Tag<IndexPolicy>>;
+
+        [[nodiscard]] inline constexpr u64 sectors(u64 bytes) noexcept { return (bytes + SECTOR_SIZE - 1) / SECTOR_SIZE; }
+
+        //Returns once everything written to `fd` so far is on the disk.
+        [[nodiscard]] inline bool sync(int fd) noexcept {
+#ifdef _WIN32
+            return FlushFileBuffers(reinterpret_cast<HANDLE>(_get_osfhandle(fd))) != 0;
+#elif defined(__APPLE__)
+            return fsync(fd) == 0;
+#else
+            return fdatasync(fd) == 0;
+#endif // _WIN32
+        }
+
+        [[nodiscard]] inline bool encodeIndex(const Index& index, vector<u8>& result) noexcept {
+            IndexDocument document;
+            document.reserve(index.size());
+            for (const auto& [key, entry] : index) {
+                IndexDocument fields;
+                fields.emplace("o", TagUVarInt(entry.offset));
+                fields.emplace("n", TagUVarInt(entry.length));
+                fields.emplace("z", TagBool(entry.compressed));
+                document.emplace(key, TagObject<IndexPolicy>(move(fields)));
+            }
+            return IO::writeData<IndexPolicy>(document, result, true);
+        }
+
+        [[nodiscard]] inline bool decodeIndex(span<const u8> data, u64 fileSize, Index& result) noexcept {
+            IndexDocument document;
+            if (!IO::readData<IndexPolicy>(data, document)) return false;
+            result.clear();
+            result.reserve(document.size());
+            for (const auto& [key, value] : document) {
+                const auto* offset = value.type == Types::Object ? Helpers::memberPtr<Types::UVarInt, IndexPolicy>(value.tagObject.payload, "o") : nullptr;
+                const auto* length = offset != nullptr ? Helpers::memberPtr<Types::UVarInt, IndexPolicy>(value.tagObject.payload, "n") : nullptr;
+                const auto* compressed = offset != nullptr ? Helpers::memberPtr<Types::Bool, IndexPolicy>(value.tagObject.payload, "z") : nullptr;
+                if (offset == nullptr || length == nullptr || *offset < SECTOR_SIZE || *offset > fileSize || *length > fileSize - *offset) {
+                    pushError(format("Corrupted region index entry \"{}\"!", key));
+                    return false;
+                }
+                result.emplace(key, Entry{*offset, *length, compressed != nullptr && *compressed});
+            }
+            return true;
+        }
+
+        [[nodiscard]] inline bool parseHeader(span<const u8> data, Entry& index) noexcept {
+            if (data.size() < HEADER_SIZE || !std::equal(MAGIC.begin(), MAGIC.end(), data.begin()) || data[MAGIC.size()] != VERSION) {
+                pushError("Not a CGNBT region file!");
+                return false;
+            }
+            std::memcpy(&index.offset, data.data() + 8, sizeof(u64));
+            std::memcpy(&index.length, data.data() + 16, sizeof(u64));
+            return true;
+        }
+
+        [[nodiscard]] inline array<u8, HEADER_SIZE> makeHeader(const Entry& index) noexcept {
+            array<u8, HEADER_SIZE> result{};
+            std::copy(MAGIC.begin(), MAGIC.end(), result.begin());
+            result[MAGIC.size()] = VERSION;
+            std::memcpy(result.data() + 8, &index.offset, sizeof(u64));
+            std::memcpy(result.data() + 16, &index.length, sizeof(u64));
+            return result;
+        }
+    }
+
+    //Many independent CGNBT documents in one file, addressed by key. Every document is a complete CGNBT file of its own
+    //(plain with magic, or a zstd frame), stored sector-aligned; freed sectors are reused first-fit.
+    //Changes reach the index on disk with `flush` (also done by `close` and the destructor). Until then, sectors freed by
+    //overwrites or removals are not reused, so a crash leaves the previous index and every document it points to intact.
+    //Not thread-safe.
+    class File {
+    public:
+        File() noexcept = default;
+        explicit File(const path& file) noexcept { (void)open(file); }
+        File(const File&) = delete;
+        File& operator=(const File&) = delete;
+        ~File() { (void)close(); }
+
+        //Opens `file` for reading and writing, creating an empty region if it doesn't exist.
+        [[nodiscard]] bool open(const path& file) noexcept {
+            clearErrors();
+            (void)close();
+            std::error_code error;
+            const u64 size = std::filesystem::exists(file, error) ? std::filesystem::file_size(file, error) : 0;
+#ifdef _WIN32
+            fd_ = _wopen(file.c_str(), _O_RDWR | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+            fd_ = ::open(file.c_str(), O_RDWR | O_CREAT, 0644);
+#endif // _WIN32
+            if (fd_ < 0 || error) {
+                pushError(format("Can't open region file \"{}\"!", file.string()));
+                return false;
+            }
+            if (size == 0) {
+                sectors_ = 1;
+                dirty_ = true;
+                return flush();
+            }
+            array<u8, HEADER_SIZE> header{};
+            vector<u8> index;
+            if (!readAt(0, header) || !detail::parseHeader(header, indexLocation_)) return fail();
+            if (indexLocation_.offset < SECTOR_SIZE || indexLocation_.offset > size || indexLocation_.length > size - indexLocation_.offset) {
+                pushError("Corrupted region header!");
+                return fail();
+            }
+            index.resize(indexLocation_.length);
+            if (!readAt(indexLocation_.offset, index) || !detail::decodeIndex(index, size, index_)) return fail();
+            sectors_ = detail::sectors(size);
+            //Everything that neither the header, the index nor a document occupies is free.
+            vector<pair<u64, u64>> used{{0, 1}, {indexLocation_.offset / SECTOR_SIZE, detail::sectors(indexLocation_.length)}};
+            for (const auto& [key, entry] : index_) used.push_back({entry.offset / SECTOR_SIZE, detail::sectors(entry.length)});
+            std::sort(used.begin(), used.end());
+            u64 next = 0;
+            for (const auto& [first, count] : used) {
+                if (first > next) free_.push_back({next, first - next});
+                next = std::max(next, first + count);
+            }
+            if (sectors_ > next) free_.push_back({next, sectors_ - next});
+            return true;
+        }
+
+        [[nodiscard]] bool close() noexcept {
+            if (fd_ < 0) return true;
+            const bool flushed = flush();
+#ifdef _WIN32
+            _close(fd_);
+#else
+            ::close(fd_);
+#endif // _WIN32
+            fd_ = -1;
+            index_.clear();
+            free_.clear();
+            pending_.clear();
+            indexLocation_ = {};
+            sectors_ = 1;
+            dirty_ = false;
+            return flushed;
+        }
+
+        [[nodiscard]] explicit operator bool() const noexcept { return fd_ >= 0; }
+        [[nodiscard]] const Index& index() const noexcept { return index_; }
+        [[nodiscard]] bool contains(string_view key) const noexcept { return index_.find(key) != index_.end(); }
+
+        //A `Readable` over one document, fed straight from the file with `pread`. Pass it to `readStream`.
+        [[nodiscard]] bool source(string_view key, IO::FdIn& result) const noexcept {
+            const auto it = index_.find(key);
+            if (it == index_.end()) return missing(key);
+            result = IO::FdIn(fd_, static_cast<i64>(it->second.offset), static_cast<i64>(it->second.length));
+            return true;
+        }
+
+        template <typename P> requires MapLike<P>
+        [[nodiscard]] bool read(string_view key, typename P::template map<string, Tag<P>>& result) const noexcept {
+            clearErrors();
+            IO::FdIn input(-1, 0, 0);
+            return source(key, input) && IO::readStream<P>(input, result);
+        }
+
+        [[nodiscard]] bool readBytes(string_view key, vector<u8>& result) const noexcept {
+            clearErrors();
+            const auto it = index_.find(key);
+            if (it == index_.end()) return missing(key);
+            result.resize(it->second.length);
+            return readAt(it->second.offset, result);
+        }
+
+        //Stores an already encoded document, as produced by `writeStream`/`writeData` with magic, under `key`.
+        [[nodiscard]] bool writeBytes(const string& key, span<const u8> document, bool compressed) noexcept {
+            Entry entry;
+            if (!reserve(key, document.size(), compressed, entry)) return false;
+            if (!writeReserved(key, entry, document)) {
+                cancel(entry);
+                return false;
+            }
+            commit(key, entry);
+            return true;
+        }
+
+        //`writeBytes` in three steps, for writers that place several documents at once. `reserve`, `commit` and `cancel`
+        //change the file's bookkeeping and must not overlap with any other call. `writeReserved` only touches the sectors
+        //it is given, so calls for different reservations may run at the same time, alongside each other and those three.
+        [[nodiscard]] bool reserve(const string& key, u64 size, bool compressed, Entry& result) noexcept {
+            if (fd_ < 0) return missing(key);
+            result = {allocate(detail::sectors(size)) * SECTOR_SIZE, size, compressed};
+            return true;
+        }
+
+        [[nodiscard]] bool writeReserved(const string& key, const Entry& entry, span<const u8> document) const noexcept {
+            if (document.size() == entry.length && IO::FdOut(fd_, static_cast<i64>(entry.offset)).writeBlock(document.data(), document.size())) return true;
+            pushError(format("Failed to write region entry \"{}\"!", key));
+            return false;
+        }
+
+        //Points `key` at a written reservation. The sectors it pointed at before are reused after the next `flush`.
+        void commit(const string& key, const Entry& entry) noexcept {
+            if (const auto it = index_.find(key); it != index_.end()) {
+                release(pending_, it->second.offset / SECTOR_SIZE, detail::sectors(it->second.length));
+                it->second = entry;
+            }
+            else index_.emplace(key, entry);
+            dirty_ = true;
+        }
+
+        void cancel(const Entry& entry) noexcept { release(free_, entry.offset / SECTOR_SIZE, detail::sectors(entry.length)); }
+
+        template <typename P> requires MapLike<P>
+        [[nodiscard]] bool write(const string& key, const typename P::template map<string, Tag<P>>& data, bool zstd = false, u8 compressionLevel = 3) noexcept {
+            vector<u8> document;
+            IO::VecOut sink(document);
+            return IO::writeStream<P>(sink, data, zstd, compressionLevel) && writeBytes(key, document, zstd);
+        }
+
+        [[nodiscard]] bool remove(string_view key) noexcept {
+            const auto it = index_.find(key);
+            if (it == index_.end()) return missing(key);
+            release(pending_, it->second.offset / SECTOR_SIZE, detail::sectors(it->second.length));
+            index_.erase(it);
+            dirty_ = true;
+            return true;
+        }
+
+        //Writes the index to free sectors, then points the header at it. The documents and the index are synced to disk before
+        //the header is written, and the header before the sectors of replaced documents and of the old index are given back to
+        //the free list, so no order the disk applies the writes in can leave a header pointing at bytes that aren't there.
+        [[nodiscard]] bool flush() noexcept {
+            if (fd_ < 0 || !dirty_) return true;
+            vector<u8> encoded;
+            if (!detail::encodeIndex(index_, encoded)) return false;
+            const u64 count = detail::sectors(encoded.size()), first = allocate(count);
+            const Entry location{first * SECTOR_SIZE, encoded.size(), false};
+            const auto header = detail::makeHeader(location);
+            if (!IO::FdOut(fd_, static_cast<i64>(location.offset)).writeBlock(encoded.data(), encoded.size()) || !detail::sync(fd_)) {
+                release(free_, first, count);
+                pushError("Failed to write the region index!");
+                return false;
+            }
+            //The header may point at the new index already, so its sectors stay taken.
+            if (!IO::FdOut(fd_, 0).writeBlock(header.data(), header.size()) || !detail::sync(fd_)) {
+                pushError("Failed to write the region header!");
+                return false;
+            }
+            if (indexLocation_.offset != 0) release(free_, indexLocation_.offset / SECTOR_SIZE, detail::sectors(indexLocation_.length));
+            for (const auto& [pendingFirst, pendingCount] : pending_) release(free_, pendingFirst, pendingCount);
+            pending_.clear();
+            indexLocation_ = location;
+            dirty_ = false;
+            return true;
+        }
+
+        //Size of the file in sectors, and how many of them are free.
+        [[nodiscard]] u64 sectorCount() const noexcept { return sectors_; }
+        [[nodiscard]] u64 freeSectors() const noexcept {
+            u64 result = 0;
+            for (const auto& [first, count] : free_) result += count;
+            return result;
+        }
+
+    private:
+        int fd_{-1};
+        Index index_;
+        //Sorted, non-adjacent `(first sector, count)` runs.
+        vector<pair<u64, u64>> free_, pending_;
+        Entry indexLocation_;
+        u64 sectors_{1};
+        bool dirty_{false};
+
+        //First fit; grows the file if no run is large enough.
+        [[nodiscard]] u64 allocate(u64 count) noexcept {
+            for (auto it = free_.begin(); it != free_.end(); ++it) if (it->second >= count) {
+                const u64 first = it->first;
+                it->first += count;
+                it->second -= count;
+                if (it->second == 0) free_.erase(it);
+                return first;
+            }
+            const u64 first = sectors_;
+            sectors_ += count;
+            return first;
+        }
+
+        static void release(vector<pair<u64, u64>>& runs, u64 first, u64 count) noexcept {
+            if (count == 0) return;
+            auto it = std::lower_bound(runs.begin(), runs.end(), pair<u64, u64>{first, 0});
+            it = runs.insert(it, {first, count});
+            if (it + 1 != runs.end() && it->first + it->second == (it + 1)->first) {
+                it->second += (it + 1)->second;
+                runs.erase(it + 1);
+            }
+            if (it != runs.begin() && (it - 1)->first + (it - 1)->second == it->first) {
+                (it - 1)->second += it->second;
+                runs.erase(it);
+            }
+        }
+
+        [[nodiscard]] bool readAt(u64 offset, span<u8> result) const noexcept {
+            IO::FdIn input(fd_, static_cast<i64>(offset), static_cast<i64>(result.size()));
+            if (input.readBlock(result.data(), result.size()) == result.size()) return true;
+            pushError("Failed to read from the region file, EOF reached!");
+            return false;
+        }
+
+        [[nodiscard]] static bool missing(string_view key) noexcept {
+            pushError(format("No region entry \"{}\"!", key));
+            return false;
+        }
+
+        [[nodiscard]] bool fail() noexcept {
+#ifdef _WIN32
+            _close(fd_);
+#else
+            ::close(fd_);
+#endif // _WIN32
+            fd_ = -1;
+            index_.clear();
+            return false;
+        }
+    };
+
+    //Read-only access to a whole region held in memory, typically an `IO::MappedFile`: entries come back as spans into it.
+    class View {
+    public:
+        [[nodiscard]] explicit View(span<const u8> image) noexcept : image_(image) {
+            clearErrors();
+            Entry location;
+            if (!detail::parseHeader(image, location)) return;
+            if (location.offset < SECTOR_SIZE || location.offset > image.size() || location.length > image.size() - location.offset) {
+                pushError("Corrupted region header!");
+                return;
+            }
+            valid_ = detail::decodeIndex(image.subspan(location.offset, location.length), image.size(), index_);
+        }
+
+        [[nodiscard]] explicit operator bool() const noexcept { return valid_; }
+        [[nodiscard]] const Index& index() const noexcept { return index_; }
+
+        //The document stored under `key`, ready for `readData`; empty if there is none.
+        [[nodiscard]] span<const u8> entry(string_view key) const noexcept {
+            const auto it = index_.find(key);
+            if (it == index_.end()) return {};
+            return image_.subspan(it->second.offset, it->second.length);
+        }
+
+        template <typename P> requires MapLike<P>
+        [[nodiscard]] bool read(string_view key, typename P::template map<string, Tag<P>>& result) const noexcept {
+            const auto document = entry(key);
+            if (document.empty()) {
+                clearErrors();
+                pushError(format("No region entry \"{}\"!", key));
+                return false;
+            }
+            return IO::readData<P>(document, result);
+        }
+
+    private:
+        span<const u8> image_;
+        Index index_;
+        bool valid_{false};
+    };
+}
\ No newline at end of file
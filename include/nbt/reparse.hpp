@@ -0,0 +1,297 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <istream>
+#include <iterator>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "adapters.hpp"
+#include "auxiliary.hpp"
+#include "error.hpp"
+#include "FileReader.hpp"
+#include "mapLike.hpp"
+#include "read.hpp"
+#include "types.hpp"
+#include "utils.hpp"
+
+namespace NBT::IO {
+    typedef uint8_t u8;
+    typedef uint64_t u64;
+    using namespace NBT::Type;
+    using std::span, std::string, std::vector, std::istream, NBT::Aux::readVarText, NBT::Aux::readUVarInt, NBT::Error::clearErrors, NBT::Error::pushError, NBT::Error::enclose, NBT::Error::Code, NBT::MapLike::MapLike, NBT::Utils::hashKey;
+
+    namespace detail {
+        //A member read so far on an open object level: its key's hash, and the slot of `seenNames` holding the key itself.
+        struct SeenKey {
+            u64 hash, name;
+
+            [[nodiscard]] bool operator<(const SeenKey& other) const noexcept;
+            [[nodiscard]] bool operator==(const SeenKey& other) const noexcept;
+        };
+
+        //The members of every open object level, as one stack. The keys are compared in full, so a stale member whose key
+        //hashes like one of the input's is still erased. `seenNames` only grows and its strings keep their capacity, so
+        //steady-state reparses don't allocate for either.
+        inline thread_local vector<SeenKey> seenKeys;
+        inline thread_local vector<string> seenNames;
+        //Scratch for merging runs of `seenKeys`, kept for its capacity.
+        inline thread_local vector<SeenKey> mergedKeys;
+
+        inline bool SeenKey::operator<(const SeenKey& other) const noexcept { return hash != other.hash ? hash < other.hash : seenNames[name] < seenNames[other.name]; }
+        inline bool SeenKey::operator==(const SeenKey& other) const noexcept { return hash == other.hash && seenNames[name] == seenNames[other.name]; }
+
+        //Whether `key`, which hashes to `hash`, is among the sorted `[first, last)`.
+        [[nodiscard]] inline bool seen(vector<SeenKey>::const_iterator first, vector<SeenKey>::const_iterator last, u64 hash, const string& key) noexcept {
+            auto it = std::lower_bound(first, last, hash, [](const SeenKey& entry, u64 value) { return entry.hash < value; });
+            for (; it != last && it->hash == hash; ++it) if (seenNames[it->name] == key) return true;
+            return false;
+        }
+
+        //Nested levels keep their keys from `base` on as sorted runs, one per set bit of their count, largest first, so a key
+        //can be looked up before it is added. Adding one merges the runs it completes, like a carry in a binary counter.
+        inline void carry(u64 base) noexcept {
+            const u64 count = seenKeys.size() - base;
+            for (u64 size = 1; (count & size) == 0; size <<= 1) {
+                const auto end = seenKeys.end(), middle = end - static_cast<std::ptrdiff_t>(size), first = middle - static_cast<std::ptrdiff_t>(size);
+                mergedKeys.clear();
+                std::merge(first, middle, middle, end, std::back_inserter(mergedKeys));
+                std::copy(mergedKeys.begin(), mergedKeys.end(), first);
+            }
+        }
+
+        [[nodiscard]] inline bool seenOnLevel(u64 base, u64 hash, const string& key) noexcept {
+            const u64 count = seenKeys.size() - base;
+            auto first = seenKeys.cbegin() + static_cast<std::ptrdiff_t>(base);
+            for (u64 size = std::bit_floor(count); size > 0; size >>= 1) if (count & size) {
+                if (seen(first, first + static_cast<std::ptrdiff_t>(size), hash, key)) return true;
+                first += static_cast<std::ptrdiff_t>(size);
+            }
+            return false;
+        }
+        //Tags read so far by the current `readStreamInto`, against `ReadLimits::tags`.
+        inline thread_local u64 reparsedTags;
+
+        //Leaves `tag` alone if it already holds a `type`, so its payload keeps its allocations; otherwise gives it an empty one.
+        template <typename P> requires MapLike<P>
+        inline void retype(Tag<P>& tag, Types type) noexcept {
+            if (tag.type == type) return;
+            switch (type) {
+                case Types::Object:      tag = TagObject<P>();   break;
+                case Types::IVarInt:     tag = TagIVarInt();     break;
+                case Types::UVarInt:     tag = TagUVarInt();     break;
+                case Types::Bool:        tag = TagBool();        break;
+                case Types::Hex:         tag = TagHex();         break;
+                case Types::Float:       tag = TagFloat();       break;
+                case Types::Double:      tag = TagDouble();      break;
+                case Types::Array:       tag = TagArray<P>();    break;
+                case Types::String:      tag = TagString();      break;
+                case Types::Raw:         tag = TagRaw();         break;
+                case Types::ArrayBool:   tag = TagArrayBool();   break;
+                case Types::ArrayHex:    tag = TagArrayHex();    break;
+                case Types::ArrayFloat:  tag = TagArrayFloat();  break;
+                case Types::ArrayDouble: tag = TagArrayDouble(); break;
+                case Types::ArrayRaw:    tag = TagArrayRaw();    break;
+                default:                 break;
+            }
+        }
+    }
+
+    template<Readable S, typename P> requires MapLike<P>
+    [[nodiscard]] inline bool reparseObject(FileReader<S>&, typename P::template map<string, Tag<P>>&, const ReadLimits&, u64 depth, bool topLevel = false) noexcept;
+    template<Readable S, typename P> requires MapLike<P>
+    [[nodiscard]] inline bool reparseArray (FileReader<S>&, TagArray<P>&, const Types, const ReadLimits&, u64 depth)                                        noexcept;
+
+    //`head` has been consumed, and so has the key. `depth` counts the objects and arrays open around the value.
+    template<Readable S, typename P> requires MapLike<P>
+    [[nodiscard]] inline bool reparseValue(FileReader<S>& cursor, Tag<P>& result, u8 head, const ReadLimits& limits, u64 depth) noexcept {
+        const Types type = getType(head);
+        if ((type == Types::Object || type == Types::Array) && !detail::deeper(cursor, depth, limits)) return false;
+        detail::retype(result, type);
+        switch (type) {
+            case Types::Object:      return reparseObject<S, P>(cursor, result.tagObject.payload, limits, depth + 1);
+            case Types::IVarInt:     readIVarInt(cursor, result.tagIVarInt); return true;
+            case Types::UVarInt:     readUVarInt(cursor, result.tagUVarInt); return true;
+            case Types::Bool:        readBool(cursor, result.tagBool, head); return true;
+            case Types::Hex:         readHex(cursor, result.tagHex, head);   return true;
+            case Types::Float:       readFloat(cursor, result.tagFloat);     return true;
+            case Types::Double:      readDouble(cursor, result.tagDouble);   return true;
+            case Types::Raw:         readRaw(cursor, result.tagRaw);         return true;
+            case Types::Array:       return reparseArray(cursor, result.tagArray, getSecondType(head), limits, depth + 1);
+            case Types::String:      return readString(cursor, result.tagString, limits);
+            case Types::ArrayBool:   return readArrayBool(cursor, result.tagArrayBool, limits);
+            case Types::ArrayHex:    return readArrayHex(cursor, result.tagArrayHex, limits);
+            case Types::ArrayFloat:  return readArrayFloat(cursor, result.tagArrayFloat, limits);
+            case Types::ArrayDouble: return readArrayDouble(cursor, result.tagArrayDouble, limits);
+            case Types::ArrayRaw:    return readArrayRaw(cursor, result.tagArrayRaw, limits);
+            default: {
+                pushError({.code = Code::InvalidType, .type = static_cast<u8>(type), .offset = cursor.currentOffset()});
+                return false;
+            }
+        }
+    }
+
+    //Members already in `result` are parsed into in place, new ones are added, and those the input doesn't mention any more
+    //are erased at the end. A key that occurs twice keeps its last value at the top level and its first one below, as in
+    //`readStream`; later copies in nested objects are skipped. Recursive, but never deeper than `limits.depth` levels.
+    template<Readable S, typename P> requires MapLike<P>
+    [[nodiscard]] inline bool reparseObject(FileReader<S>& cursor, typename P::template map<string, Tag<P>>& result, const ReadLimits& limits, u64 depth, bool topLevel) noexcept {
+        auto& seen = detail::seenKeys;
+        const u64 base = seen.size();
+        bool success = true, closed = topLevel;
+        while (!!cursor && !cursor.overrun()) {
+            const u8 head = *cursor;
+            ++cursor;
+            if (!topLevel && getType(head) == Types::ObjectEnd) {
+                closed = true;
+                break;
+            }
+            if (!(success = detail::withinBytes(cursor, limits) && detail::admitTags(cursor, detail::reparsedTags, 1, limits))) break;
+            //Slots above the stack's top are free, whatever the levels that used them left there.
+            const u64 slot = seen.size();
+            if (detail::seenNames.size() == slot) detail::seenNames.emplace_back();
+            string& key = detail::seenNames[slot];
+            readVarText(cursor, key);
+            const u64 hash = hashKey(key);
+            if (!topLevel && detail::seenOnLevel(base, hash, key)) {
+                if (!(success = skipValue(cursor, head))) {
+                    enclose(key);
+                    break;
+                }
+                continue;
+            }
+            seen.push_back({hash, slot});
+            if (!topLevel) detail::carry(base);
+            auto it = result.find(key);
+            if (it == result.end()) it = result.emplace(key, Tag<P>()).first;
+            if (!(success = reparseValue(cursor, it->second, head, limits, depth))) {
+                enclose(it->first);
+                break;
+            }
+        }
+        if (success && (!closed || cursor.overrun())) {
+            detail::truncated(cursor);
+            success = false;
+        }
+        if (success) {
+            const auto first = seen.begin() + static_cast<std::ptrdiff_t>(base);
+            std::sort(first, seen.end());
+            const auto last = std::unique(first, seen.end());
+            if (static_cast<u64>(last - first) != result.size()) for (auto it = result.begin(); it != result.end();) {
+                if (detail::seen(first, last, hashKey(it->first), it->first)) ++it;
+                else it = result.erase(it);
+            }
+        }
+        seen.resize(base);
+        return success;
+    }
+
+    //Elements keep their storage as long as they have the same type as before; the vector keeps its capacity. Elements past
+    //the old size are added as they are read, so a forged count can't allocate ahead of the input.
+    template<Readable S, typename P> requires MapLike<P>
+    [[nodiscard]] inline bool reparseArray(FileReader<S>& cursor, TagArray<P>& result, const Types type, const ReadLimits& limits, u64 depth) noexcept {
+        const u64 count = readUVarInt(cursor);
+        if (!detail::admitArray(cursor, count, 1, limits) || !detail::admitTags(cursor, detail::reparsedTags, count, limits)) return false;
+        auto& elements = result.payload;
+        if (elements.size() > count) elements.resize(count);
+        const auto at = [&elements, count](u64 index) -> Tag<P>& {
+            if (index == elements.size()) elements.resize(detail::grown(index, count));
+            return elements[index];
+        };
+        switch (type) {
+            case Types::Object: {
+                if (count != 0 && !detail::deeper(cursor, depth, limits)) return false;
+                for (u64 i = 0; i < count && !cursor.overrun(); i++) {
+                    auto& element = at(i);
+                    detail::retype(element, Types::Object);
+                    if (!reparseObject<S, P>(cursor, element.tagObject.payload, limits, depth + 1)) {
+                        enclose(i);
+                        return false;
+                    }
+                }
+                return true;
+            }
+            case Types::IVarInt: {
+                for (u64 i = 0; i < count && !cursor.overrun(); i++) {
+                    auto& element = at(i);
+                    detail::retype(element, Types::IVarInt);
+                    readIVarInt(cursor, element.tagIVarInt);
+                }
+                return true;
+            }
+            case Types::UVarInt: {
+                for (u64 i = 0; i < count && !cursor.overrun(); i++) {
+                    auto& element = at(i);
+                    detail::retype(element, Types::UVarInt);
+                    readUVarInt(cursor, element.tagUVarInt);
+                }
+                return true;
+            }
+            case Types::String: {
+                for (u64 i = 0; i < count && !cursor.overrun(); i++) {
+                    auto& element = at(i);
+                    detail::retype(element, Types::String);
+                    if (!readString(cursor, element.tagString, limits)) {
+                        enclose(i);
+                        return false;
+                    }
+                }
+                return true;
+            }
+            case Types::Array: {
+                if (count == 0) return true;
+                //Every element repeats the head byte; like `readArray`, the first one decides for all of them.
+                const u8 head = *cursor;
+                const Types second = getSecondType(head), element = getType(head);
+                if (element == Types::Array && second != Types::Object && second != Types::IVarInt && second != Types::UVarInt && second != Types::Array && second != Types::String) {
+                    pushError({.code = Code::InvalidSecondType, .type = static_cast<u8>(second), .offset = cursor.currentOffset()});
+                    return false;
+                }
+                for (u64 i = 0; i < count && !cursor.overrun(); i++) {
+                    auto& nested = at(i);
+                    detail::retype(nested, element);
+                    ++cursor;
+                    const bool success = element == Types::Array ? detail::deeper(cursor, depth, limits) && reparseArray(cursor, nested.tagArray, second, limits, depth + 1) : reparseValue(cursor, nested, head, limits, depth);
+                    if (!success) {
+                        enclose(i);
+                        return false;
+                    }
+                }
+                return true;
+            }
+            default: break;
+        }
+        pushError({.code = Code::InvalidSecondType, .type = static_cast<u8>(type), .offset = cursor.currentOffset() - 1});
+        return false;
+    }
+
+    //Same result as `readStream`, but parses into `result` as it is instead of clearing it first: maps keep the nodes of
+    //members that are still there, and strings, typed arrays and `TagArray`s keep their capacity wherever the type at a key
+    //or index is unchanged. Reloading a document with the same shape as last time then allocates next to nothing.
+    //`result` is left empty on failure.
+    template<typename P, Readable S> requires MapLike<P>
+    [[nodiscard]] inline bool readStreamInto(S& source, typename P::template map<string, Tag<P>>& result, ZSTD_DStream* context = nullptr, const ReadLimits& limits = ReadLimits()) noexcept {
+        clearErrors();
+        FileReader<S> cursor(source, context);
+        bool success = !!cursor || cursor.empty();
+        detail::reparsedTags = 0;
+        if (!!cursor) success = reparseObject<S, P>(cursor, result, limits, 1, true);
+        else if (cursor.empty()) result.clear();
+        cursor.close();
+        if (!success) result.clear();
+        return success;
+    }
+
+    template <typename P> requires MapLike<P>
+    [[nodiscard]] inline bool readStreamInto(istream& s, typename P::template map<string, Tag<P>>& result, const ReadLimits& limits = ReadLimits()) noexcept {
+        StdIn adapter(s);
+        return readStreamInto<P>(adapter, result, nullptr, limits);
+    }
+
+    template <typename P> requires MapLike<P>
+    [[nodiscard]] inline bool readDataInto(const span<const u8> data, typename P::template map<string, Tag<P>>& result, const ReadLimits& limits = ReadLimits()) noexcept {
+        SpanIn adapter(data);
+        return readStreamInto<P>(adapter, result, nullptr, limits);
+    }
+}
\ No newline at end of file
@@ -10,19 +10,8 @@ namespace NBT::IO {
     template <typename P> requires MapLike<P>
     inline string serialize(const typename P::template map<string, Tag<P>>& data) noexcept {
         //Reason why we are not making a TagObject out of it and why is here even a `serialize.hpp`: NO DATA COPYING PLEASE!
-        string result("{");
-        bool first = true;
-        for (const auto& [key, value] : data) {
-            if (first) {
-                first = false;
-                result += "\"";
-            }
-            else result += ", \"";
-            result += key;
-            result += "\": ";
-            result += value.toString();
-        }
-        result += "}";
+        string result;
+        NBT::Type::detail::printMembers<P>(data, result);
         return result;
     }
 
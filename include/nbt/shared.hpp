@@ -0,0 +1,559 @@
+#pragma once
+#include <atomic>
+#include <bit>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "adapters.hpp"
+#include "auxiliary.hpp"
+#include "error.hpp"
+#include "hash.hpp"
+#include "mapLike.hpp"
+#include "types.hpp"
+#include "write.hpp"
+
+namespace NBT::Shared {
+    typedef uint8_t u8;
+    typedef uint32_t u32;
+    typedef int64_t i64;
+    typedef uint64_t u64;
+    using namespace NBT::Type;
+    using std::string, std::vector, std::unordered_map, std::variant, std::shared_ptr, std::make_shared, std::move, std::atomic, std::bit_cast, std::ostream, std::pair, std::format, NBT::Aux::writeVarText, NBT::Aux::writeIVarInt, NBT::Aux::writeUVarInt, NBT::Error::clearErrors, NBT::Error::pushError, NBT::MapLike::MapLike, NBT::Utils::hashKey;
+
+    template <typename P> requires MapLike<P>
+    struct Node;
+
+    //Objects and arrays that encode to fewer bytes are not cached on their own but copied along with their parent's level:
+    //re-encoding them is cheaper than a separate lookup, and their parent is re-encoded whenever they change anyway.
+    inline constexpr u64 ENCODING_THRESHOLD = 512;
+
+    template <Types T, typename P> requires MapLike<P>
+    struct PayloadOf {
+        using type = void;
+    };
+
+    #define LINK_TYPE_TO_PAYLOAD(type_, ...) \
+    template <typename P> requires MapLike<P> \
+    struct PayloadOf<type_, P> { \
+        using type = __VA_ARGS__; \
+    };
+
+    LINK_TYPE_TO_PAYLOAD(Types::Object, typename P::template map<string, Node<P>>)
+    LINK_TYPE_TO_PAYLOAD(Types::IVarInt, i64)
+    LINK_TYPE_TO_PAYLOAD(Types::UVarInt, u64)
+    LINK_TYPE_TO_PAYLOAD(Types::Bool, bool)
+    LINK_TYPE_TO_PAYLOAD(Types::Hex, u8)
+    LINK_TYPE_TO_PAYLOAD(Types::Float, float)
+    LINK_TYPE_TO_PAYLOAD(Types::Double, double)
+    LINK_TYPE_TO_PAYLOAD(Types::Array, vector<Node<P>>)
+    LINK_TYPE_TO_PAYLOAD(Types::String, string)
+    LINK_TYPE_TO_PAYLOAD(Types::Raw, u8)
+    LINK_TYPE_TO_PAYLOAD(Types::ArrayBool, vector<u8>)
+    LINK_TYPE_TO_PAYLOAD(Types::ArrayHex, vector<u8>)
+    LINK_TYPE_TO_PAYLOAD(Types::ArrayFloat, vector<float>)
+    LINK_TYPE_TO_PAYLOAD(Types::ArrayDouble, vector<double>)
+    LINK_TYPE_TO_PAYLOAD(Types::ArrayRaw, vector<u8>)
+
+    #undef LINK_TYPE_TO_PAYLOAD
+
+    //Scalars are stored inline, everything else lives in an immutable box shared by every copy of the node.
+    [[nodiscard]] inline constexpr bool boxed(Types type) noexcept {
+        switch (type) {
+            case Types::Object: case Types::Array: case Types::String:
+            case Types::ArrayBool: case Types::ArrayHex: case Types::ArrayFloat: case Types::ArrayDouble: case Types::ArrayRaw:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    //A copy-on-write document node. Copying a node is O(1): objects, arrays, strings and typed arrays share their storage
+    //with the original until one side calls `mut`, which clones that one level only (children are shared again, not copied).
+    //Nodes are the snapshot-friendly counterpart of `Tag`; convert with `fromTag`/`toTag`.
+    //Copies may be handed to other threads, but a single node must not be read and mutated concurrently.
+    //Each box caches its subtree digest once computed, and objects and arrays their encoded bytes once written; `mut` drops both.
+    //A digest or encoding taken while a pointer returned by `mut` is still being written through goes stale, so call `mut`
+    //again (from the root) after taking one.
+    template <typename P> requires MapLike<P>
+    struct Node {
+        using Members = typename PayloadOf<Types::Object, P>::type;
+        using Elements = typename PayloadOf<Types::Array, P>::type;
+
+        [[nodiscard]] Node() noexcept : type_(Types::Count) {}
+        [[nodiscard]] Node(Members payload) noexcept : type_(Types::Object), box_(make_shared<Box>(move(payload))) {}
+        [[nodiscard]] Node(TagIVarInt value)  noexcept : type_(Types::IVarInt) { scalar_.i = value.payload; }
+        [[nodiscard]] Node(TagUVarInt value)  noexcept : type_(Types::UVarInt) { scalar_.u = value.payload; }
+        [[nodiscard]] Node(TagBool value)     noexcept : type_(Types::Bool)    { scalar_.b = value.payload; }
+        [[nodiscard]] Node(TagHex value)      noexcept : type_(Types::Hex)     { scalar_.h = value.payload; }
+        [[nodiscard]] Node(TagFloat value)    noexcept : type_(Types::Float)   { scalar_.f = value.payload; }
+        [[nodiscard]] Node(TagDouble value)   noexcept : type_(Types::Double)  { scalar_.d = value.payload; }
+        [[nodiscard]] Node(TagRaw value)      noexcept : type_(Types::Raw)     { scalar_.r = value.payload; }
+        [[nodiscard]] Node(Elements payload)  noexcept : type_(Types::Array),       box_(make_shared<Box>(move(payload))) {}
+        [[nodiscard]] Node(TagString value)   noexcept : type_(Types::String),      box_(make_shared<Box>(move(value.payload))) {}
+        [[nodiscard]] Node(TagArrayBool value)   noexcept : type_(Types::ArrayBool),   box_(make_shared<Box>(move(value.payload))) {}
+        [[nodiscard]] Node(TagArrayHex value)    noexcept : type_(Types::ArrayHex),    box_(make_shared<Box>(move(value.payload))) {}
+        [[nodiscard]] Node(TagArrayFloat value)  noexcept : type_(Types::ArrayFloat),  box_(make_shared<Box>(move(value.payload))) {}
+        [[nodiscard]] Node(TagArrayDouble value) noexcept : type_(Types::ArrayDouble), box_(make_shared<Box>(move(value.payload))) {}
+        [[nodiscard]] Node(TagArrayRaw value)    noexcept : type_(Types::ArrayRaw),    box_(make_shared<Box>(move(value.payload))) {}
+
+        [[nodiscard]] Types type() const noexcept { return type_; }
+
+        //Read access never copies. `nullptr` if the node has another type.
+        template <Types T>
+        [[nodiscard]] const typename PayloadOf<T, P>::type* get() const noexcept {
+            if (type_ != T) return nullptr;
+            if constexpr (boxed(T)) return &std::get<typename PayloadOf<T, P>::type>(box_->value);
+            else return &scalar<T>();
+        }
+
+        //Write access. Clones the box first if any other node still shares it, so earlier copies keep their contents.
+        template <Types T>
+        [[nodiscard]] typename PayloadOf<T, P>::type* mut() noexcept {
+            if (type_ != T) return nullptr;
+            if constexpr (boxed(T)) {
+                if (box_.use_count() > 1) box_ = make_shared<Box>(std::get<typename PayloadOf<T, P>::type>(box_->value));
+                else {
+                    box_->digest.store(0, std::memory_order_relaxed);
+                    box_->encoding.store(nullptr, std::memory_order_release);
+                }
+                return &std::get<typename PayloadOf<T, P>::type>(box_->value);
+            }
+            else return &scalar<T>();
+        }
+
+        //Whether two nodes currently share their storage, i.e. the last copy between them hasn't been written to.
+        [[nodiscard]] bool sharesWith(const Node& other) const noexcept { return box_ != nullptr && box_ == other.box_; }
+
+        //Identifies the encoding `writeData` cached for this object or array, `nullptr` while there is none. Stays the same
+        //across saves until the subtree is `mut`ated.
+        [[nodiscard]] const void* cachedEncoding() const noexcept { return boxed(type_) ? box_->encoding.load(std::memory_order_acquire).get() : nullptr; }
+
+        //Equal to `Hash::digest` of the corresponding `Tag`. Cached per box, so after the first call only edited paths are rehashed.
+        [[nodiscard]] u64 digest() const noexcept {
+            if (!boxed(type_)) return Hash::finish(type_, scalarBits());
+            u64 result = box_->digest.load(std::memory_order_relaxed);
+            if (result == 0) {
+                result = computeDigest();
+                box_->digest.store(result, std::memory_order_relaxed);
+            }
+            return result;
+        }
+
+        //Same semantics as `Tag::operator==`. Shared boxes are equal without looking inside, and differing digests are unequal
+        //without looking inside, so comparing two snapshots of one document only walks the parts that were edited.
+        [[nodiscard]] bool operator==(const Node& other) const noexcept {
+            if (type_ != other.type_) return false;
+            if (!boxed(type_)) return scalarBits() == other.scalarBits();
+            if (box_ == other.box_) return true;
+            if (digest() != other.digest()) return false;
+            switch (type_) {
+                case Types::Object: {
+                    const auto& mine = *get<Types::Object>();
+                    const auto& theirs = *other.template get<Types::Object>();
+                    if (mine.size() != theirs.size()) return false;
+                    for (const auto& [key, value] : mine) {
+                        const auto it = theirs.find(key);
+                        if (it == theirs.end() || !(value == it->second)) return false;
+                    }
+                    return true;
+                }
+                case Types::Array:       return *get<Types::Array>() == *other.template get<Types::Array>();
+                case Types::String:      return *get<Types::String>() == *other.template get<Types::String>();
+                case Types::ArrayBool:   return NBT::Type::detail::samePayload(*get<Types::ArrayBool>(), *other.template get<Types::ArrayBool>());
+                case Types::ArrayHex:    return NBT::Type::detail::samePayload(*get<Types::ArrayHex>(), *other.template get<Types::ArrayHex>());
+                case Types::ArrayFloat:  return NBT::Type::detail::samePayload(*get<Types::ArrayFloat>(), *other.template get<Types::ArrayFloat>());
+                case Types::ArrayDouble: return NBT::Type::detail::samePayload(*get<Types::ArrayDouble>(), *other.template get<Types::ArrayDouble>());
+                default:                 return NBT::Type::detail::samePayload(*get<Types::ArrayRaw>(), *other.template get<Types::ArrayRaw>());
+            }
+        }
+
+        //The head byte `writeMember` would emit for this node.
+        [[nodiscard]] u8 head() const noexcept {
+            switch (type_) {
+                case Types::Bool:        return getHead(type_) | (scalar_.b ? 0x01 : 0x00);
+                case Types::Hex:         return getHead(type_) | (scalar_.h & 0x0F);
+                case Types::Array:       return getHead(type_) | static_cast<u8>(getOriginalType(secondType()));
+                case Types::ArrayBool:   return getHead(Types::Array) | static_cast<u8>(Types::Bool);
+                case Types::ArrayHex:    return getHead(Types::Array) | static_cast<u8>(Types::Hex);
+                case Types::ArrayFloat:  return getHead(Types::Array) | static_cast<u8>(Types::Float);
+                case Types::ArrayDouble: return getHead(Types::Array) | static_cast<u8>(Types::Double);
+                case Types::ArrayRaw:    return getHead(Types::Array) | static_cast<u8>(Types::Raw);
+                default:                 return getHead(type_);
+            }
+        }
+
+        //Appends what `writeMember` writes after the head byte and key: members and `ObjectEnd` for objects, count and elements
+        //for arrays, the payload for everything else. Objects and arrays keep the bytes of their own level from the last call,
+        //with holes where their larger object and array children go, so an unchanged subtree is copied rather than encoded again
+        //and only the boxes `mut` was called on since are re-encoded. Every encoded byte is cached once, by its nearest cached box.
+        [[nodiscard]] bool encode(vector<u8>& result) const noexcept {
+            switch (type_) {
+                case Types::Object:
+                case Types::Array:       return emit(box_, result);
+                case Types::IVarInt:     writeIVarInt(scalar_.i, result); return true;
+                case Types::UVarInt:     writeUVarInt(scalar_.u, result); return true;
+                case Types::Bool:
+                case Types::Hex:         return true;
+                case Types::Float:       append(&scalar_.f, sizeof(float), result); return true;
+                case Types::Double:      append(&scalar_.d, sizeof(double), result); return true;
+                case Types::Raw:         result.push_back(scalar_.r); return true;
+                case Types::String:      return sized(*get<Types::String>(), result);
+                case Types::ArrayFloat:  return sized(*get<Types::ArrayFloat>(), result);
+                case Types::ArrayDouble: return sized(*get<Types::ArrayDouble>(), result);
+                case Types::ArrayBool:
+                case Types::ArrayHex:
+                case Types::ArrayRaw:    return sized(std::get<vector<u8>>(box_->value), result);
+                default: {
+                    pushError("Can't encode an empty node!");
+                    return false;
+                }
+            }
+        }
+
+    private:
+        struct Box;
+        //The bytes of one object or array level. `holes` are offsets into `bytes` where the encoding of a child box goes.
+        struct Encoding {
+            vector<u8> bytes;
+            vector<pair<u64, shared_ptr<Box>>> holes;
+        };
+
+        struct Box {
+            variant<Members, Elements, string, vector<u8>, vector<float>, vector<double>> value;
+            //0 while not computed.
+            mutable atomic<u64> digest{0};
+            //Empty while not written yet.
+            mutable atomic<shared_ptr<const Encoding>> encoding;
+
+            template <typename T>
+            [[nodiscard]] explicit Box(T&& payload) noexcept : value(std::forward<T>(payload)) {}
+        };
+
+        union Scalar {
+            i64 i;
+            u64 u;
+            bool b;
+            u8 h;
+            float f;
+            double d;
+            u8 r;
+        };
+
+        Types type_;
+        Scalar scalar_{};
+        shared_ptr<Box> box_;
+
+        //The same bits `Hash::digest` feeds in for the corresponding scalar tag.
+        [[nodiscard]] u64 scalarBits() const noexcept {
+            switch (type_) {
+                case Types::IVarInt: return static_cast<u64>(scalar_.i);
+                case Types::UVarInt: return scalar_.u;
+                case Types::Bool:    return scalar_.b;
+                case Types::Hex:     return scalar_.h;
+                case Types::Float:   return bit_cast<u32>(scalar_.f);
+                case Types::Double:  return bit_cast<u64>(scalar_.d);
+                case Types::Raw:     return scalar_.r;
+                default:             return 0;
+            }
+        }
+
+        [[nodiscard]] u64 computeDigest() const noexcept {
+            const auto bytesOf = [](const auto& payload) noexcept { return Hash::bytes(payload.data(), payload.size() * sizeof(payload[0])); };
+            switch (type_) {
+                case Types::Object: {
+                    const auto& members = *get<Types::Object>();
+                    u64 sum = members.size();
+                    for (const auto& [key, value] : members) sum += Hash::member(hashKey(key), value.digest());
+                    return Hash::finish(Types::Object, sum);
+                }
+                case Types::Array: {
+                    const auto& elements = *get<Types::Array>();
+                    u64 state = elements.size();
+                    for (const auto& element : elements) state = Hash::element(state, element.digest());
+                    return Hash::finish(Types::Array, state);
+                }
+                case Types::String:      return Hash::finish(type_, bytesOf(*get<Types::String>()));
+                case Types::ArrayFloat:  return Hash::finish(type_, bytesOf(*get<Types::ArrayFloat>()));
+                case Types::ArrayDouble: return Hash::finish(type_, bytesOf(*get<Types::ArrayDouble>()));
+                default:                 return Hash::finish(type_, bytesOf(std::get<vector<u8>>(box_->value)));
+            }
+        }
+
+        //Type of the first element of an `Array`; `Object` for empty ones, which have no element to take it from.
+        [[nodiscard]] Types secondType() const noexcept {
+            const auto& elements = *get<Types::Array>();
+            return elements.empty() ? Types::Object : elements[0].type_;
+        }
+
+        static void append(const void* data, u64 size, vector<u8>& result) noexcept {
+            const auto* const bytes = static_cast<const u8*>(data);
+            result.insert(result.end(), bytes, bytes + size);
+        }
+
+        template <typename C>
+        [[nodiscard]] static bool sized(const C& payload, vector<u8>& result) noexcept {
+            writeUVarInt(payload.size(), result);
+            append(payload.data(), payload.size() * sizeof(typename C::value_type), result);
+            return true;
+        }
+
+        //Copies the cached level of an object or array box, or encodes it and caches it on the way.
+        [[nodiscard]] static bool emit(const shared_ptr<Box>& box, vector<u8>& result) noexcept {
+            if (const auto cached = box->encoding.load(std::memory_order_acquire)) {
+                u64 done = 0;
+                for (const auto& [offset, child] : cached->holes) {
+                    result.insert(result.end(), cached->bytes.begin() + done, cached->bytes.begin() + offset);
+                    done = offset;
+                    if (!emit(child, result)) return false;
+                }
+                result.insert(result.end(), cached->bytes.begin() + done, cached->bytes.end());
+                return true;
+            }
+            //Where each child's bytes landed in `result`, so they can be cut out of this level's copy below.
+            struct Span {
+                u64 begin, end;
+                shared_ptr<Box> box;
+            };
+            vector<Span> children;
+            const auto child = [&children, &result](const Node& node) noexcept {
+                const u64 begin = result.size();
+                if (!emit(node.box_, result)) return false;
+                if (result.size() - begin >= ENCODING_THRESHOLD) children.push_back({begin, result.size(), node.box_});
+                return true;
+            };
+            const u64 start = result.size();
+            if (const auto* members = std::get_if<Members>(&box->value)) {
+                for (const auto& [key, value] : *members) {
+                    result.push_back(value.head());
+                    writeVarText(key, result);
+                    if (value.type_ == Types::Object || value.type_ == Types::Array ? !child(value) : !value.encode(result)) return false;
+                }
+                result.push_back(static_cast<u8>(Types::ObjectEnd));
+            }
+            else {
+                const auto& elements = std::get<Elements>(box->value);
+                writeUVarInt(elements.size(), result);
+                const Types second = elements.empty() ? Types::Object : elements[0].type_;
+                switch (second) {
+                    case Types::Bool: case Types::Hex: case Types::Float: case Types::Double: case Types::Raw: case Types::Count:
+                        pushError(format("Invalid second type {} in array! For fixed-size types (`bool 4`, `hex 5`, `float 6`, `double 7`, `raw 10`), please use dedicated array types.", static_cast<u8>(second)));
+                        return false;
+                    default: break;
+                }
+                for (const auto& element : elements) {
+                    if (element.type_ != second) {
+                        pushError(format("Array elements of types {} and {} can't be mixed!", static_cast<u8>(second), static_cast<u8>(element.type_)));
+                        return false;
+                    }
+                    //Nested arrays and typed arrays carry their own head byte, the same one `writeArray` emits.
+                    if (getOriginalType(second) == Types::Array) result.push_back(element.head());
+                    if (second == Types::Object || second == Types::Array ? !child(element) : !element.encode(result)) return false;
+                }
+            }
+            if (result.size() - start < ENCODING_THRESHOLD) return true;
+            auto level = make_shared<Encoding>();
+            level->bytes.reserve(result.size() - start);
+            u64 done = start;
+            for (auto& span : children) {
+                level->bytes.insert(level->bytes.end(), result.begin() + done, result.begin() + span.begin);
+                level->holes.push_back({level->bytes.size(), move(span.box)});
+                done = span.end;
+            }
+            level->bytes.insert(level->bytes.end(), result.begin() + done, result.end());
+            box->encoding.store(move(level), std::memory_order_release);
+            return true;
+        }
+
+        template <Types T>
+        [[nodiscard]] auto& scalar() noexcept { return const_cast<typename PayloadOf<T, P>::type&>(static_cast<const Node*>(this)->scalar<T>()); }
+        template <Types T>
+        [[nodiscard]] const auto& scalar() const noexcept {
+            if constexpr (T == Types::IVarInt) return scalar_.i;
+            else if constexpr (T == Types::UVarInt) return scalar_.u;
+            else if constexpr (T == Types::Bool) return scalar_.b;
+            else if constexpr (T == Types::Hex) return scalar_.h;
+            else if constexpr (T == Types::Float) return scalar_.f;
+            else if constexpr (T == Types::Double) return scalar_.d;
+            else return scalar_.r;
+        }
+    };
+
+    template <typename P> requires MapLike<P>
+    [[nodiscard]] inline Node<P> fromTag(const Tag<P>& tag) noexcept {
+        switch (tag.type) {
+            case Types::Object: {
+                typename Node<P>::Members members;
+                for (const auto& [key, value] : tag.tagObject.payload) members.emplace(key, fromTag(value));
+                return members;
+            }
+            case Types::Array: {
+                typename Node<P>::Elements elements;
+                elements.reserve(tag.tagArray.payload.size());
+                for (const auto& element : tag.tagArray.payload) elements.push_back(fromTag(element));
+                return elements;
+            }
+            case Types::IVarInt:     return tag.tagIVarInt;
+            case Types::UVarInt:     return tag.tagUVarInt;
+            case Types::Bool:        return tag.tagBool;
+            case Types::Hex:         return tag.tagHex;
+            case Types::Float:       return tag.tagFloat;
+            case Types::Double:      return tag.tagDouble;
+            case Types::String:      return tag.tagString;
+            case Types::Raw:         return tag.tagRaw;
+            case Types::ArrayBool:   return tag.tagArrayBool;
+            case Types::ArrayHex:    return tag.tagArrayHex;
+            case Types::ArrayFloat:  return tag.tagArrayFloat;
+            case Types::ArrayDouble: return tag.tagArrayDouble;
+            case Types::ArrayRaw:    return tag.tagArrayRaw;
+            default:                 return {};
+        }
+    }
+
+    //A whole document, as returned by `readStream`, becomes an `Object` node.
+    template <typename P> requires MapLike<P>
+    [[nodiscard]] inline Node<P> fromMap(const typename P::template map<string, Tag<P>>& data) noexcept {
+        typename Node<P>::Members members;
+        for (const auto& [key, value] : data) members.emplace(key, fromTag(value));
+        return members;
+    }
+
+    template <typename P> requires MapLike<P>
+    [[nodiscard]] inline Tag<P> toTag(const Node<P>& node) noexcept {
+        switch (node.type()) {
+            case Types::Object: {
+                typename P::template map<string, Tag<P>> members;
+                for (const auto& [key, value] : *node.template get<Types::Object>()) members.emplace(key, toTag(value));
+                return TagObject<P>(move(members));
+            }
+            case Types::Array: {
+                vector<Tag<P>> elements;
+                elements.reserve(node.template get<Types::Array>()->size());
+                for (const auto& element : *node.template get<Types::Array>()) elements.push_back(toTag(element));
+                return TagArray<P>(move(elements));
+            }
+            case Types::IVarInt:     return TagIVarInt(*node.template get<Types::IVarInt>());
+            case Types::UVarInt:     return TagUVarInt(*node.template get<Types::UVarInt>());
+            case Types::Bool:        return TagBool(*node.template get<Types::Bool>());
+            case Types::Hex:         return TagHex(*node.template get<Types::Hex>());
+            case Types::Float:       return TagFloat(*node.template get<Types::Float>());
+            case Types::Double:      return TagDouble(*node.template get<Types::Double>());
+            case Types::String:      return TagString(*node.template get<Types::String>());
+            case Types::Raw:         return TagRaw(*node.template get<Types::Raw>());
+            case Types::ArrayBool:   return TagArrayBool(*node.template get<Types::ArrayBool>());
+            case Types::ArrayHex:    return TagArrayHex(*node.template get<Types::ArrayHex>());
+            case Types::ArrayFloat:  return TagArrayFloat(*node.template get<Types::ArrayFloat>());
+            case Types::ArrayDouble: return TagArrayDouble(*node.template get<Types::ArrayDouble>());
+            case Types::ArrayRaw:    return TagArrayRaw(*node.template get<Types::ArrayRaw>());
+            default:                 return {};
+        }
+    }
+
+    //Inverse of `fromMap`. Empty if `node` isn't an `Object`.
+    template <typename P> requires MapLike<P>
+    [[nodiscard]] inline typename P::template map<string, Tag<P>> toMap(const Node<P>& node) noexcept {
+        typename P::template map<string, Tag<P>> result;
+        if (const auto* members = node.template get<Types::Object>()) for (const auto& [key, value] : *members) result.emplace(key, toTag(value));
+        return result;
+    }
+
+    //Same bytes as `IO::writeData` on `toMap(root)` (for maps that iterate in a fixed order; hash maps may order members differently),
+    //but objects and arrays that weren't `mut`ated since the last call are copied from their cached encoding instead of being
+    //encoded again. The first call encodes everything and fills the caches.
+    template <typename P> requires MapLike<P>
+    [[nodiscard]] inline bool writeData(const Node<P>& root, vector<u8>& result, bool addMagic = false) noexcept {
+        clearErrors();
+        if (root.type() != Types::Object) {
+            pushError("Only object nodes can be written as a document!");
+            return false;
+        }
+        if (addMagic) result.insert(result.end(), IO::MAGIC.begin(), IO::MAGIC.end());
+        if (!root.encode(result)) return false;
+        //The top level runs to EOF instead of ending with `ObjectEnd`.
+        result.pop_back();
+        return true;
+    }
+
+    template<typename P, IO::Writable W> requires MapLike<P>
+    [[nodiscard]] inline bool writeStream(W& dest, const Node<P>& root, bool zstd = false, u8 compressionLevel = 3) noexcept {
+        vector<u8> result;
+        if (!writeData<P>(root, result, !zstd)) return false;
+        return IO::emitBuffer(dest, result, zstd, compressionLevel);
+    }
+
+    template <typename P> requires MapLike<P>
+    [[nodiscard]] inline bool writeStream(ostream& s, const Node<P>& root, bool zstd = false, u8 compressionLevel = 3) noexcept {
+        IO::StdOut adapter(s);
+        return writeStream<P>(adapter, root, zstd, compressionLevel);
+    }
+
+    //Hash-consing: merges structurally equal subtrees into one shared box, so a palette entry or default item stack that occurs
+    //a thousand times is stored once. Children are interned before their parent, which makes them pointer-equal to the children
+    //of any equal candidate, so each lookup only compares one level. Interned nodes are ordinary `Node`s: `mut` on one of them
+    //clones it like any other shared box and leaves the others alone.
+    //The interner keeps every unique subtree alive until `clear`. Not thread-safe.
+    template <typename P> requires MapLike<P>
+    class Interner {
+    public:
+        //Interns `node` and everything below it. Pass an rvalue when possible, so that boxes nobody else holds are updated in place.
+        [[nodiscard]] Node<P> intern(Node<P> node) noexcept {
+            if (!boxed(node.type())) return node;
+            //Already interned, e.g. the children `fromMap` built. Checked first, since descending would clone the shared boxes.
+            if (const auto it = table_.find(node.digest()); it != table_.end()) for (const auto& candidate : it->second) if (candidate.sharesWith(node)) return node;
+            if (auto* members = node.template get<Types::Object>()) {
+                if (!members->empty()) for (auto& [key, value] : *node.template mut<Types::Object>()) value = intern(move(value));
+            }
+            else if (auto* elements = node.template get<Types::Array>()) {
+                if (!elements->empty()) for (auto& element : *node.template mut<Types::Array>()) element = intern(move(element));
+            }
+            auto& bucket = table_[node.digest()];
+            for (const auto& candidate : bucket) if (candidate == node) {
+                hits_++;
+                return candidate;
+            }
+            bucket.push_back(node);
+            unique_++;
+            return node;
+        }
+
+        //Converts and interns in one pass, so duplicates never get a box of their own.
+        [[nodiscard]] Node<P> fromMap(const typename P::template map<string, Tag<P>>& data) noexcept {
+            typename Node<P>::Members members;
+            for (const auto& [key, value] : data) members.emplace(key, fromTag(value));
+            return intern(Node<P>(move(members)));
+        }
+
+        [[nodiscard]] Node<P> fromTag(const Tag<P>& tag) noexcept {
+            switch (tag.type) {
+                case Types::Object: return fromMap(tag.tagObject.payload);
+                case Types::Array: {
+                    typename Node<P>::Elements elements;
+                    elements.reserve(tag.tagArray.payload.size());
+                    for (const auto& element : tag.tagArray.payload) elements.push_back(fromTag(element));
+                    return intern(Node<P>(move(elements)));
+                }
+                default: return intern(Shared::fromTag(tag));
+            }
+        }
+
+        //Number of distinct subtrees stored.
+        [[nodiscard]] u64 size() const noexcept { return unique_; }
+        //Number of subtrees that were replaced by an existing one.
+        [[nodiscard]] u64 hits() const noexcept { return hits_; }
+
+        void clear() noexcept {
+            table_.clear();
+            unique_ = 0;
+            hits_ = 0;
+        }
+
+    private:
+        //Keyed by digest; collisions share a bucket and are told apart by `==`.
+        unordered_map<u64, vector<Node<P>>> table_;
+        u64 unique_{0}, hits_{0};
+    };
+}
\ No newline at end of file
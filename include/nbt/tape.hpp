@@ -0,0 +1,337 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <format>
+#include <iterator>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "adapters.hpp"
+#include "auxiliary.hpp"
+#include "error.hpp"
+#include "FileReader.hpp"
+#include "read.hpp"
+#include "types.hpp"
+
+//Tape: a read-only parse target that stores a whole document in two flat buffers instead of a tree of `Tag`s.
+//Every value is one 16-byte entry on the tape: its type and key, plus either the value itself or where to find it.
+//  Object/Array start: value = tape index of the matching end entry, so siblings are one jump away.
+//  End (`ObjectEnd`):  value = number of children.
+//  String/typed array: value = arena offset of a `u64` count followed by the payload, 8-byte aligned.
+//  Everything else:    value = the scalar itself.
+//Keys live in the arena as a `u32` length followed by the bytes; offset 0 is the empty key used by array elements.
+namespace NBT::Tape {
+    typedef uint8_t u8;
+    typedef uint32_t u32;
+    typedef int64_t i64;
+    typedef uint64_t u64;
+    using namespace NBT::Type;
+    using std::span, std::string_view, std::vector, std::istream, std::bit_cast, std::memcpy, std::format, NBT::Aux::readUVarInt, NBT::Aux::readIVarInt, NBT::IO::Readable, NBT::IO::FileReader, NBT::IO::StdIn, NBT::IO::SpanIn, NBT::IO::EOF_ERROR, NBT::IO::ReadLimits, NBT::Error::clearErrors, NBT::Error::pushError;
+
+    struct Entry {
+        //Type in the low byte, key offset in the rest.
+        u64 head;
+        u64 value;
+
+        [[nodiscard]] Types type() const noexcept { return static_cast<Types>(head & 0xFF); }
+        [[nodiscard]] u64 key() const noexcept { return head >> 8; }
+    };
+
+    struct Ref;
+
+    struct Document {
+        vector<Entry> tape;
+        vector<u8> arena;
+
+        //Keeps both buffers' capacity, so parsing into the same document again doesn't allocate.
+        void clear() noexcept {
+            tape.clear();
+            arena.assign(sizeof(u32), 0);
+        }
+
+        //The top-level object. Only valid after a successful parse.
+        [[nodiscard]] Ref root() const noexcept;
+    };
+
+    //A handle to one value on a tape. Cheap to copy, valid as long as the document is alive and not re-parsed.
+    //Accessors of the wrong type return zero or empty, lookups that miss return an invalid `Ref`.
+    struct Ref {
+        [[nodiscard]] Ref() noexcept = default;
+        [[nodiscard]] Ref(const Document* document, u64 index) noexcept : document_(document), index_(index) {}
+
+        [[nodiscard]] explicit operator bool() const noexcept { return document_ != nullptr; }
+        [[nodiscard]] bool operator==(const Ref&) const noexcept = default;
+
+        [[nodiscard]] Types type() const noexcept { return document_ == nullptr ? Types::ObjectEnd : entry().type(); }
+        //Empty for array elements.
+        [[nodiscard]] string_view key() const noexcept {
+            if (document_ == nullptr) return {};
+            u32 length = 0;
+            memcpy(&length, document_->arena.data() + entry().key(), sizeof(u32));
+            return {reinterpret_cast<const char*>(document_->arena.data()) + entry().key() + sizeof(u32), length};
+        }
+
+        //Iterates over the members of an object or the elements of an array.
+        struct Iterator {
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = Ref;
+            using difference_type = std::ptrdiff_t;
+
+            const Document* document;
+            u64 index;
+
+            [[nodiscard]] Ref operator*() const noexcept { return {document, index}; }
+            Iterator& operator++() noexcept {
+                const auto& current = document->tape[index];
+                index = current.type() == Types::Object || current.type() == Types::Array ? current.value + 1 : index + 1;
+                return *this;
+            }
+            Iterator operator++(int) noexcept {
+                auto result = *this;
+                ++*this;
+                return result;
+            }
+            [[nodiscard]] bool operator==(const Iterator& other) const noexcept { return index == other.index; }
+        };
+
+        [[nodiscard]] Iterator begin() const noexcept { return {document_, container() ? index_ + 1 : 0}; }
+        [[nodiscard]] Iterator end() const noexcept { return {document_, container() ? entry().value : 0}; }
+
+        //Members or elements, 0 for everything else. O(1): the count is kept on the end entry.
+        [[nodiscard]] u64 size() const noexcept { return container() ? document_->tape[entry().value].value : 0; }
+
+        //Linear in the number of members, but each step is a jump over the whole previous member.
+        //A key repeated at the top level, as `appendFile` leaves them, resolves to its last copy like in `readStream`;
+        //nested objects keep the first.
+        [[nodiscard]] Ref operator[](string_view name) const noexcept {
+            if (type() != Types::Object) return {};
+            Ref result;
+            for (const auto member : *this) if (member.key() == name) {
+                if (index_ != 0) return member;
+                result = member;
+            }
+            return result;
+        }
+
+        [[nodiscard]] Ref operator[](u64 index) const noexcept {
+            if (type() != Types::Array || index >= size()) return {};
+            auto it = begin();
+            for (u64 i = 0; i < index; i++) ++it;
+            return *it;
+        }
+
+        [[nodiscard]] i64 asIVarInt() const noexcept { return type() == Types::IVarInt ? static_cast<i64>(entry().value) : 0; }
+        [[nodiscard]] u64 asUVarInt() const noexcept { return type() == Types::UVarInt ? entry().value : 0; }
+        [[nodiscard]] bool asBool() const noexcept { return type() == Types::Bool && entry().value != 0; }
+        [[nodiscard]] u8 asHex() const noexcept { return type() == Types::Hex ? static_cast<u8>(entry().value) : 0; }
+        [[nodiscard]] float asFloat() const noexcept { return type() == Types::Float ? bit_cast<float>(static_cast<u32>(entry().value)) : 0.0f; }
+        [[nodiscard]] double asDouble() const noexcept { return type() == Types::Double ? bit_cast<double>(entry().value) : 0.0; }
+        [[nodiscard]] u8 asRaw() const noexcept { return type() == Types::Raw ? static_cast<u8>(entry().value) : 0; }
+        [[nodiscard]] string_view asString() const noexcept {
+            const auto bytes = payload<char>(Types::String);
+            return {bytes.data(), bytes.size()};
+        }
+        [[nodiscard]] span<const u8> asArrayBool() const noexcept { return payload<u8>(Types::ArrayBool); }
+        [[nodiscard]] span<const u8> asArrayHex() const noexcept { return payload<u8>(Types::ArrayHex); }
+        [[nodiscard]] span<const float> asArrayFloat() const noexcept { return payload<float>(Types::ArrayFloat); }
+        [[nodiscard]] span<const double> asArrayDouble() const noexcept { return payload<double>(Types::ArrayDouble); }
+        [[nodiscard]] span<const u8> asArrayRaw() const noexcept { return payload<u8>(Types::ArrayRaw); }
+
+    private:
+        const Document* document_{nullptr};
+        u64 index_{0};
+
+        [[nodiscard]] const Entry& entry() const noexcept { return document_->tape[index_]; }
+        [[nodiscard]] bool container() const noexcept { return type() == Types::Object || type() == Types::Array; }
+
+        template <typename T>
+        [[nodiscard]] span<const T> payload(Types expected) const noexcept {
+            if (type() != expected) return {};
+            u64 count = 0;
+            memcpy(&count, document_->arena.data() + entry().value, sizeof(u64));
+            return {reinterpret_cast<const T*>(document_->arena.data() + entry().value + sizeof(u64)), count};
+        }
+    };
+
+    inline Ref Document::root() const noexcept {
+        if (tape.empty()) return {};
+        return {this, 0};
+    }
+
+    namespace detail {
+        template <Readable S>
+        [[nodiscard]] inline bool value(FileReader<S>&, Document&, u8 head, u64 key) noexcept;
+
+        //Reads a key straight into the arena. Same conversions as `readVarText`: the text ends at the first `\0`.
+        template <Readable S>
+        [[nodiscard]] inline u64 key(FileReader<S>& cursor, Document& document) noexcept {
+            auto& arena = document.arena;
+            const u64 offset = arena.size();
+            arena.resize(offset + sizeof(u32));
+            while (!(*cursor & Aux::MSB)) {
+                arena.push_back(*cursor);
+                ++cursor;
+            }
+            arena.push_back(*cursor - Aux::MSB);
+            ++cursor;
+            const auto* const text = arena.data() + offset + sizeof(u32);
+            const auto* const end = static_cast<const u8*>(memchr(text, '\0', arena.size() - offset - sizeof(u32)));
+            const u32 length = static_cast<u32>(end != nullptr ? end - text : arena.size() - offset - sizeof(u32));
+            memcpy(arena.data() + offset, &length, sizeof(u32));
+            return offset;
+        }
+
+        //`u64` count, then `count * size` bytes read from the source, 8-byte aligned.
+        template <Readable S>
+        [[nodiscard]] inline bool payload(FileReader<S>& cursor, Document& document, u64 size, u8 mask, u64& offset) noexcept {
+            const u64 count = readUVarInt(cursor);
+            if (!IO::detail::admitArray(cursor, count, size, ReadLimits())) return false;
+            auto& arena = document.arena;
+            offset = (arena.size() + 7) & ~static_cast<u64>(7);
+            arena.resize(offset + sizeof(u64));
+            memcpy(arena.data() + offset, &count, sizeof(u64));
+            //Grown as the bytes actually arrive, so a bogus count in a short file can't reserve gigabytes up front.
+            u64 done = 0;
+            while (done < count * size) {
+                const u64 step = std::min<u64>(count * size - done, 1 << 20);
+                arena.resize(arena.size() + step);
+                if (cursor.getContent(arena.data() + arena.size() - step, step) < step) { pushError(EOF_ERROR); return false; }
+                done += step;
+            }
+            if (mask != 0xFF) for (u64 i = 0; i < count; i++) arena[offset + sizeof(u64) + i] &= mask;
+            return true;
+        }
+
+        template <Readable S>
+        [[nodiscard]] inline bool object(FileReader<S>& cursor, Document& document, u64 key, bool topLevel) noexcept {
+            auto& tape = document.tape;
+            const u64 start = tape.size();
+            tape.push_back({static_cast<u8>(Types::Object) | key << 8, 0});
+            u64 count = 0;
+            while (true) {
+                if (!cursor) {
+                    if (topLevel) break;
+                    pushError(EOF_ERROR);
+                    return false;
+                }
+                const u8 head = *cursor;
+                ++cursor;
+                if (getType(head) == Types::ObjectEnd) {
+                    if (!topLevel) break;
+                    pushError(format("Unexpected end of object at pos {}!", cursor.currentOffset() - 1));
+                    return false;
+                }
+                if (!value(cursor, document, head, detail::key(cursor, document))) return false;
+                count++;
+            }
+            tape[start].value = tape.size();
+            tape.push_back({static_cast<u8>(Types::ObjectEnd), count});
+            return true;
+        }
+
+        template <Readable S>
+        [[nodiscard]] inline bool array(FileReader<S>& cursor, Document& document, Types type, u64 key) noexcept {
+            auto& tape = document.tape;
+            const u64 start = tape.size();
+            tape.push_back({static_cast<u8>(Types::Array) | key << 8, 0});
+            const u64 count = readUVarInt(cursor);
+            //Every element takes a byte at least.
+            if (!IO::detail::admitArray(cursor, count, 1, ReadLimits())) return false;
+            for (u64 i = 0; i < count; i++) {
+                if (!cursor) { pushError(EOF_ERROR); return false; }
+                bool success = true;
+                switch (type) {
+                    case Types::Object:  success = object(cursor, document, 0, false); break;
+                    case Types::IVarInt:
+                    case Types::UVarInt:
+                    case Types::String:  success = value(cursor, document, getHead(type), 0); break;
+                    //Nested arrays carry their own head byte.
+                    case Types::Array: {
+                        const u8 head = *cursor;
+                        ++cursor;
+                        success = value(cursor, document, head, 0);
+                        break;
+                    }
+                    default: {
+                        pushError(format("Invalid second type {} at pos {}!", static_cast<u8>(type), cursor.currentOffset() - 1));
+                        return false;
+                    }
+                }
+                if (!success) return false;
+            }
+            tape[start].value = tape.size();
+            tape.push_back({static_cast<u8>(Types::ObjectEnd), count});
+            return true;
+        }
+
+        template <Readable S>
+        [[nodiscard]] inline bool value(FileReader<S>& cursor, Document& document, u8 head, u64 key) noexcept {
+            const auto type = getType(head);
+            u64 value = 0;
+            switch (type) {
+                case Types::Object:      return object(cursor, document, key, false);
+                case Types::Array:       return array(cursor, document, getSecondType(head), key);
+                case Types::IVarInt:     value = static_cast<u64>(readIVarInt(cursor)); break;
+                case Types::UVarInt:     value = readUVarInt(cursor); break;
+                case Types::Bool:        value = head & 0x01; break;
+                case Types::Hex:         value = head & 0x0F; break;
+                case Types::Raw:
+                case Types::Float:
+                case Types::Double: {
+                    const u64 size = type == Types::Raw ? 1 : type == Types::Float ? sizeof(float) : sizeof(double);
+                    u8 bytes[sizeof(u64)]{};
+                    if (cursor.getContent(bytes, size) < size) { pushError(EOF_ERROR); return false; }
+                    for (u64 i = 0; i < size; i++) value |= static_cast<u64>(bytes[i]) << i * 8;
+                    break;
+                }
+                case Types::String:
+                case Types::ArrayRaw:    if (!payload(cursor, document, 1, 0xFF, value)) return false; break;
+                case Types::ArrayBool:   if (!payload(cursor, document, 1, 0x01, value)) return false; break;
+                case Types::ArrayHex:    if (!payload(cursor, document, 1, 0x0F, value)) return false; break;
+                case Types::ArrayFloat:  if (!payload(cursor, document, sizeof(float), 0xFF, value)) return false; break;
+                case Types::ArrayDouble: if (!payload(cursor, document, sizeof(double), 0xFF, value)) return false; break;
+                default: {
+                    pushError(format("Invalid type ID {} at pos {}!", static_cast<u8>(type), cursor.currentOffset()));
+                    return false;
+                }
+            }
+            document.tape.push_back({static_cast<u8>(type) | key << 8, value});
+            return true;
+        }
+    }
+
+    //Parses a CGNBT stream (plain or zstd) onto `result`'s tape. On failure the document is left empty.
+    template <Readable S>
+    [[nodiscard]] inline bool readStream(S& source, Document& result) noexcept {
+        clearErrors();
+        result.clear();
+        FileReader<S> cursor(source);
+        if (!cursor) return false;
+        bool success = true;
+        if (cursor.empty()) {
+            result.tape.push_back({static_cast<u8>(Types::Object), 1});
+            result.tape.push_back({static_cast<u8>(Types::ObjectEnd), 0});
+        }
+        else success = detail::object(cursor, result, 0, true);
+        if (success && cursor.overrun()) {
+            pushError({.code = NBT::Error::Code::EndOfInput, .offset = cursor.currentOffset()});
+            success = false;
+        }
+        cursor.close();
+        if (!success) result.clear();
+        return success;
+    }
+
+    [[nodiscard]] inline bool readStream(istream& s, Document& result) noexcept {
+        StdIn adapter(s);
+        return readStream(adapter, result);
+    }
+
+    [[nodiscard]] inline bool readData(const span<const u8> data, Document& result) noexcept {
+        SpanIn adapter(data);
+        return readStream(adapter, result);
+    }
+}
\ No newline at end of file
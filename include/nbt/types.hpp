@@ -1,6 +1,7 @@
 #pragma once
 #include <array>
 #include <concepts>
+#include <cstring>
 #include <format>
 #include <limits>
 #include <string>
@@ -52,6 +53,18 @@ namespace NBT::Type {
 
     [[nodiscard]] inline constexpr Types getSecondType(u8 head) noexcept { return static_cast<Types>(head & 0x0F); }
 
+    //Inverse of `getType`. For generic `Array`s the second type still has to be or-ed in by the caller.
+    [[nodiscard]] inline constexpr u8 getHead(Types type) noexcept {
+        switch (type) {
+            case Types::ArrayBool:   return static_cast<u8>(Types::Array) << 4 | static_cast<u8>(Types::Bool);
+            case Types::ArrayHex:    return static_cast<u8>(Types::Array) << 4 | static_cast<u8>(Types::Hex);
+            case Types::ArrayFloat:  return static_cast<u8>(Types::Array) << 4 | static_cast<u8>(Types::Float);
+            case Types::ArrayDouble: return static_cast<u8>(Types::Array) << 4 | static_cast<u8>(Types::Double);
+            case Types::ArrayRaw:    return static_cast<u8>(Types::Array) << 4 | static_cast<u8>(Types::Raw);
+            default:                 return static_cast<u8>(type) << 4;
+        }
+    }
+
     [[nodiscard]] inline constexpr Types getOriginalType(Types type) noexcept {
         switch (type) {
             case Types::ArrayBool:
@@ -68,6 +81,21 @@ namespace NBT::Type {
     template <typename P> requires MapLike<P>
     struct Tag;
 
+    //Objects and arrays nested deeper than this are freed from a worklist rather than recursively, so destroying a tree
+    //takes a bounded amount of stack however deep it is.
+    inline constexpr u32 DESTROY_RECURSION_LIMIT = 64;
+
+    namespace detail {
+        //Container destructors running on this thread. A trivial type on purpose: static documents may be destroyed after
+        //the thread's other thread_locals.
+        inline thread_local u32 destroyDepth = 0;
+
+        template <typename P> requires MapLike<P>
+        inline void printMembers (const typename P::template map<string, Tag<P>>&, string&) noexcept;
+        template <typename P> requires MapLike<P>
+        inline void printElements(const vector<Tag<P>>&                           , string&) noexcept;
+    }
+
     template <typename P> requires MapLike<P>
     struct TagObject {
         static_assert(same_as<typename P::template map<string, Tag<P>>::value_type, pair<const string, Tag<P>>>, "TagObject's template parameter must be a MapLike Policy with string keys and Tag values!");
@@ -460,8 +488,16 @@ namespace NBT::Type {
                 default: return "<invalid type>";
             }
         }
+
+        //Structural equality. Object members are matched by key regardless of iteration order; floating point payloads are compared bitwise, so `NaN == NaN` and `0.0 != -0.0`.
+        [[nodiscard]] bool operator==(const Tag& other) const noexcept;
         
+        //Up to `DESTROY_RECURSION_LIMIT` levels down, containers free their children recursively; below that they `shelve` them.
         ~Tag() {
+            const bool nested = type == Types::Object || type == Types::Array;
+            const bool shelved = nested && detail::destroyDepth >= DESTROY_RECURSION_LIMIT;
+            if (shelved) shelve();
+            else if (nested) detail::destroyDepth++;
             switch (type) {
                 case Types::Object:      tagObject.~TagObject();           break;
                 case Types::IVarInt:     tagIVarInt.~TagIVarInt();         break;
@@ -480,37 +516,159 @@ namespace NBT::Type {
                 case Types::ArrayRaw:    tagArrayRaw.~TagArrayRaw();       break;
                 default:                                                   break;
             }
+            if (nested && !shelved) detail::destroyDepth--;
+        }
+
+    private:
+        [[nodiscard]] bool hasChildren() const noexcept {
+            return (type == Types::Object && !tagObject.payload.empty()) || (type == Types::Array && !tagArray.payload.empty());
+        }
+
+        //Moves the non-empty containers among this tag's children onto the worklist of the drain running further up, or
+        //starts one. A drain frees its worklist one tag at a time, each of which shelves its own children in turn, so the
+        //stack never grows past the recursion limit.
+        void shelve() noexcept {
+            static thread_local vector<Tag>* pending = nullptr;
+            vector<Tag> local;
+            const bool draining = pending == nullptr;
+            if (draining) pending = &local;
+            if (type == Types::Object) {
+                for (auto& [key, child] : tagObject.payload) if (child.hasChildren()) pending->push_back(move(child));
+            }
+            else for (auto& child : tagArray.payload) if (child.hasChildren()) pending->push_back(move(child));
+            if (!draining) return;
+            while (!local.empty()) {
+                Tag item = move(local.back());
+                local.pop_back();
+            }
+            pending = nullptr;
         }
     };
 
-    template <typename P> requires MapLike<P>
-    [[nodiscard]] inline string TagObject<P>::toString() const noexcept {
-        string result("{");
-        bool first = true;
-        for (const auto& [key, value] : payload) {
-            if (first) {
-                first = false;
-                result += "\"";
+    namespace detail {
+        //One open object or array of the iterative printer: the members or elements it has left.
+        template <typename P> requires MapLike<P>
+        struct PrintFrame {
+            typename P::template map<string, Tag<P>>::const_iterator member, end;
+            //Set for arrays.
+            const vector<Tag<P>>* elements{nullptr};
+            u64 index{0};
+        };
+
+        //Kept per thread, so printing allocates nothing but the result once it has been warmed up.
+        template <typename P> requires MapLike<P>
+        [[nodiscard]] inline vector<PrintFrame<P>>& printStack() noexcept {
+            static thread_local vector<PrintFrame<P>> result;
+            return result;
+        }
+
+        //Prints everything the frames above `base` have left, closing each one as it runs out. Objects and arrays found on
+        //the way are pushed rather than recursed into.
+        template <typename P> requires MapLike<P>
+        inline void print(vector<PrintFrame<P>>& stack, u64 base, string& result) noexcept {
+            while (stack.size() > base) {
+                auto& top = stack.back();
+                const Tag<P>* next;
+                if (top.elements == nullptr) {
+                    if (top.member == top.end) {
+                        result += "}";
+                        stack.pop_back();
+                        continue;
+                    }
+                    result += top.index++ == 0 ? "\"" : ", \"";
+                    result += top.member->first;
+                    result += "\": ";
+                    next = &top.member->second;
+                    ++top.member;
+                }
+                else {
+                    if (top.index == top.elements->size()) {
+                        result += "]";
+                        stack.pop_back();
+                        continue;
+                    }
+                    if (top.index != 0) result += ", ";
+                    next = &(*top.elements)[top.index++];
+                }
+                if (next->type == Types::Object) {
+                    result += "{";
+                    stack.push_back({next->tagObject.payload.begin(), next->tagObject.payload.end()});
+                }
+                else if (next->type == Types::Array) {
+                    result += "[";
+                    stack.push_back({{}, {}, &next->tagArray.payload});
+                }
+                else result += next->toString();
             }
-            else result += ", \"";
-            result += key;
-            result += "\": ";
-            result += value.toString();
         }
-        result += "}";
+
+        template <typename P> requires MapLike<P>
+        inline void printMembers(const typename P::template map<string, Tag<P>>& members, string& result) noexcept {
+            auto& stack = printStack<P>();
+            const u64 base = stack.size();
+            result += "{";
+            stack.push_back({members.begin(), members.end()});
+            print(stack, base, result);
+        }
+
+        template <typename P> requires MapLike<P>
+        inline void printElements(const vector<Tag<P>>& elements, string& result) noexcept {
+            auto& stack = printStack<P>();
+            const u64 base = stack.size();
+            result += "[";
+            stack.push_back({{}, {}, &elements});
+            print(stack, base, result);
+        }
+    }
+
+    template <typename P> requires MapLike<P>
+    [[nodiscard]] inline string TagObject<P>::toString() const noexcept {
+        string result;
+        detail::printMembers<P>(payload, result);
         return result;
     }
 
     template <typename P> requires MapLike<P>
     [[nodiscard]] inline string TagArray<P>::toString() const noexcept {
-        string result("[");
-        bool first = true;
-        for (const auto& value : payload) {
-            if (first) first = false;
-            else result += ", ";
-            result += value.toString();
-        }
-        result += "]";
+        string result;
+        detail::printElements<P>(payload, result);
         return result;
     }
+
+    namespace detail {
+        template <typename T>
+        [[nodiscard]] inline bool samePayload(const vector<T>& a, const vector<T>& b) noexcept { return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0); }
+        template <typename T>
+        [[nodiscard]] inline bool samePayload(const T& a, const T& b) noexcept { return std::memcmp(&a, &b, sizeof(T)) == 0; }
+    }
+
+    template <typename P> requires MapLike<P>
+    [[nodiscard]] inline bool Tag<P>::operator==(const Tag& other) const noexcept {
+        if (type != other.type) return false;
+        switch (type) {
+            case Types::Object: {
+                if (tagObject.payload.size() != other.tagObject.payload.size()) return false;
+                for (const auto& [key, value] : tagObject.payload) {
+                    const auto it = other.tagObject.payload.find(key);
+                    if (it == other.tagObject.payload.end() || !(value == it->second)) return false;
+                }
+                return true;
+            }
+            case Types::Array:       return tagArray.payload == other.tagArray.payload;
+            case Types::IVarInt:     return tagIVarInt.payload == other.tagIVarInt.payload;
+            case Types::UVarInt:     return tagUVarInt.payload == other.tagUVarInt.payload;
+            case Types::Bool:        return tagBool.payload == other.tagBool.payload;
+            case Types::Hex:         return tagHex.payload == other.tagHex.payload;
+            case Types::Float:       return detail::samePayload(tagFloat.payload, other.tagFloat.payload);
+            case Types::Double:      return detail::samePayload(tagDouble.payload, other.tagDouble.payload);
+            case Types::String:      return tagString.payload == other.tagString.payload;
+            case Types::Raw:         return tagRaw.payload == other.tagRaw.payload;
+            case Types::ArrayBool:   return detail::samePayload(tagArrayBool.payload, other.tagArrayBool.payload);
+            case Types::ArrayHex:    return detail::samePayload(tagArrayHex.payload, other.tagArrayHex.payload);
+            case Types::ArrayFloat:  return detail::samePayload(tagArrayFloat.payload, other.tagArrayFloat.payload);
+            case Types::ArrayDouble: return detail::samePayload(tagArrayDouble.payload, other.tagArrayDouble.payload);
+            case Types::ArrayRaw:    return detail::samePayload(tagArrayRaw.payload, other.tagArrayRaw.payload);
+            default:                 return true;
+        }
+    }
 }
\ No newline at end of file
@@ -1,8 +1,21 @@
 #pragma once
 #include <cstdint>
+#include <string_view>
 
 namespace NBT::Utils {
     typedef uint8_t u8;
+    typedef uint64_t u64;
+    using std::string_view;
+
+    //64-bit FNV-1a. `constexpr` so that keys known at compile time can be hashed once, at compile time.
+    [[nodiscard]] inline constexpr u64 hashKey(string_view key) noexcept {
+        u64 result = 0xCBF29CE484222325;
+        for (const char c : key) {
+            result ^= static_cast<u8>(c);
+            result *= 0x100000001B3;
+        }
+        return result;
+    }
 
     //Why are we returning `const char*` instead of `char`: It's more convenient to convert to `string`.
     [[nodiscard]] inline constexpr const char* hexToString(u8 data) noexcept {
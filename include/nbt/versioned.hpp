@@ -0,0 +1,89 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include "mapLike.hpp"
+#include "shared.hpp"
+#include "types.hpp"
+
+namespace NBT::Shared {
+    typedef uint64_t u64;
+    using std::atomic, std::shared_ptr, std::make_shared, std::mutex, std::lock_guard, std::move, NBT::MapLike::MapLike;
+
+    //A document published to many reader threads. Every version is an immutable `Node`; `update` edits a copy, which shares
+    //everything it doesn't touch with the previous version, and publishes it with one atomic store.
+    //Readers go through a `Reader`, whose `get` is a single atomic load of the version number as long as nothing was
+    //published since its last call, so readers never wait for each other or for the writer. A version is reclaimed when the
+    //last `Reader` or handle referring to it has moved on, through the reference counts of its boxes.
+    //Writers are serialized among themselves.
+    template <typename P> requires MapLike<P>
+    class Versioned {
+    public:
+        using Snapshot = shared_ptr<const Node<P>>;
+
+        [[nodiscard]] explicit Versioned(Node<P> initial = Node<P>(typename Node<P>::Members())) noexcept : current_(make_shared<const Node<P>>(move(initial))) {}
+        Versioned(const Versioned&) = delete;
+        Versioned& operator=(const Versioned&) = delete;
+
+        //The latest version. Takes a short internal lock of the standard library's `atomic<shared_ptr>`; prefer a `Reader` on hot paths.
+        [[nodiscard]] Snapshot snapshot() const noexcept { return current_.load(std::memory_order_acquire); }
+        //Starts at 0 and grows by one per publication.
+        [[nodiscard]] u64 version() const noexcept { return version_.load(std::memory_order_acquire); }
+
+        //Replaces the document as a whole.
+        void publish(Node<P> next) noexcept {
+            lock_guard lock(writer_);
+            store(move(next));
+        }
+
+        //Calls `edit` on a copy of the latest version and publishes the result. Edits go through `mut`, which clones just
+        //the boxes on the edited paths. Returning false from `edit` discards the copy.
+        template <typename F>
+        bool update(F&& edit) noexcept {
+            lock_guard lock(writer_);
+            Node<P> next = *current_.load(std::memory_order_acquire);
+            if (!edit(next)) return false;
+            store(move(next));
+            return true;
+        }
+
+        //Per-thread view of a `Versioned`. Not to be shared between threads, and not to outlive its source.
+        class Reader {
+        public:
+            [[nodiscard]] explicit Reader(const Versioned& source) noexcept : source_(&source) { refresh(); }
+
+            //The latest version. The reference stays valid until the next `get` or `refresh` on this reader.
+            [[nodiscard]] const Node<P>& get() noexcept {
+                if (source_->version_.load(std::memory_order_acquire) != version_) refresh();
+                return *snapshot_;
+            }
+
+            //The version `get` returned last, kept alive by this reader.
+            [[nodiscard]] const Snapshot& snapshot() const noexcept { return snapshot_; }
+            [[nodiscard]] u64 version() const noexcept { return version_; }
+
+            void refresh() noexcept {
+                //Version first: if a publication lands in between, the next `get` just refreshes again.
+                version_ = source_->version_.load(std::memory_order_acquire);
+                snapshot_ = source_->snapshot();
+            }
+
+        private:
+            const Versioned* source_;
+            Snapshot snapshot_;
+            u64 version_{0};
+        };
+
+    private:
+        atomic<Snapshot> current_;
+        atomic<u64> version_{0};
+        mutex writer_;
+
+        void store(Node<P>&& next) noexcept {
+            current_.store(make_shared<const Node<P>>(move(next)), std::memory_order_release);
+            version_.fetch_add(1, std::memory_order_acq_rel);
+        }
+    };
+}
\ No newline at end of file
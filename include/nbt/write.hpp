@@ -14,12 +14,15 @@
 
 namespace NBT::IO {
     typedef uint8_t u8;
+    typedef uint32_t u32;
     typedef uint64_t u64;
     using namespace NBT::Type;
     using std::array, std::vector, std::format, std::ostream, NBT::Aux::writeVarText, NBT::Aux::writeIVarInt, NBT::Aux::writeUVarInt, NBT::Error::clearErrors, NBT::Error::pushError, NBT::MapLike::MapLike;
 
     template <typename P> requires MapLike<P>
     [[nodiscard]] inline bool writeObject     (const TagObject<P>& , vector<u8>&) noexcept;
+    template <typename P> requires MapLike<P>
+    [[nodiscard]] inline bool writeMember     (const string&, const Tag<P>&, vector<u8>&) noexcept;
                   inline void writeIVarInt    (const TagIVarInt&     , vector<u8>&) noexcept;
                   inline void writeUVarInt    (const TagUVarInt&     , vector<u8>&) noexcept;
                   inline void writeBool       (const TagBool&        , vector<u8>&) noexcept;
@@ -38,21 +41,175 @@ namespace NBT::IO {
 
     inline constexpr array<u8, 5> MAGIC = {'c', 'G', 'n', 'b', 'T'};
 
+    namespace detail {
+        //One open object or array of the iterative writer: the members or elements it has left.
+        template <typename P> requires MapLike<P>
+        struct WriteFrame {
+            typename P::template map<string, Tag<P>>::const_iterator member, end;
+            //Set for arrays.
+            const vector<Tag<P>>* elements{nullptr};
+            u64 index{0};
+            //Objects written as a member or an element end with `ObjectEnd`, the level a write starts on doesn't.
+            bool closes{false};
+        };
+
+        //Kept per thread, so nesting costs no allocations once it has been warmed up.
+        template <typename P> requires MapLike<P>
+        [[nodiscard]] inline vector<WriteFrame<P>>& writeStack() noexcept {
+            static thread_local vector<WriteFrame<P>> result;
+            return result;
+        }
+
+        //Empty arrays still need some second type in their head.
+        template <typename P> requires MapLike<P>
+        [[nodiscard]] inline Types secondType(const TagArray<P>& data) noexcept { return data.payload.empty() ? Types::Object : data.payload[0].type; }
+
+        //Everything after the head byte up to the first element: the count, after which the elements get a frame of their own.
+        template <typename P> requires MapLike<P>
+        inline void openArray(const TagArray<P>& data, vector<WriteFrame<P>>& stack, vector<u8>& result) noexcept {
+            writeUVarInt(data.payload.size(), result);
+            stack.push_back({{}, {}, &data.payload});
+        }
+
+        //Writes everything the frames above `base` have left. Objects and arrays found on the way are pushed rather than
+        //recursed into, so the depth of the document only costs heap. The stack is back at `base` when this returns.
+        template <typename P> requires MapLike<P>
+        [[nodiscard]] inline bool write(vector<WriteFrame<P>>& stack, u64 base, vector<u8>& result) noexcept {
+            while (stack.size() > base) {
+                auto& top = stack.back();
+                if (top.elements == nullptr) {
+                    if (top.member == top.end) {
+                        if (top.closes) result.push_back(static_cast<u8>(Types::ObjectEnd));
+                        stack.pop_back();
+                        continue;
+                    }
+                    const auto& [key, value] = *top.member;
+                    ++top.member;
+                    if (value.type == Types::Object) {
+                        result.push_back(static_cast<u8>(Types::Object) << 4);
+                        writeVarText(key, result);
+                        stack.push_back({value.tagObject.payload.begin(), value.tagObject.payload.end(), nullptr, 0, true});
+                    }
+                    else if (value.type == Types::Array) {
+                        result.push_back(static_cast<u8>(Types::Array) << 4 | static_cast<u8>(getOriginalType(secondType(value.tagArray))));
+                        writeVarText(key, result);
+                        openArray(value.tagArray, stack, result);
+                    }
+                    else if (!writeMember(key, value, result)) break;
+                    continue;
+                }
+                const auto& elements = *top.elements;
+                if (top.index == elements.size()) {
+                    stack.pop_back();
+                    continue;
+                }
+                switch (elements[0].type) {
+                    case Types::Object: {
+                        const auto& members = elements[top.index++].tagObject.payload;
+                        stack.push_back({members.begin(), members.end(), nullptr, 0, true});
+                        continue;
+                    }
+                    case Types::Array: {
+                        const auto& nested = elements[top.index++].tagArray;
+                        result.push_back(static_cast<u8>(Types::Array) << 4 | static_cast<u8>(getOriginalType(secondType(nested))));
+                        openArray(nested, stack, result);
+                        continue;
+                    }
+                    case Types::IVarInt: {
+                        for (; top.index < elements.size(); top.index++) writeIVarInt(elements[top.index].tagIVarInt, result);
+                        continue;
+                    }
+                    case Types::UVarInt: {
+                        for (; top.index < elements.size(); top.index++) writeUVarInt(elements[top.index].tagUVarInt, result);
+                        continue;
+                    }
+                    case Types::String: {
+                        for (; top.index < elements.size(); top.index++) writeString(elements[top.index].tagString, result);
+                        continue;
+                    }
+                    case Types::ArrayBool: {
+                        for (; top.index < elements.size(); top.index++) {
+                            result.push_back(static_cast<u8>(Types::Array) << 4 | static_cast<u8>(Types::Bool));
+                            writeArrayBool(elements[top.index].tagArrayBool, result);
+                        }
+                        continue;
+                    }
+                    case Types::ArrayHex: {
+                        for (; top.index < elements.size(); top.index++) {
+                            result.push_back(static_cast<u8>(Types::Array) << 4 | static_cast<u8>(Types::Hex));
+                            writeArrayHex(elements[top.index].tagArrayHex, result);
+                        }
+                        continue;
+                    }
+                    case Types::ArrayFloat: {
+                        for (; top.index < elements.size(); top.index++) {
+                            result.push_back(static_cast<u8>(Types::Array) << 4 | static_cast<u8>(Types::Float));
+                            writeArrayFloat(elements[top.index].tagArrayFloat, result);
+                        }
+                        continue;
+                    }
+                    case Types::ArrayDouble: {
+                        for (; top.index < elements.size(); top.index++) {
+                            result.push_back(static_cast<u8>(Types::Array) << 4 | static_cast<u8>(Types::Double));
+                            writeArrayDouble(elements[top.index].tagArrayDouble, result);
+                        }
+                        continue;
+                    }
+                    case Types::ArrayRaw: {
+                        for (; top.index < elements.size(); top.index++) {
+                            result.push_back(static_cast<u8>(Types::Array) << 4 | static_cast<u8>(Types::Raw));
+                            writeArrayRaw(elements[top.index].tagArrayRaw, result);
+                        }
+                        continue;
+                    }
+                    default: {
+                        pushError(format("Invalid second type {} in array! For fixed-size types (`bool 4`, `hex 5`, `float 6`, `double 7`, `raw 10`), please use dedicated array types.", static_cast<u8>(elements[0].type)));
+                        break;
+                    }
+                }
+                break;
+            }
+            const bool success = stack.size() == base;
+            stack.resize(base);
+            return success;
+        }
+
+        template <typename P> requires MapLike<P>
+        [[nodiscard]] inline bool writeMembers(const typename P::template map<string, Tag<P>>& members, vector<u8>& result) noexcept {
+            auto& stack = writeStack<P>();
+            const u64 base = stack.size();
+            stack.push_back({members.begin(), members.end()});
+            return write(stack, base, result);
+        }
+    }
+
     template <typename P> requires MapLike<P>
     [[nodiscard]] inline bool writeData(const typename P::template map<string, Tag<P>>& data, vector<u8>& result, bool addMagic = false) noexcept {
         clearErrors();
         if (addMagic) result.insert(result.end(), MAGIC.begin(), MAGIC.end());
-        TagObject<P> obj{data};
-        return writeObject(obj, result);
+        return detail::writeMembers<P>(data, result);
     }
 
-    template<typename P, Writable W> requires MapLike<P>
-    [[nodiscard]] inline bool writeStream(W& dest, const typename P::template map<string, Tag<P>>& data, bool zstd = false, u8 compressionLevel = 3) noexcept {
-        vector<u8> result;
-        if (!writeData<P>(data, result, !zstd)) return false;
+    //Shared tail of the buffered writers: optional zstd pass over `result`, then a single `writeBlock`.
+    //`workers > 0` asks zstd to compress on that many threads of its own; it is ignored when zstd was built without threading.
+    template<Writable W>
+    [[nodiscard]] inline bool emitBuffer(W& dest, const vector<u8>& result, bool zstd, u8 compressionLevel, u32 workers = 0) noexcept {
         if (zstd) {
+            const int level = compressionLevel > 22 ? 22 : compressionLevel == 0 ? 1 : compressionLevel;
             vector<u8> compressed(ZSTD_compressBound(result.size()));
-            const auto sz = ZSTD_compress(compressed.data(), compressed.size(), result.data(), result.size(), compressionLevel > 22 ? 22 : compressionLevel == 0 ? 1 : compressionLevel);
+            size_t sz;
+            if (workers == 0) sz = ZSTD_compress(compressed.data(), compressed.size(), result.data(), result.size(), level);
+            else {
+                ZSTD_CCtx* const context = ZSTD_createCCtx();
+                if (context == nullptr) {
+                    pushError("Failed to create a ZSTD compression context!");
+                    return false;
+                }
+                ZSTD_CCtx_setParameter(context, ZSTD_c_compressionLevel, level);
+                ZSTD_CCtx_setParameter(context, ZSTD_c_nbWorkers, static_cast<int>(workers));
+                sz = ZSTD_compress2(context, compressed.data(), compressed.size(), result.data(), result.size());
+                ZSTD_freeCCtx(context);
+            }
             if (ZSTD_isError(sz)) {
                 pushError(format("ZSTD compression error: {}", ZSTD_getErrorName(sz)));
                 return false;
@@ -70,15 +227,26 @@ namespace NBT::IO {
         return true;
     }
 
+    template<typename P, Writable W> requires MapLike<P>
+    [[nodiscard]] inline bool writeStream(W& dest, const typename P::template map<string, Tag<P>>& data, bool zstd = false, u8 compressionLevel = 3) noexcept {
+        vector<u8> result;
+        if (!writeData<P>(data, result, !zstd)) return false;
+        return emitBuffer(dest, result, zstd, compressionLevel);
+    }
+
     template <typename P> requires MapLike<P>
     [[nodiscard]] inline bool writeStream(ostream& s, const typename P::template map<string, Tag<P>>& data, bool zstd = false, u8 compressionLevel = 3) noexcept {
         StdOut adapter(s);
         return writeStream<P>(adapter, data, zstd, compressionLevel);
     }
 
+    //Members only; the caller adds `ObjectEnd` where one is due.
+    template <typename P> requires MapLike<P>
+    [[nodiscard]] inline bool writeObject(const TagObject<P>& data, vector<u8>& result) noexcept { return detail::writeMembers<P>(data.payload, result); }
+
     template <typename P> requires MapLike<P>
-    [[nodiscard]] inline bool writeObject(const TagObject<P>& data, vector<u8>& result) noexcept {
-        for(const auto& [key, value] : data.payload) switch(value.type) {
+    [[nodiscard]] inline bool writeMember(const string& key, const Tag<P>& value, vector<u8>& result) noexcept {
+        switch(value.type) {
             case Types::Object: {
                 result.push_back(static_cast<u8>(Types::Object) << 4);
                 writeVarText(key, result);
@@ -121,7 +289,7 @@ namespace NBT::IO {
                 break;
             }
             case Types::Array: {
-                result.push_back((static_cast<u8>(Types::Array) << 4) | static_cast<u8>(getOriginalType(value.tagArray.payload[0].type)));
+                result.push_back((static_cast<u8>(Types::Array) << 4) | static_cast<u8>(getOriginalType(detail::secondType(value.tagArray))));
                 writeVarText(key, result);
                 if (!writeArray(value.tagArray, result)) return false;
                 break;
@@ -196,75 +364,10 @@ namespace NBT::IO {
 
     template <typename P> requires MapLike<P>
     [[nodiscard]] inline bool writeArray(const TagArray<P>& data, vector<u8>& result) noexcept {
-        writeUVarInt(data.payload.size(), result);
-        if(!data.payload.empty()) switch (data.payload[0].type) {
-            case Types::Object: {
-                for(u64 i = 0; i < data.payload.size(); i++) {
-                    if (!writeObject(data.payload[i].tagObject, result)) return false;
-                    result.push_back(static_cast<u8>(Types::ObjectEnd));
-                }
-                break;
-            }
-            case Types::IVarInt: {
-                for(u64 i = 0; i < data.payload.size(); i++) writeIVarInt(data.payload[i].tagIVarInt, result);
-                break;
-            }
-            case Types::UVarInt: {
-                for(u64 i = 0; i < data.payload.size(); i++) writeUVarInt(data.payload[i].tagUVarInt, result);
-                break;
-            }
-            case Types::Array: {
-                for (u64 i = 0; i < data.payload.size(); i++) {
-                    result.push_back(static_cast<u8>(Types::Array) << 4 | static_cast<u8>(data.payload[i].tagArray.payload[0].type));
-                    if (!writeArray(data.payload[i].tagArray, result)) return false;
-                }
-                break;
-            }
-            case Types::String: {
-                for(u64 i = 0; i < data.payload.size(); i++) writeString(data.payload[i].tagString, result);
-                break;
-            }
-            case Types::ArrayBool: {
-                for (u64 i = 0; i < data.payload.size(); i++) {
-                    result.push_back(static_cast<u8>(Types::Array) << 4 | static_cast<u8>(Types::Bool));
-                    writeArrayBool(data.payload[i].tagArrayBool, result);
-                }
-                break;
-            }
-            case Types::ArrayHex: {
-                for (u64 i = 0; i < data.payload.size(); i++) {
-                    result.push_back(static_cast<u8>(Types::Array) << 4 | static_cast<u8>(Types::Hex));
-                    writeArrayHex(data.payload[i].tagArrayHex, result);
-                }
-                break;
-            }
-            case Types::ArrayFloat: {
-                for (u64 i = 0; i < data.payload.size(); i++) {
-                    result.push_back(static_cast<u8>(Types::Array) << 4 | static_cast<u8>(Types::Float));
-                    writeArrayFloat(data.payload[i].tagArrayFloat, result);
-                }
-                break;
-            }
-            case Types::ArrayDouble: {
-                for (u64 i = 0; i < data.payload.size(); i++) {
-                    result.push_back(static_cast<u8>(Types::Array) << 4 | static_cast<u8>(Types::Double));
-                    writeArrayDouble(data.payload[i].tagArrayDouble, result);
-                }
-                break;
-            }
-            case Types::ArrayRaw: {
-                for (u64 i = 0; i < data.payload.size(); i++) {
-                    result.push_back(static_cast<u8>(Types::Array) << 4 | static_cast<u8>(Types::Raw));
-                    writeArrayRaw(data.payload[i].tagArrayRaw, result);
-                }
-                break;
-            }
-            default: {
-                pushError(format("Invalid second type {} in array! For fixed-size types (`bool 4`, `hex 5`, `float 6`, `double 7`, `raw 10`), please use dedicated array types.", static_cast<u8>(data.payload[0].type)));
-                return false;
-            }
-        }
-        return true;
+        auto& stack = detail::writeStack<P>();
+        const u64 base = stack.size();
+        detail::openArray(data, stack, result);
+        return detail::write(stack, base, result);
     }
 
     inline void writeString(const TagString& data, vector<u8>& result) noexcept {
@@ -1,18 +1,62 @@
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+#include <thread>
+#include <tuple>
 #include <unordered_map>
 #include <vector>
 #ifdef _WIN32
+    #include <fcntl.h>
+    #include <io.h>
     #include <Windows.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
 #endif // _WIN32
 
 #include <nbt/nbt.hpp>
 
 typedef uint8_t u8;
+typedef int64_t i64;
+typedef uint64_t u64;
 using namespace NBT;
-using std::cout, std::endl, std::string, std::ifstream, std::ofstream, std::ios, std::vector, std::chrono::steady_clock, std::chrono::duration_cast, std::chrono::microseconds, std::unordered_map;
+using std::cout, std::endl, std::string, std::ifstream, std::ofstream, std::ostringstream, std::ios, std::vector, std::chrono::steady_clock, std::chrono::duration_cast, std::chrono::microseconds, std::unordered_map, std::equal;
 CGNBT_USE_MAP_CONTAINER(unordered_map, Map, Policy)
+CGNBT_USE_MAP_CONTAINER(HashedMap, FastMap, FastPolicy)
+CGNBT_USE_MAP_CONTAINER(std::map, OrderedMap, OrderedPolicy)
+
+struct Item {
+    string id;
+    u64 count{0};
+};
+CGNBT_FIELDS(Item, id, count)
+
+struct Player {
+    string name;
+    i64 hp{0};
+    bool online{false};
+    vector<double> pos;
+    vector<Item> inventory;
+};
+CGNBT_FIELDS(Player, name, hp, online, pos, inventory)
+
+//Every allocation of the process, for the allocation checks.
+static std::atomic<u64> allocations{0};
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* result = std::malloc(size == 0 ? 1 : size)) return result;
+    throw std::bad_alloc();
+}
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+void operator delete(void* pointer, size_t) noexcept { std::free(pointer); }
 
 int main() {
 
@@ -40,6 +84,27 @@ int main() {
     }
 }
 
+{
+    cout << "========Reading NBT Onto a Tape========" << endl;
+    Tape::Document document;
+    Map tree;
+    ifstream f("../../../tests/a.cgb", ios::binary);
+    auto start = steady_clock::now();
+    if (Tape::readStream(f, document)) {
+        auto end = steady_clock::now();
+        cout << "Parse took " << duration_cast<microseconds>(end - start).count() << "us, " << document.tape.size() << " entries" << endl;
+        ifstream g("../../../tests/a.cgb", ios::binary);
+        u64 members = 0;
+        if (readStream<Policy>(g, tree)) for (const auto member : document.root()) members += tree.contains(string(member.key()));
+        if (document.root().size() == tree.size() && members == tree.size()) cout << "========Test Completed========" << endl;
+    }
+    else {
+        cout << "Parse failed! Errors:" << endl;
+        auto errors = getErrors();
+        for (const auto& error : errors) cout << error << endl;
+    }
+}
+
 {
     cout << "========Writing NBT to File========" << endl;
     Map writeTest;
@@ -109,6 +174,888 @@ int main() {
         auto errors = getErrors();
         for(const auto& error : errors) cout << error << endl;
     }
+
+    cout << "========Vectored Writing========" << endl;
+    writeTest.emplace("A big array of doubles", TagArrayDouble(vector<double>(4096, 0.125)));
+    vector<u8> copied;
+    ostringstream vectored(ios::binary);
+    if (writeData<Policy>(writeTest, copied, true) && writeStreamVectored<Policy>(vectored, writeTest)) {
+        const auto bytes = vectored.str();
+        cout << (bytes.size() == copied.size() && equal(bytes.begin(), bytes.end(), copied.begin(), [](char a, u8 b) { return static_cast<u8>(a) == b; })) << endl;
+        cout << "========Test Completed========" << endl;
+    }
+    else {
+        cout << "Write failed! Errors:" << endl;
+        auto errors = getErrors();
+        for(const auto& error : errors) cout << error << endl;
+    }
+}
+
+{
+    cout << "========Parallel Writing========" << endl;
+    Parallel::Pool pool(4);
+    Map document, world;
+    for (u64 i = 0; i < 80; i++) {
+        Map chunk;
+        chunk.emplace("x", TagIVarInt(static_cast<i64>(i)));
+        chunk.emplace("blocks", TagArrayRaw(vector<u8>(2000, static_cast<u8>(i))));
+        world.emplace(std::format("chunk{}", i), TagObject<Policy>(chunk));
+    }
+    vector<Tag<Policy>> entities;
+    for (u64 i = 0; i < 1000; i++) {
+        Map entity;
+        entity.emplace("id", TagUVarInt(i));
+        entity.emplace("name", TagString(std::format("zombie {}", i)));
+        entity.emplace("pos", TagArrayDouble(vector<double>{1.0 * i, 64.0, -1.0 * i}));
+        entities.push_back(TagObject<Policy>(std::move(entity)));
+    }
+    document.emplace("world", TagObject<Policy>(std::move(world)));
+    document.emplace("entities", TagArray<Policy>(std::move(entities)));
+    document.emplace("seed", TagIVarInt(-42));
+    vector<u8> sequential, parallel, framed;
+    ostringstream streamed(ios::binary), compressed(ios::binary);
+    if (writeData<Policy>(document, sequential) && writeDataParallel<Policy>(document, parallel, pool) && writeData<Policy>(document, framed, true)
+        && writeStreamParallel<Policy>(streamed, document, pool) && writeStreamParallel<Policy>(compressed, document, pool, true)) {
+        const auto bytes = streamed.str();
+        std::istringstream input(compressed.str(), ios::binary);
+        Map decoded;
+        const bool streamedSame = bytes.size() == framed.size() && equal(bytes.begin(), bytes.end(), framed.begin(), [](char a, u8 b) { return static_cast<u8>(a) == b; });
+        cout << "bytes: " << sequential.size() << ", identical: " << (parallel == sequential) << ", streamed: " << streamedSame << endl;
+        if (parallel == sequential && streamedSame && readStream<Policy>(input, decoded) && decoded == document) cout << "========Test Completed========" << endl;
+        else cout << "Parallel encoding differs!" << endl;
+    }
+    else {
+        cout << "Parallel write failed! Errors:" << endl;
+        auto errors = getErrors();
+        for (const auto& error : errors) cout << error << endl;
+    }
+}
+
+{
+    cout << "========Streaming Builder========" << endl;
+    vector<u8> bytes;
+    Builder builder(bytes, true);
+    const vector<double> position({ 12.5, 64.0, -3.25 });
+    builder.writeString("name", "Steve").writeIVarInt("hp", 20).writeArrayDouble("pos", position)
+        .beginArray("inventory", Types::Object, 2)
+            .beginObject().writeString("id", "stone").writeUVarInt("count", 64).endObject()
+            .beginObject().writeString("id", "torch").writeUVarInt("count", 0).endObject()
+        .endArray();
+    Map result;
+    if (builder.finish() && readData<Policy>(bytes, result)) {
+        cout << serialize<Policy>(result) << endl;
+        cout << "========Test Completed========" << endl;
+    }
+    else {
+        cout << "Build failed! Errors:" << endl;
+        auto errors = getErrors();
+        for (const auto& error : errors) cout << error << endl;
+    }
+}
+
+{
+    cout << "========Reflection Binding========" << endl;
+    const Player player{ "Steve", 20, true, { 12.5, 64.0, -3.25 }, { { "stone", 64 }, { "torch", 0 } } };
+    vector<u8> bytes;
+    Reflect::writeData(player, bytes, true);
+    Map result;
+    Player parsed;
+    if (readData<Policy>(bytes, result) && Reflect::readData(bytes, parsed) && parsed.inventory.size() == 2 && parsed.inventory[0].count == 64 && parsed.pos == player.pos) {
+        cout << serialize<Policy>(result) << endl;
+        cout << "========Test Completed========" << endl;
+    }
+    else {
+        cout << "Reflection failed! Errors:" << endl;
+        auto errors = getErrors();
+        for (const auto& error : errors) cout << error << endl;
+    }
+}
+
+{
+    cout << "========Compile-time Keys========" << endl;
+    FastMap source, result;
+    source.emplace("position", TagArrayDouble(vector<double>({ 12.5, 64.0, -3.25 })));
+    source.emplace("hp", TagIVarInt(20));
+    vector<u8> bytes;
+    if (writeData<FastPolicy>(source, bytes, true) && readData<FastPolicy>(bytes, result)) {
+        const auto* position = get<"position", Types::ArrayDouble, FastPolicy>(result);
+        const auto* hp = get<"hp", Types::IVarInt, FastPolicy>(result);
+        if (position != nullptr && hp != nullptr && get<"hp", Types::String, FastPolicy>(result) == nullptr) {
+            cout << "position: " << position->size() << " doubles, hp: " << *hp << endl;
+            cout << "========Test Completed========" << endl;
+        }
+    }
+    else {
+        cout << "Lookup failed! Errors:" << endl;
+        auto errors = getErrors();
+        for (const auto& error : errors) cout << error << endl;
+    }
+}
+
+{
+    cout << "========Zero-copy Access========" << endl;
+    Map members;
+    members.emplace("position", TagArrayDouble(vector<double>({ 12.5, 64.0, -3.25 })));
+    members.emplace("name", TagString("Steve"));
+    members.emplace("hp", TagIVarInt(20));
+    const auto position = memberSpan<Types::ArrayDouble, Policy>(members, "position");
+    const auto [name, hp, missing] = extract<Policy, Member<"name", Types::String>, Member<"hp", Types::IVarInt>, Member<"mana", Types::IVarInt>>(members);
+    if (position.data() == members.at("position").tagArrayDouble.payload.data() && memberView<Policy>(members, "name") == "Steve" && name != nullptr && hp != nullptr && missing == nullptr) {
+        cout << *name << ": " << *hp << " hp at y = " << position[1] << endl;
+        cout << "========Test Completed========" << endl;
+    }
+    else cout << "Zero-copy access failed!" << endl;
+}
+
+{
+    cout << "========Path Queries========" << endl;
+    Map stone, torch, entity, document;
+    stone.emplace("id", TagString("stone"));
+    torch.emplace("id", TagString("torch"));
+    entity.emplace("inventory", TagArray<Policy>(vector<Tag<Policy>>({ TagObject<Policy>(stone), TagObject<Policy>(torch) })));
+    entity.emplace("pos", TagArrayDouble(vector<double>({ 12.5, 64.0, -3.25 })));
+    document.emplace("entities", TagArray<Policy>(vector<Tag<Policy>>({ TagObject<Policy>(entity), TagObject<Policy>(entity) })));
+    Query::Path ids, heights;
+    vector<Query::Match<Policy>> matches;
+    if (Query::compile("entities[*].inventory[1].id", ids) && Query::compile("entities[0].pos[1]", heights)) {
+        Query::select<Policy>(ids, document, matches);
+        Query::select<Policy>(heights, document, matches);
+        for (const auto& match : matches) cout << (match.index < 0 ? match.tag->toString() : std::to_string(match.tag->tagArrayDouble.payload[match.index])) << endl;
+        if (matches.size() == 3) cout << "========Test Completed========" << endl;
+    }
+    else {
+        cout << "Query failed! Errors:" << endl;
+        auto errors = getErrors();
+        for (const auto& error : errors) cout << error << endl;
+    }
+}
+
+{
+    cout << "========Frozen Images========" << endl;
+    Map stone, registry;
+    stone.emplace("hardness", TagFloat(1.5f));
+    stone.emplace("drops", TagArrayRaw(vector<u8>({ 1, 4 })));
+    registry.emplace("stone", TagObject<Policy>(stone));
+    registry.emplace("version", TagUVarInt(3));
+    vector<u8> image;
+    if (Frozen::freeze<Policy>(registry, image)) {
+        {
+            ofstream f("../../../tests/frozen.cgf", ios::binary | ios::trunc);
+            f.write(reinterpret_cast<const char*>(image.data()), static_cast<std::streamsize>(image.size()));
+        }
+        IO::MappedFile mapped("../../../tests/frozen.cgf");
+        const Frozen::View view(mapped.data());
+        const auto root = view.root();
+        cout << "stone hardness: " << root["stone"]["hardness"].asFloat() << ", drops: " << root["stone"]["drops"].asArrayRaw().size() << ", version: " << root["version"].asUVarInt() << endl;
+        if (view && root["stone"]["hardness"].asFloat() == 1.5f && !root["dirt"]) cout << "========Test Completed========" << endl;
+    }
+    else {
+        cout << "Freezing failed! Errors:" << endl;
+        auto errors = getErrors();
+        for (const auto& error : errors) cout << error << endl;
+    }
+}
+
+{
+    cout << "========Structural Equality========" << endl;
+    Map first, second;
+    first.emplace("name", TagString("Steve"));
+    first.emplace("pos", TagArrayDouble(vector<double>({ 12.5, 64.0, -3.25 })));
+    second.emplace("pos", TagArrayDouble(vector<double>({ 12.5, 64.0, -3.25 })));
+    second.emplace("name", TagString("Steve"));
+    const Tag<Policy> before = TagObject<Policy>(first);
+    Tag<Policy> after = TagObject<Policy>(second);
+    const bool same = before == after && digest(before) == digest(after);
+    after.tagObject.payload.at("pos").tagArrayDouble.payload[1] = 65.0;
+    cout << std::hex << digest(before) << " -> " << digest(after) << std::dec << endl;
+    if (same && !(before == after) && digest(before) != digest(after) && Shared::fromMap<Policy>(first).digest() == digest(before)) cout << "========Test Completed========" << endl;
+    else cout << "Equality failed!" << endl;
+}
+
+{
+    cout << "========Stale Digests========" << endl;
+    //Pins down the documented hazard: writes through a pointer `mut` returned before a digest was taken aren't seen by the
+    //cached digest, until `mut` is called again.
+    Map stats;
+    stats.emplace("hp", TagIVarInt(20));
+    auto node = Shared::fromMap<Policy>(stats);
+    auto* const members = node.mut<Types::Object>();
+    const u64 cached = node.digest();
+    members->at("hp") = Shared::Node<Policy>(TagIVarInt(5));
+    const bool stale = node.digest() == cached;
+    (void)node.mut<Types::Object>();
+    const Tag<Policy> current = TagObject<Policy>(Shared::toMap(node));
+    const bool refreshed = node.digest() != cached && node.digest() == digest(current);
+    cout << "stale: " << stale << ", refreshed: " << refreshed << endl;
+    if (stale && refreshed) cout << "========Test Completed========" << endl;
+    else cout << "Digest caching changed!" << endl;
+}
+
+{
+    cout << "========Diff and Patch========" << endl;
+    Map leader;
+    leader.emplace("tick", TagUVarInt(1200));
+    leader.emplace("heights", TagArrayFloat(vector<float>(256, 64.0f)));
+    leader.emplace("weather", TagString("clear"));
+    Map follower = leader;
+    leader.at("tick").tagUVarInt.payload++;
+    leader.at("heights").tagArrayFloat.payload[37] = 65.0f;
+    leader.erase("weather");
+    Diff::Patch<Policy> ops;
+    Diff::diff<Policy>(follower, leader, ops);
+    vector<u8> encoded, full;
+    Diff::Patch<Policy> received;
+    if (Diff::encodePatch<Policy>(ops, encoded) && writeData<Policy>(leader, full, true) && Diff::decodePatch<Policy>(encoded, received) && Diff::patch<Policy>(follower, received)) {
+        cout << ops.size() << " ops, " << encoded.size() << " bytes instead of " << full.size() << endl;
+        //Ops that lack the value or count their kind needs are refused rather than applied with a default one.
+        bool refused = true;
+        //Set without `v`, Resize without `n`, then Range without either.
+        for (const auto& [kind, withValue, withCount] : {std::tuple(0, false, false), std::tuple(2, false, false), std::tuple(3, false, true), std::tuple(3, true, false)}) {
+            Map op, forged;
+            op.emplace("o", TagHex(static_cast<u8>(kind)));
+            op.emplace("p", TagString("heights"));
+            if (withValue) op.emplace("v", TagArrayFloat(vector<float>(1, 1.0f)));
+            if (withCount) op.emplace("n", TagUVarInt(0));
+            vector<Tag<Policy>> entries;
+            entries.push_back(TagObject<Policy>(std::move(op)));
+            forged.emplace("ops", TagArray<Policy>(std::move(entries)));
+            vector<u8> bytes;
+            Diff::Patch<Policy> rejected;
+            refused = refused && writeData<Policy>(forged, bytes, true) && !Diff::decodePatch<Policy>(bytes, rejected);
+        }
+        if (refused && Tag<Policy>(TagObject<Policy>(follower)) == Tag<Policy>(TagObject<Policy>(leader))) cout << "========Test Completed========" << endl;
+        else cout << "Patched document differs!" << endl;
+    }
+    else {
+        cout << "Patch failed! Errors:" << endl;
+        auto errors = getErrors();
+        for (const auto& error : errors) cout << error << endl;
+    }
+}
+
+{
+    cout << "========Shared Snapshots========" << endl;
+    Map stats, player;
+    stats.emplace("hp", TagIVarInt(20));
+    player.emplace("stats", TagObject<Policy>(stats));
+    player.emplace("pos", TagArrayDouble(vector<double>({ 12.5, 64.0, -3.25 })));
+    auto live = Shared::fromMap<Policy>(player);
+    const auto snapshot = live;
+    auto& members = *live.mut<Types::Object>();
+    *members.at("stats").mut<Types::Object>()->at("hp").mut<Types::IVarInt>() = 15;
+    const auto& old = *snapshot.get<Types::Object>();
+    cout << "snapshot hp: " << *old.at("stats").get<Types::Object>()->at("hp").get<Types::IVarInt>() << ", live hp: " << *members.at("stats").get<Types::Object>()->at("hp").get<Types::IVarInt>() << endl;
+    if (members.at("pos").sharesWith(old.at("pos")) && !members.at("stats").sharesWith(old.at("stats")) && Shared::toMap(snapshot).at("stats").tagObject.payload.at("hp").tagIVarInt.payload == 20) cout << "========Test Completed========" << endl;
+    else cout << "Copy-on-write failed!" << endl;
+}
+
+{
+    cout << "========Interning========" << endl;
+    Map stack;
+    stack.emplace("id", TagString("stone"));
+    stack.emplace("count", TagIVarInt(64));
+    vector<Tag<Policy>> slots(27, TagObject<Policy>(stack));
+    Map chest;
+    chest.emplace("items", TagArray<Policy>(slots));
+    Shared::Interner<Policy> interner;
+    const auto interned = interner.fromMap(chest);
+    const auto& items = *interned.get<Types::Object>()->at("items").get<Types::Array>();
+    cout << "unique subtrees: " << interner.size() << ", merged: " << interner.hits() << endl;
+    if (items.front().sharesWith(items.back()) && Shared::toMap(interned).at("items") == chest.at("items")) cout << "========Test Completed========" << endl;
+    else cout << "Interning failed!" << endl;
+}
+
+{
+    cout << "========Incremental Saves========" << endl;
+    //Ordered, so that `toMap` iterates the members in the same order as the nodes and the two encodings can be compared.
+    OrderedMap world;
+    for (u64 i = 0; i < 64; i++) {
+        OrderedMap chunk;
+        chunk.emplace("x", TagIVarInt(static_cast<i64>(i)));
+        chunk.emplace("blocks", TagArrayRaw(vector<u8>(4096, static_cast<u8>(i))));
+        world.emplace(std::format("chunk{}", i), TagObject<OrderedPolicy>(chunk));
+    }
+    //Arrays of arrays, down to arrays of typed arrays, whose head bytes the two writers have to agree on.
+    vector<Tag<OrderedPolicy>> regions, layers;
+    for (u64 i = 0; i < 4; i++) {
+        vector<Tag<OrderedPolicy>> region, layer;
+        for (u64 j = 0; j < 8; j++) region.push_back(TagIVarInt(static_cast<i64>(i * 8 + j)));
+        for (u64 j = 0; j < 2; j++) layer.push_back(TagArrayFloat(vector<float>(16, 0.5f * j)));
+        regions.push_back(TagArray<OrderedPolicy>(std::move(region)));
+        layers.push_back(TagArray<OrderedPolicy>(std::move(layer)));
+    }
+    world.emplace("regions", TagArray<OrderedPolicy>(std::move(regions)));
+    world.emplace("layers", TagArray<OrderedPolicy>(std::move(layers)));
+    auto root = Shared::fromMap<OrderedPolicy>(world);
+    vector<u8> first, second;
+    bool saved = Shared::writeData(root, first, true);
+    //Copies keep the old encodings alive, so a new one can't turn up at the address of a freed one.
+    const auto untouched = root.get<Types::Object>()->at("chunk7"), previous = root.get<Types::Object>()->at("chunk5");
+    auto& edited = root.mut<Types::Object>()->at("chunk5");
+    edited.mut<Types::Object>()->at("x") = Shared::Node<OrderedPolicy>(TagIVarInt(-5));
+    saved = saved && Shared::writeData(root, second, true);
+    vector<u8> expected;
+    saved = saved && writeData<OrderedPolicy>(Shared::toMap(root), expected, true);
+    //The edit re-encodes `chunk5` and the root only; every other chunk is copied from the encoding the first save cached.
+    const auto& chunks = *root.get<Types::Object>();
+    const bool reused = untouched.cachedEncoding() != nullptr && chunks.at("chunk7").cachedEncoding() == untouched.cachedEncoding()
+        && chunks.at("chunk5").cachedEncoding() != nullptr && chunks.at("chunk5").cachedEncoding() != previous.cachedEncoding();
+    OrderedMap before, after;
+    if (saved && readData<OrderedPolicy>(first, before) && readData<OrderedPolicy>(second, after)) {
+        cout << "document: " << second.size() << " bytes, identical: " << (second == expected) << ", reused: " << reused << endl;
+        if (second == expected && reused && before == world && after == Shared::toMap(root) && after.at("chunk5").tagObject.payload.at("x").tagIVarInt.payload == -5) cout << "========Test Completed========" << endl;
+        else cout << "Incremental save differs!" << endl;
+    }
+    else {
+        cout << "Incremental save failed! Errors:" << endl;
+        auto errors = getErrors();
+        for (const auto& error : errors) cout << error << endl;
+    }
+}
+
+{
+    cout << "========Versioned Documents========" << endl;
+    Map config;
+    config.emplace("revision", TagUVarInt(0));
+    config.emplace("motd", TagString("welcome"));
+    Shared::Versioned<Policy> published(Shared::fromMap<Policy>(config));
+    std::atomic<bool> stop{false};
+    std::atomic<u64> reads{0}, regressions{0}, started{0}, caughtUp{0};
+    vector<std::thread> readers;
+    //Every reader reads before the first update and keeps reading until it has seen the last one.
+    for (u64 i = 0; i < 4; i++) readers.emplace_back([&] {
+        Shared::Versioned<Policy>::Reader reader(published);
+        u64 last = 0;
+        for (bool first = true; !stop.load(); first = false) {
+            const u64 revision = *reader.get().get<Types::Object>()->at("revision").get<Types::UVarInt>();
+            if (revision < last) regressions++;
+            if (revision == 100 && last != 100) caughtUp++;
+            last = revision;
+            reads++;
+            if (first) started++;
+        }
+    });
+    const auto initial = published.snapshot();
+    while (started.load() < readers.size()) std::this_thread::yield();
+    for (u64 i = 1; i <= 100; i++) (void)published.update([i](Shared::Node<Policy>& document) {
+        document.mut<Types::Object>()->at("revision") = Shared::Node<Policy>(TagUVarInt(i));
+        return true;
+    });
+    while (caughtUp.load() < readers.size()) std::this_thread::yield();
+    stop = true;
+    for (auto& reader : readers) reader.join();
+    const auto latest = published.snapshot();
+    cout << "version: " << published.version() << ", reads: " << reads.load() << endl;
+    if (reads > 0 && regressions == 0 && published.version() == 100 && *initial->get<Types::Object>()->at("revision").get<Types::UVarInt>() == 0
+        && latest->get<Types::Object>()->at("motd").sharesWith(initial->get<Types::Object>()->at("motd"))) cout << "========Test Completed========" << endl;
+    else cout << "Versioned document misbehaved!" << endl;
+}
+
+{
+    cout << "========Reparse========" << endl;
+    bool reparsed = true;
+    Map document;
+    for (u64 i = 0; i < 3; i++) {
+        Map source;
+        source.emplace("tick", TagUVarInt(i));
+        source.emplace("name", TagString(std::format("a name long enough to live on the heap, version {}", i)));
+        source.emplace("pos", TagArrayDouble(vector<double>{ 1.0 * i, 64.0, -2.5 }));
+        source.emplace(i == 2 ? "renamed" : "stale", TagBool(true));
+        vector<u8> bytes;
+        reparsed = reparsed && writeData<Policy>(source, bytes, true);
+        const char* name = document.contains("name") ? document.at("name").tagString.payload.data() : nullptr;
+        reparsed = reparsed && readDataInto<Policy>(bytes, document) && document == source;
+        //Same type at the same key: the string is overwritten where it was.
+        if (name != nullptr) reparsed = reparsed && document.at("name").tagString.payload.data() == name;
+    }
+    //Repeated keys: the last copy wins at the top level, the first one in nested objects, on a fresh parse and a reparse alike.
+    vector<u8> repeated(IO::MAGIC.begin(), IO::MAGIC.end());
+    repeated.push_back(getHead(Types::Object));
+    Aux::writeVarText("nested", repeated);
+    for (u64 i = 0; i < 100; i++) reparsed = reparsed && IO::writeMember<Policy>(std::format("k{}", i), TagUVarInt(i), repeated);
+    reparsed = reparsed && IO::writeMember<Policy>("k37", TagUVarInt(1000), repeated) && IO::writeMember<Policy>("k99", TagUVarInt(1000), repeated);
+    repeated.push_back(static_cast<u8>(Types::ObjectEnd));
+    reparsed = reparsed && IO::writeMember<Policy>("tick", TagUVarInt(1), repeated) && IO::writeMember<Policy>("tick", TagUVarInt(5), repeated);
+    Map fresh;
+    reparsed = reparsed && readData<Policy>(repeated, fresh) && readDataInto<Policy>(repeated, document) && document == fresh;
+    reparsed = reparsed && document.at("tick").tagUVarInt.payload == 5 && document.at("nested").tagObject.payload.size() == 100
+        && document.at("nested").tagObject.payload.at("k37").tagUVarInt.payload == 37 && document.at("nested").tagObject.payload.at("k99").tagUVarInt.payload == 99;
+    cout << "keys: " << document.size() << endl;
+    if (reparsed && !document.contains("stale")) cout << "========Test Completed========" << endl;
+    else {
+        cout << "Reparse failed! Errors:" << endl;
+        auto errors = getErrors();
+        for (const auto& error : errors) cout << error << endl;
+    }
+}
+
+{
+    cout << "========Deep Nesting========" << endl;
+    //Far deeper than a call stack would take recursively, and than `readData` accepts by default.
+    const u64 depth = 100000;
+    Tag<Policy> nested = TagString("bottom");
+    for (u64 i = 0; i < depth; i++) {
+        if (i % 2 == 0) {
+            Map level;
+            level.emplace("next", std::move(nested));
+            nested = TagObject<Policy>(std::move(level));
+        }
+        else {
+            vector<Tag<Policy>> level;
+            level.push_back(std::move(nested));
+            nested = TagArray<Policy>(std::move(level));
+        }
+    }
+    Map deep;
+    deep.emplace("root", std::move(nested));
+    vector<u8> bytes;
+    Map result, rejected;
+    const bool written = writeData<Policy>(deep, bytes, true);
+    const bool parsed = written && readData<Policy>(bytes, result, ReadLimits{ depth + 1 });
+    const bool limited = written && !readData<Policy>(bytes, rejected);
+    const string text = serialize<Policy>(result);
+    string tail = "\"bottom\"";
+    for (u64 i = 0; i < depth / 2; i++) tail += "}]";
+    cout << bytes.size() << " bytes, " << text.size() << " characters" << endl;
+    if (parsed && limited && text.ends_with(tail + "}")) cout << "========Test Completed========" << endl;
+    else {
+        cout << "Deep nesting failed! Errors:" << endl;
+        auto errors = getErrors();
+        for (const auto& error : errors) cout << error << endl;
+    }
+}
+
+{
+    cout << "========Untrusted Input========" << endl;
+    Map source;
+    source.emplace("name", TagString(""));
+    source.emplace("samples", TagArrayDouble(vector<double>()));
+    vector<Tag<Policy>> empty;
+    source.emplace("entities", TagArray<Policy>(std::move(empty)));
+    //The same shapes under the names `Player` binds, for the reflection reader.
+    source.emplace("pos", TagArrayDouble(vector<double>()));
+    vector<Tag<Policy>> items;
+    source.emplace("inventory", TagArray<Policy>(std::move(items)));
+    bool guarded = true;
+    //Each member written alone, with its empty count swapped for one that claims a terabyte.
+    for (const auto& [key, value] : source) {
+        Map single;
+        single.emplace(key, value);
+        vector<u8> bytes;
+        guarded = guarded && writeData<Policy>(single, bytes, true);
+        bytes.pop_back();
+        Aux::writeUVarInt(u64(1) << 40, bytes);
+        Map result, reused;
+        Tape::Document tape;
+        Player player;
+        guarded = guarded && !readData<Policy>(bytes, result) && !readDataInto<Policy>(bytes, reused) && !Tape::readData(bytes, tape) && !Reflect::readData(bytes, player);
+        cout << key << ": " << (getErrors().empty() ? string("accepted") : getErrors().back()) << endl;
+    }
+    Map document;
+    for (u64 i = 0; i < 64; i++) document.emplace(std::format("entry{}", i), TagArrayFloat(vector<float>(16, 1.0f * i)));
+    vector<u8> bytes;
+    guarded = guarded && writeData<Policy>(document, bytes, true);
+    Map result;
+    guarded = guarded && readData<Policy>(bytes, result, ReadLimits{ .bytes = bytes.size(), .tags = 64, .arrayLength = 16 }) && result == document;
+    guarded = guarded && !readData<Policy>(bytes, result, ReadLimits{ .tags = 63 });
+    guarded = guarded && !readData<Policy>(bytes, result, ReadLimits{ .arrayLength = 15 });
+    guarded = guarded && !readData<Policy>(bytes, result, ReadLimits{ .bytes = bytes.size() / 2 });
+    if (guarded) cout << "========Test Completed========" << endl;
+    else {
+        cout << "Untrusted input failed! Errors:" << endl;
+        auto errors = getErrors();
+        for (const auto& error : errors) cout << error << endl;
+    }
+}
+
+{
+    cout << "========Allocations========" << endl;
+    //Scalar members cost their map node and nothing else. Keys and strings that outgrow the small string buffer add one allocation each.
+    const auto document = [](u64 members, u64 length) {
+        Map result;
+        for (u64 i = 0; i < members; i++) {
+            const string key = string(length, 'k') + std::to_string(i);
+            result.emplace("i" + key, TagIVarInt(-static_cast<i64>(i)));
+            result.emplace("d" + key, TagDouble(i * 0.5));
+            result.emplace("s" + key, TagString(string(length, 'x')));
+        }
+        return result;
+    };
+    const auto count = [](const Map& source, Map& result, bool& parsed) {
+        vector<u8> bytes;
+        parsed = parsed && writeData<Policy>(source, bytes, true);
+        const u64 before = allocations.load();
+        parsed = parsed && readData<Policy>(bytes, result) && result == source;
+        return allocations.load() - before;
+    };
+    bool parsed = true;
+    Map result;
+    result.reserve(1024);
+    const Map small = document(32, 4), large = document(64, 4), longer = document(32, 40);
+    const u64 smallCost = count(small, result, parsed), largeCost = count(large, result, parsed), longCost = count(longer, result, parsed);
+    cout << smallCost << " allocations for " << small.size() << " short members, " << largeCost << " for " << large.size() << ", " << longCost << " for " << longer.size() << " long ones" << endl;
+    if (parsed && largeCost - smallCost == large.size() - small.size() && longCost - smallCost == longer.size() + 32) cout << "========Test Completed========" << endl;
+    else {
+        cout << "Allocations failed! Errors:" << endl;
+        auto errors = getErrors();
+        for (const auto& error : errors) cout << error << endl;
+    }
+}
+
+{
+    cout << "========Truncated Input========" << endl;
+    Map root, first, second;
+    vector<Tag<Policy>> items;
+    first.emplace("id", TagString("oak_planks"));
+    first.emplace("count", TagUVarInt(64));
+    second.emplace("id", TagString("stone"));
+    second.emplace("count", TagUVarInt(12));
+    items.push_back(TagObject<Policy>(std::move(first)));
+    items.push_back(TagObject<Policy>(std::move(second)));
+    root.emplace("items", TagArray<Policy>(std::move(items)));
+    root.emplace("pos", TagArrayDouble(vector<double>{ 1.0, 2.0, 3.0 }));
+    Map document;
+    document.emplace("root", TagObject<Policy>(std::move(root)));
+    vector<u8> bytes;
+    bool rejected = writeData<Policy>(document, bytes, true);
+    //Every cut lands inside `root`, so every prefix past the magic has to fail. Once the key is complete, the error points into it.
+    const u64 keyEnd = 5 + 1 + 4;
+    string last;
+    for (u64 length = 6; rejected && length < bytes.size(); length++) {
+        const std::span<const u8> prefix(bytes.data(), length);
+        Map result, reused;
+        Tape::Document tape;
+        IO::SpanIn source(prefix);
+        rejected = !readData<Policy>(prefix, result) && !getRecords().empty() && (length < keyEnd || getRecords().back().path.starts_with("root"));
+        if (rejected) last = getRecords().back().message();
+        rejected = rejected && !readDataInto<Policy>(prefix, reused) && !Tape::readStream(source, tape);
+    }
+    //In-place lookups skip what they don't need, so only a path through the very end of a document has to see every cut.
+    Map inner, outer;
+    inner.emplace("pos", TagArrayDouble(vector<double>{ 1.0, 2.0, 3.0 }));
+    outer.emplace("root", TagObject<Policy>(std::move(inner)));
+    vector<u8> located;
+    Query::Path z;
+    rejected = rejected && writeData<Policy>(outer, located, true) && Query::compile("root.pos[2]", z);
+    for (u64 length = 6; rejected && length < located.size(); length++) {
+        InPlace::Location location;
+        rejected = !InPlace::locate(std::span<const u8>(located.data(), length), z, location);
+    }
+    cout << "last cut: " << last << endl;
+    if (rejected) cout << "========Test Completed========" << endl;
+    else {
+        cout << "Truncated input failed! Errors:" << endl;
+        auto errors = getErrors();
+        for (const auto& error : errors) cout << error << endl;
+    }
+}
+
+{
+    cout << "========Gathered Writes to Descriptors========" << endl;
+    Map document;
+    document.emplace("samples", TagArrayDouble(vector<double>(4096, 0.25)));
+    document.emplace("text", TagString(string(10000, 'x')));
+    document.emplace("id", TagUVarInt(7));
+    bool gathered = true;
+    //Plain documents go out through `writev`, compressed ones through one streamed zstd frame; both have to read back.
+    for (const bool zstd : { false, true }) {
+        const string file = "../../../tests/gathered.cgb";
+#ifdef _WIN32
+        const int fd = _open(file.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+        const int fd = open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif // _WIN32
+        IO::FdOut out(fd);
+        gathered = gathered && fd >= 0 && writeStreamVectored<Policy>(out, document, zstd);
+#ifdef _WIN32
+        if (fd >= 0) _close(fd);
+#else
+        if (fd >= 0) close(fd);
+#endif // _WIN32
+        Map result;
+        ifstream f(file, ios::binary);
+        gathered = gathered && readStream<Policy>(f, result) && result == document;
+        f.close();
+        cout << (zstd ? "zstd: " : "plain: ") << std::filesystem::file_size(file) << " bytes" << endl;
+        std::filesystem::remove(file);
+    }
+    if (gathered) cout << "========Test Completed========" << endl;
+    else {
+        cout << "Gathered write failed! Errors:" << endl;
+        auto errors = getErrors();
+        for (const auto& error : errors) cout << error << endl;
+    }
+}
+
+{
+    cout << "========Variable-length Integers========" << endl;
+    //Zero takes one byte like any other value below 128, also as the count of an empty array.
+    vector<u8> zero, small, large;
+    Aux::writeUVarInt(0, zero);
+    Aux::writeUVarInt(127, small);
+    Aux::writeUVarInt(128, large);
+    Map numbers, decoded;
+    for (const u64 value : {u64(0), u64(1), u64(127), u64(128), u64(1) << 63, UINT64_MAX}) numbers.emplace(std::format("u{}", value), TagUVarInt(value));
+    numbers.emplace("i0", TagIVarInt(0));
+    numbers.emplace("empty", TagArrayRaw(vector<u8>()));
+    vector<u8> bytes;
+    const bool encoded = zero == vector<u8>{0x80} && small == vector<u8>{0xFF} && large == vector<u8>{0x00, 0x81};
+    if (encoded && writeData<Policy>(numbers, bytes, true) && readData<Policy>(bytes, decoded) && decoded == numbers) cout << "========Test Completed========" << endl;
+    else {
+        cout << "Variable-length integers failed! Errors:" << endl;
+        auto errors = getErrors();
+        for (const auto& error : errors) cout << error << endl;
+    }
+}
+
+{
+    cout << "========Append-only Logs========" << endl;
+    bool appended = true;
+    for (const bool zstd : { false, true }) {
+        const string file = zstd ? "../../../tests/log_zstd.cgb" : "../../../tests/log.cgb";
+        std::filesystem::remove(file);
+        for (u64 i = 0; i < 8; i++) {
+            Map entry;
+            entry.emplace("requests", TagUVarInt(i));
+            entry.emplace(std::format("event{}", i % 3), TagString(std::format("tick {}", i)));
+            appended = appended && appendFile<Policy>(file, entry, zstd);
+        }
+        Map log;
+        ifstream f(file, ios::binary);
+        appended = appended && readStream<Policy>(f, log) && log.size() == 4 && log.at("requests").tagUVarInt.payload == 7 && log.at("event1").tagString.payload == "tick 7";
+        f.close();
+        //The tape keeps every appended copy; lookups have to find the newest one, before and after compaction.
+        const auto newest = [&file](Tape::Document& document) {
+            ifstream g(file, ios::binary);
+            return Tape::readStream(g, document) && document.root()["requests"].asUVarInt() == 7 && document.root()["event1"].asString() == "tick 7";
+        };
+        Tape::Document grown, compacted;
+        appended = appended && newest(grown) && grown.root().size() == 16;
+        appended = appended && compactFile<Policy>(file) && newest(compacted) && compacted.root().size() == 4;
+        cout << file << ": " << log.size() << " keys, " << std::filesystem::file_size(file) << " bytes after compaction" << endl;
+    }
+    if (appended) cout << "========Test Completed========" << endl;
+    else {
+        cout << "Append failed! Errors:" << endl;
+        auto errors = getErrors();
+        for (const auto& error : errors) cout << error << endl;
+    }
+}
+
+{
+    cout << "========In-place Updates========" << endl;
+    Map player, save;
+    player.emplace("hp", TagFloat(20.0f));
+    player.emplace("sneaking", TagBool(false));
+    player.emplace("pos", TagArrayDouble(vector<double>({ 12.5, 64.0, -3.25 })));
+    save.emplace("terrain", TagArrayRaw(vector<u8>(1 << 16, 1)));
+    save.emplace("player", TagObject<Policy>(player));
+    {
+        ofstream f("../../../tests/inplace.cgb", ios::binary | ios::trunc);
+        (void)writeStream<Policy>(f, save);
+    }
+    Query::Path y, sneaking;
+    const bool updated = Query::compile("player.pos[1]", y) && Query::compile("player.sneaking", sneaking)
+        && InPlace::overwrite("../../../tests/inplace.cgb", y, TagDouble(80.0)) && InPlace::overwrite("../../../tests/inplace.cgb", sneaking, TagBool(true));
+    //A forged element count and a document cut after a scalar's key both point past the end, and must be refused untouched.
+    Map small;
+    small.emplace("pos", TagArrayDouble(vector<double>({ 1.0, 2.0, 3.0 })));
+    vector<u8> forged, cut;
+    bool refused = writeData<Policy>(small, forged, true);
+    //Magic, head and key come first; then the count, which is a single byte here.
+    forged.erase(forged.begin() + 5 + 1 + 3);
+    vector<u8> count;
+    Aux::writeUVarInt(4, count);
+    forged.insert(forged.begin() + 5 + 1 + 3, count.begin(), count.end());
+    const vector<u8> original = forged;
+    Query::Path past, hp;
+    refused = refused && Query::compile("pos[3]", past) && !InPlace::overwrite(std::span<u8>(forged), past, TagDouble(0.0)) && forged == original;
+    Map scalar;
+    scalar.emplace("hp", TagFloat(20.0f));
+    refused = refused && writeData<Policy>(scalar, cut, true) && Query::compile("hp", hp);
+    cut.resize(cut.size() - sizeof(float) + 1);
+    refused = refused && !InPlace::overwrite(std::span<u8>(cut), hp, TagFloat(1.0f));
+    Map reloaded;
+    ifstream f("../../../tests/inplace.cgb", ios::binary);
+    if (updated && refused && readStream<Policy>(f, reloaded)) {
+        const auto& members = reloaded.at("player").tagObject.payload;
+        cout << "y = " << members.at("pos").tagArrayDouble.payload[1] << ", sneaking: " << members.at("sneaking").tagBool.payload << endl;
+        if (members.at("pos").tagArrayDouble.payload[1] == 80.0 && members.at("sneaking").tagBool.payload) cout << "========Test Completed========" << endl;
+        else cout << "In-place update lost!" << endl;
+    }
+    else {
+        cout << "In-place update failed! Errors:" << endl;
+        auto errors = getErrors();
+        for (const auto& error : errors) cout << error << endl;
+    }
+}
+
+{
+    cout << "========Region Containers========" << endl;
+    std::filesystem::remove("../../../tests/region.cgr");
+    bool stored = true;
+    {
+        Region::File region("../../../tests/region.cgr");
+        for (u64 i = 0; i < 8; i++) {
+            Map chunk;
+            chunk.emplace("x", TagIVarInt(static_cast<i64>(i)));
+            chunk.emplace("blocks", TagArrayRaw(vector<u8>(5000, static_cast<u8>(i))));
+            stored = stored && region.write<Policy>(std::format("chunk.{}", i), chunk, i % 2 == 1);
+        }
+        Map replacement;
+        replacement.emplace("x", TagIVarInt(-1));
+        stored = stored && region && region.flush() && region.remove("chunk.3") && region.write<Policy>("chunk.0", replacement) && region.close();
+    }
+    Region::File region("../../../tests/region.cgr");
+    Map first, fifth;
+    if (stored && region && region.index().size() == 7 && !region.contains("chunk.3") && region.read<Policy>("chunk.0", first) && region.read<Policy>("chunk.5", fifth)) {
+        cout << "chunks: " << region.index().size() << ", sectors: " << region.sectorCount() << ", free: " << region.freeSectors() << endl;
+        (void)region.close();
+        IO::MappedFile mapped("../../../tests/region.cgr");
+        Region::View view(mapped.data());
+        Map viewed;
+        if (first.at("x").tagIVarInt.payload == -1 && fifth.at("blocks").tagArrayRaw.payload[0] == 5 && view && view.read<Policy>("chunk.5", viewed) && viewed == fifth) cout << "========Test Completed========" << endl;
+        else cout << "Region contents differ!" << endl;
+    }
+    else {
+        cout << "Region container failed! Errors:" << endl;
+        auto errors = getErrors();
+        for (const auto& error : errors) cout << error << endl;
+    }
+}
+
+{
+    cout << "========Document Cache========" << endl;
+    DocumentCache<Policy> cache(1 << 20);
+    DocumentCache<Policy>::Handle first, second, third;
+    const std::filesystem::path file("../../../tests/inplace.cgb");
+    const bool cached = cache.get(file, first) && cache.get(file, second) && cache.get("config", [](Map& data) {
+        data.emplace("motd", TagString("hello"));
+        return true;
+    }, third);
+    if (cached) {
+        cout << "entries: " << cache.size() << ", bytes: " << cache.bytes() << ", hits: " << cache.hits() << ", misses: " << cache.misses() << endl;
+        cache.setBudget(0);
+        if (first == second && cache.hits() == 1 && cache.size() == 0 && first->contains("player") && third->contains("motd")) cout << "========Test Completed========" << endl;
+        else cout << "Document cache misbehaved!" << endl;
+    }
+    else {
+        cout << "Document cache failed! Errors:" << endl;
+        auto errors = getErrors();
+        for (const auto& error : errors) cout << error << endl;
+    }
+}
+
+{
+    cout << "========Cache Coalescing and Eviction========" << endl;
+    //Eight threads miss on one key at once: the loader holds on until the seven others wait for it, and must run only once.
+    DocumentCache<Policy> cache(1 << 20);
+    std::atomic<u64> loads{0};
+    vector<DocumentCache<Policy>::Handle> handles(8);
+    vector<std::thread> threads;
+    for (u64 i = 0; i < handles.size(); i++) threads.emplace_back([&, i] {
+        (void)cache.get("shared", [&](Map& data) {
+            loads++;
+            while (cache.hits() < 7) std::this_thread::yield();
+            data.emplace("motd", TagString("hello"));
+            return true;
+        }, handles[i]);
+    });
+    for (auto& thread : threads) thread.join();
+    bool coalesced = loads == 1 && cache.misses() == 1 && cache.hits() == 7;
+    for (const auto& handle : handles) coalesced = coalesced && handle != nullptr && handle == handles[0];
+    //Room for three documents of the same size: after `a` is used again, loading a fourth evicts `b`, the least recently used.
+    const auto document = [](const string& key) {
+        Map data;
+        data.emplace("key", TagString(key));
+        return data;
+    };
+    DocumentCache<Policy> lru(3 * NBT::Cache::footprint<Policy>(document("a")));
+    std::unordered_map<string, u64> calls;
+    DocumentCache<Policy>::Handle handle;
+    const auto get = [&](const string& key) {
+        return lru.get(key, [&](Map& data) {
+            calls[key]++;
+            data = document(key);
+            return true;
+        }, handle);
+    };
+    bool evicted = get("a") && get("b") && get("c") && get("a") && get("d") && lru.size() == 3;
+    evicted = evicted && get("a") && get("c") && get("d") && calls["a"] == 1 && calls["c"] == 1 && calls["d"] == 1;
+    evicted = evicted && get("b") && calls["b"] == 2;
+    cout << "loads: " << loads.load() << ", waited: " << cache.hits() << ", reloaded: " << calls["b"] - 1 << endl;
+    if (coalesced && evicted) cout << "========Test Completed========" << endl;
+    else cout << "Document cache misbehaved!" << endl;
+}
+
+{
+    cout << "========Batch I/O========" << endl;
+    Parallel::Pool pool(4);
+    vector<std::filesystem::path> files;
+    vector<Map> documents;
+    for (u64 i = 0; i < 64; i++) {
+        files.push_back(std::format("../../../tests/batch{}.cgb", i));
+        Map document;
+        document.emplace("id", TagUVarInt(i));
+        document.emplace("name", TagString(std::format("player {}", i)));
+        documents.push_back(std::move(document));
+    }
+    Batch::CompletionQueue<Batch::Saved> saves;
+    Batch::CompletionQueue<Batch::Loaded<Policy>> loads;
+    Batch::Saved saved;
+    Batch::Loaded<Policy> loaded;
+    u64 stored = 0, matching = 0;
+    if (Batch::save<Policy>(pool, files, documents, saves, true)) while (saves.pop(saved)) stored += saved.success;
+    files.push_back("../../../tests/batch_missing.cgb");
+    Batch::load<Policy>(pool, files, loads);
+    vector<string> failures;
+    while (loads.pop(loaded)) {
+        if (loaded.success && loaded.data == documents[loaded.index]) matching++;
+        else failures.insert(failures.end(), loaded.errors.begin(), loaded.errors.end());
+    }
+    cout << "saved: " << stored << ", loaded: " << matching << ", failed: " << failures.size() << endl;
+    if (stored == 64 && matching == 64 && failures.size() == 1) cout << "========Test Completed========" << endl;
+    else for (const auto& error : failures) cout << error << endl;
+    for (const auto& file : files) std::filesystem::remove(file);
+}
+
+{
+    cout << "========Region Batch I/O========" << endl;
+    std::filesystem::remove("../../../tests/batch.cgr");
+    Parallel::Pool pool(4);
+    vector<string> keys;
+    vector<Map> documents;
+    for (u64 i = 0; i < 64; i++) {
+        keys.push_back(std::format("chunk.{}", i));
+        Map document;
+        document.emplace("x", TagIVarInt(static_cast<i64>(i)));
+        document.emplace("blocks", TagArrayRaw(vector<u8>(3000 + i * 97, static_cast<u8>(i))));
+        documents.push_back(std::move(document));
+    }
+    Batch::CompletionQueue<Batch::Saved> saves;
+    Batch::CompletionQueue<Batch::Loaded<Policy>> loads;
+    Batch::Saved saved;
+    Batch::Loaded<Policy> loaded;
+    u64 stored = 0, matching = 0;
+    bool flushed = false;
+    {
+        Region::File region("../../../tests/batch.cgr");
+        if (region && Batch::save<Policy>(pool, region, keys, documents, saves, true)) while (saves.pop(saved)) stored += saved.success;
+        flushed = region.flush() && region.close();
+    }
+    Region::File region("../../../tests/batch.cgr");
+    keys.push_back("chunk.missing");
+    Batch::load<Policy>(pool, region, keys, loads);
+    vector<string> failures;
+    while (loads.pop(loaded)) {
+        if (loaded.success && loaded.data == documents[loaded.index]) matching++;
+        else failures.insert(failures.end(), loaded.errors.begin(), loaded.errors.end());
+    }
+    (void)region.close();
+    cout << "saved: " << stored << ", loaded: " << matching << ", failed: " << failures.size() << endl;
+    if (flushed && stored == 64 && matching == 64 && failures.size() == 1) cout << "========Test Completed========" << endl;
+    else for (const auto& error : failures) cout << error << endl;
+    std::filesystem::remove("../../../tests/batch.cgr");
 }
 
 {